@@ -0,0 +1,351 @@
+// batch.c
+// Batchbehandling av .raw- och PGM-filer (P5) med samma kernels och kedjor
+// som firmwaren. Indata mappas med mmap och utraderna skrivs direkt in i en
+// mappad utfil, utan mellanbuffertar. Flera filer behandlas samtidigt i
+// trådar, och varje tråd ber kärnan läsa in nästa fil i förväg medan den
+// räknar på sin nuvarande, så att läsning och beräkning överlappar.
+//
+//   imgbatch -k kernel [-c kernel2] [-b kant] [-W bredd -H höjd] [-j trådar]
+//            [-T byte] -o utkatalog fil|katalog ...
+//
+// Kernels: edge3 box3 gauss3 sharpen3 edge5 box5 gauss5 sharpen5.
+// Kanter: zero (standard), clamp, mirror, wrap. .raw-filer antas vara
+// W x H (standard 256 x 256); PGM-filer har storleken i huvudet.
+// Med -T körs en bild vars ksize rader inte ryms i så många byte ruta för
+// ruta (tile.c). Det lönar sig bara med liten cache: på x86 ryms ksize
+// rader av även mycket breda bilder i L2, och rutorna blir långsammare.
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal.h"
+#include "host_kernels.h"
+#include "chain.h"
+#include "tile.h"
+
+#define BATCH_MAX_THREADS 64
+
+typedef struct {
+    const conv_kernel_t* k1;
+    const conv_kernel_t* k2;   // NULL = inget andra steg
+    conv_options_t opts;
+    int raw_width, raw_height;
+    int tile_bytes;            // -T, 0 = aldrig rutor
+    const char* out_dir;
+
+    char** files;
+    int count;
+    int next;                  // nästa fil att ta, atomiskt
+    int threads;
+
+    int failed;                // atomiskt
+    long long pixels;          // atomiskt
+} batch_t;
+
+// Bildfil mappad i minnet. pixels pekar in i mappningen efter ett
+// eventuellt PGM-huvud.
+typedef struct {
+    unsigned char* map;
+    size_t size;
+    unsigned char* pixels;
+    int width, height;
+    int pgm;
+} mapped_image_t;
+
+static int has_suffix(const char* s, const char* suffix) {
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+// Läser ett heltal i ett PGM-huvud, hoppar över blanktecken och kommentarer
+static int pgm_int(const unsigned char* p, size_t size, size_t* pos) {
+    while (*pos < size) {
+        if (p[*pos] == '#') {
+            while (*pos < size && p[*pos] != '\n') (*pos)++;
+        } else if (p[*pos] == ' ' || p[*pos] == '\t' || p[*pos] == '\r' || p[*pos] == '\n') {
+            (*pos)++;
+        } else {
+            break;
+        }
+    }
+    int v = -1;
+    while (*pos < size && p[*pos] >= '0' && p[*pos] <= '9') {
+        v = (v < 0 ? 0 : v * 10) + (p[*pos] - '0');
+        (*pos)++;
+    }
+    return v;
+}
+
+static int map_input(const char* path, const batch_t* b, mapped_image_t* img) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        fprintf(stderr, "%s: empty or unreadable\n", path);
+        close(fd);
+        return 0;
+    }
+    img->size = st.st_size;
+    img->map = mmap(NULL, img->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (img->map == MAP_FAILED) {
+        fprintf(stderr, "%s: mmap: %s\n", path, strerror(errno));
+        return 0;
+    }
+    madvise(img->map, img->size, MADV_SEQUENTIAL);
+
+    img->pgm = img->size >= 2 && img->map[0] == 'P' && img->map[1] == '5';
+    if (img->pgm) {
+        size_t pos = 2;
+        img->width = pgm_int(img->map, img->size, &pos);
+        img->height = pgm_int(img->map, img->size, &pos);
+        int maxval = pgm_int(img->map, img->size, &pos);
+        pos++; // ett blanktecken före pixlarna
+        if (img->width <= 0 || img->height <= 0 || maxval <= 0 || maxval > 255) {
+            fprintf(stderr, "%s: unsupported PGM header\n", path);
+            munmap(img->map, img->size);
+            return 0;
+        }
+        img->pixels = img->map + pos;
+    } else {
+        img->width = b->raw_width;
+        img->height = b->raw_height;
+        img->pixels = img->map;
+    }
+
+    if ((size_t)(img->pixels - img->map) + (size_t)img->width * img->height > img->size) {
+        fprintf(stderr, "%s: file too short for %dx%d\n", path, img->width, img->height);
+        munmap(img->map, img->size);
+        return 0;
+    }
+    return 1;
+}
+
+// Skapar utfilen i full storlek och mappar den skrivbar
+static int map_output(const char* path, const mapped_image_t* in, mapped_image_t* out) {
+    char header[64];
+    int hlen = in->pgm ? snprintf(header, sizeof(header), "P5\n%d %d\n255\n", in->width, in->height) : 0;
+
+    out->width = in->width;
+    out->height = in->height;
+    out->pgm = in->pgm;
+    out->size = hlen + (size_t)in->width * in->height;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    if (ftruncate(fd, out->size) < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        close(fd);
+        return 0;
+    }
+    out->map = mmap(NULL, out->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (out->map == MAP_FAILED) {
+        fprintf(stderr, "%s: mmap: %s\n", path, strerror(errno));
+        return 0;
+    }
+    memcpy(out->map, header, hlen);
+    out->pixels = out->map + hlen;
+    return 1;
+}
+
+// Ber kärnan börja läsa in filen i bakgrunden
+static void prefetch(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+}
+
+// Ett pass av k, ruta för ruta om bildens ksize rader inte ryms i cachen
+static void batch_convolve(const batch_t* b, const unsigned char* src, unsigned char* dst, int width, int height, const conv_kernel_t* k) {
+    if (!b->tile_bytes || (long long)width * (k->ksize + 1) <= b->tile_bytes) {
+        convolve_kernel(src, dst, width, height, k, &b->opts);
+        return;
+    }
+    image_t in, out;
+    tile_config_t cfg;
+    image_init(&in, (unsigned char*)src, width, height, width);
+    image_init(&out, dst, width, height, width);
+    tile_config_for_cache(&cfg, b->tile_bytes, k->ksize);
+    convolve_tiled(&in, &out, k, &cfg, &b->opts);
+}
+
+static int process_file(batch_t* b, const char* path) {
+    mapped_image_t in, out;
+    if (!map_input(path, b, &in)) return 0;
+
+    const char* base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    char out_path[4096];
+    snprintf(out_path, sizeof(out_path), "%s/%s", b->out_dir, base);
+
+    if (!map_output(out_path, &in, &out)) {
+        munmap(in.map, in.size);
+        return 0;
+    }
+
+    int ok = 1;
+    if (!b->k2) {
+        batch_convolve(b, in.pixels, out.pixels, in.width, in.height, b->k1);
+    } else if (!convolve_chain(in.pixels, out.pixels, in.width, in.height, b->k1, b->k2, &b->opts)) {
+        // Kan inte strömmas (t.ex. wrap): två pass via en mellanbild
+        unsigned char* tmp = malloc((size_t)in.width * in.height);
+        if (tmp) {
+            batch_convolve(b, in.pixels, tmp, in.width, in.height, b->k1);
+            batch_convolve(b, tmp, out.pixels, in.width, in.height, b->k2);
+            free(tmp);
+        } else {
+            fprintf(stderr, "%s: out of memory\n", path);
+            ok = 0;
+        }
+    }
+
+    // Sidorna skrivs tillbaka av kärnan i bakgrunden
+    munmap(out.map, out.size);
+    munmap(in.map, in.size);
+    if (ok) __atomic_add_fetch(&b->pixels, (long long)in.width * in.height, __ATOMIC_RELAXED);
+    return ok;
+}
+
+static void* batch_worker(void* arg) {
+    batch_t* b = arg;
+    for (;;) {
+        int i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED);
+        if (i >= b->count) break;
+        // Filen som sannolikt blir den här trådens nästa
+        if (i + b->threads < b->count) prefetch(b->files[i + b->threads]);
+        if (!process_file(b, b->files[i])) {
+            __atomic_add_fetch(&b->failed, 1, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+static void add_file(batch_t* b, int* cap, const char* path) {
+    if (b->count == *cap) {
+        *cap = *cap ? *cap * 2 : 64;
+        b->files = realloc(b->files, *cap * sizeof(char*));
+        if (!b->files) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+    b->files[b->count++] = strdup(path);
+}
+
+// Lägger till en fil, eller alla .raw/.pgm i en katalog (inte rekursivt)
+static void add_path(batch_t* b, int* cap, const char* path) {
+    struct stat st;
+    if (stat(path, &st) < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        b->failed++;
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        add_file(b, cap, path);
+        return;
+    }
+    DIR* dir = opendir(path);
+    if (!dir) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        b->failed++;
+        return;
+    }
+    struct dirent* e;
+    char full[4096];
+    while ((e = readdir(dir)) != NULL) {
+        if (!has_suffix(e->d_name, ".raw") && !has_suffix(e->d_name, ".pgm")) continue;
+        snprintf(full, sizeof(full), "%s/%s", path, e->d_name);
+        add_file(b, cap, full);
+    }
+    closedir(dir);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "usage: %s -k kernel [-c kernel2] [-b border] [-W width -H height] [-j threads]\n"
+        "          [-T cache_bytes] -o out_dir file|dir ...\n"
+        "  kernels: edge3 box3 gauss3 sharpen3 edge5 box5 gauss5 sharpen5\n"
+        "  borders: zero clamp mirror wrap\n",
+        prog);
+}
+
+int main(int argc, char** argv) {
+    batch_t b = { 0 };
+    b.raw_width = 256;
+    b.raw_height = 256;
+    b.threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int k1 = -1, k2 = -1, opt;
+
+    while ((opt = getopt(argc, argv, "k:c:b:W:H:j:T:o:h")) != -1) {
+        switch (opt) {
+            case 'k': k1 = kernel_index(optarg); if (k1 < 0) { usage(argv[0]); return 2; } break;
+            case 'c': k2 = kernel_index(optarg); if (k2 < 0) { usage(argv[0]); return 2; } break;
+            case 'b': {
+                int bi = border_index(optarg);
+                if (bi < 0) { usage(argv[0]); return 2; }
+                b.opts.border = (border_mode_t)bi;
+                break;
+            }
+            case 'W': b.raw_width = atoi(optarg); break;
+            case 'H': b.raw_height = atoi(optarg); break;
+            case 'j': b.threads = atoi(optarg); break;
+            case 'T': b.tile_bytes = atoi(optarg); break;
+            case 'o': b.out_dir = optarg; break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (k1 < 0 || !b.out_dir || optind >= argc || b.raw_width <= 0 || b.raw_height <= 0 || b.tile_bytes < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    mkdir(b.out_dir, 0755);
+
+    hal_host_set_quiet(1);
+    b.k1 = kernel_by_index(k1);
+    b.k2 = k2 >= 0 ? kernel_by_index(k2) : NULL;
+
+    int cap = 0;
+    for (int i = optind; i < argc; i++) add_path(&b, &cap, argv[i]);
+
+    if (b.threads < 1) b.threads = 1;
+    if (b.threads > BATCH_MAX_THREADS) b.threads = BATCH_MAX_THREADS;
+    if (b.threads > b.count) b.threads = b.count > 0 ? b.count : 1;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    pthread_t tid[BATCH_MAX_THREADS];
+    int started = 1;
+    for (int i = 1; i < b.threads; i++) {
+        if (pthread_create(&tid[i], NULL, batch_worker, &b) != 0) break;
+        started++;
+    }
+    batch_worker(&b);
+    for (int i = 1; i < started; i++) pthread_join(tid[i], NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    fprintf(stderr, "%d files, %d failed, %.1f Mpixel in %.3f s (%.1f Mpixel/s)\n",
+            b.count, b.failed, b.pixels * 1e-6, sec, sec > 0 ? b.pixels * 1e-6 / sec : 0.0);
+
+    for (int i = 0; i < b.count; i++) free(b.files[i]);
+    free(b.files);
+    return b.failed ? 1 : 0;
+}
@@ -0,0 +1,291 @@
+// bench.c
+// Benchmark för konvolutionen på värddatorn: alla åtta kernels från
+// get_selected_kernel, kedjor i båda ordningarna och bildstorlekar från
+// 64x64 till 4096x4096. Indata är kattbilden upprepad över hela ytan.
+//
+//   bench [-m maxstorlek] [-t sekunder] [-j maxtrådar]
+//
+// Till sist mäts skalningen med 1, 2, 4, ... trådar på den största bilden.
+//
+// Per fall skrivs tid per bild, Mpixel/s, ns per pixel och ungefär hur
+// många byte som läses och skrivs (bilder plus radbuffertar). Fallet
+// "roi32" räknar bara om 32x32 pixlar men anges per pixel i hela bilden.
+// "unpack" och "... packed" läser bilden packad (src/packed.c); deras
+// "touched" är den packade storleken plus utdata. "... plan" kör en egen
+// kernel kompilerad av kernels_plan.c och "... ex" samma vikter med
+// convolve_ex(); gauss5 plan kan jämföras med den specialiserade gauss5.
+// "iir sN" är rekursiv Gauss (gauss_iir.c) med sigma N, att jämföra med
+// gauss5. Efter skalningen skrivs dess fel mot en exakt Gauss per sigma.
+// "median rN" och "max rN" är rangfilter (rankfilter.c) med radie N.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal.h"
+#include "host_kernels.h"
+#include "kernels.h"
+#include "chain.h"
+#include "image.h"
+#include "tile.h"
+#include "parallel.h"
+#include "packed.h"
+#include "kernels_plan.h"
+#include "gauss_iir.h"
+#include "rankfilter.h"
+#include "cat_image.h"
+
+
+// Kedjor som körs i båda ordningarna
+static const int chain_pairs[][2] = { { 6, 3 }, { 1, 0 }, { 2, 5 }, { 6, 6 } };
+
+// Sigma för rekursiv Gauss: kostnaden ska vara densamma
+static const int iir_sigmas[] = { 1, 2, 5, 10, 20, 32 };
+#define IIR_SIGMAS ((int)(sizeof(iir_sigmas) / sizeof(iir_sigmas[0])))
+
+// Rangfilter: kostnaden ska inte växa med radien
+static const struct {
+    const char* name;
+    int percentile, radius;
+} rank_cases[] = {
+    { "median", RANK_MEDIAN, 1 }, { "median", RANK_MEDIAN, 3 }, { "median", RANK_MEDIAN, 7 },
+    { "median", RANK_MEDIAN, 15 }, { "max", RANK_MAX, 15 },
+};
+
+// Egna kernels: glesa, osymmetriska och stora
+typedef struct {
+    const char* name;
+    int ksize, divisor;
+    int table[KERNEL_MAX_SIZE * KERNEL_MAX_SIZE];
+} bench_kernel_t;
+
+static bench_kernel_t custom_kernels[] = {
+    { "gauss5", 5, 256, { 1, 4, 6, 4, 1, 4, 16, 24, 16, 4, 6, 24, 36, 24, 6, 4, 16, 24, 16, 4, 1, 4, 6, 4, 1 } },
+    { "diag7", 7, 7, { 0 } },
+    { "ramp7", 7, 13, { 0 } },
+    { "box15", 15, 225, { 0 } },
+};
+
+static void custom_kernels_init(void) {
+    for (int i = 0; i < 7; i++) custom_kernels[1].table[i * 7 + i] = 1;
+    for (int i = 0; i < 49; i++) custom_kernels[2].table[i] = i * 37 % 29 - 9;
+    for (int i = 0; i < 225; i++) custom_kernels[3].table[i] = 1;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char* name, int size, double sec, double bytes) {
+    double px = (double)size * size;
+    printf("%-20s %5d  %10.3f ms  %8.1f Mpx/s  %7.2f ns/px  %8.2f MB\n",
+           name, size, sec * 1e3, px / sec * 1e-6, sec * 1e9 / px, bytes * 1e-6);
+}
+
+// Kör body tills minst min_sec har gått (minst en gång), ger tid per varv
+#define TIME_LOOP(min_sec, body) ({                     \
+    int reps_ = 0;                                      \
+    double t0_ = now_sec(), dt_;                        \
+    do {                                                \
+        body;                                           \
+        reps_++;                                        \
+        dt_ = now_sec() - t0_;                          \
+    } while (dt_ < (min_sec));                          \
+    dt_ / reps_;                                        \
+})
+
+int main(int argc, char** argv) {
+    int max_size = 4096;
+    double min_sec = 0.2;
+    int max_threads = 16;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:t:j:")) != -1) {
+        switch (opt) {
+            case 'm': max_size = atoi(optarg); break;
+            case 't': min_sec = atof(optarg); break;
+            case 'j': max_threads = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-m max_size] [-t seconds] [-j max_threads]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (max_size > CONV_MAX_WIDTH) max_size = CONV_MAX_WIDTH;
+
+    hal_host_set_quiet(1);
+    custom_kernels_init();
+    static kernel_plan_t plans[sizeof(custom_kernels) / sizeof(custom_kernels[0])];
+    for (unsigned int i = 0; i < sizeof(plans) / sizeof(plans[0]); i++) {
+        const bench_kernel_t* c = &custom_kernels[i];
+        kernel_plan_compile(&plans[i], c->table, c->ksize, c->divisor, 0);
+    }
+    static gauss_iir_t iir[IIR_SIGMAS];
+    for (int i = 0; i < IIR_SIGMAS; i++) gauss_iir_init(&iir[i], iir_sigmas[i] * GAUSS_IIR_SIGMA_ONE);
+
+    size_t cap = (size_t)max_size * max_size;
+    unsigned char* in = aligned_alloc(64, cap);
+    unsigned char* out = aligned_alloc(64, cap);
+    unsigned char* packed = malloc(packed_bound(max_size, max_size));
+    if (!in || !out || !packed) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    printf("%-20s %5s  %13s  %14s  %13s  %11s\n", "case", "size", "time", "throughput", "per pixel", "touched");
+    for (int size = 64; size <= max_size; size *= 2) {
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                in[(size_t)y * size + x] = cat_img[y % 256][x % 256];
+            }
+        }
+        double img = (double)size * size;
+
+        for (int k = 0; k < 8; k++) {
+            const conv_kernel_t* kern = kernel_by_index(k);
+            double sec = TIME_LOOP(min_sec, convolve_kernel(in, out, size, size, kern, NULL));
+            report(kernel_names[k], size, sec, 2 * img);
+        }
+
+        // Bara ett 32x32-område mitt i bilden, per pixel i hela bilden
+        if (size >= 64) {
+            image_t src, dst;
+            image_init(&src, in, size, size, size);
+            image_init(&dst, out, size, size, size);
+            rect_t roi = { size / 2 - 16, size / 2 - 16, 32, 32 };
+            const conv_kernel_t* kern = kernel_by_index(6);
+            double sec = TIME_LOOP(min_sec, convolve_image(&src, &dst, kern, &roi, NULL));
+            report("gauss5 roi32", size, sec, 2.0 * 36 * 36);
+        }
+
+        // Cacheblockat med autotunad rutstorlek, för bilder större än cachen
+        if (size >= 1024) {
+            image_t src, dst;
+            image_init(&src, in, size, size, size);
+            image_init(&dst, out, size, size, size);
+            for (int k = 6; k <= 7; k++) {
+                const conv_kernel_t* kern = kernel_by_index(k);
+                tile_config_t cfg;
+                tile_autotune(&src, &dst, kern, NULL, &cfg);
+                double sec = TIME_LOOP(min_sec, convolve_tiled(&src, &dst, kern, &cfg, NULL));
+                char name[32];
+                snprintf(name, sizeof(name), "%s %dx%d", kernel_names[k], cfg.tile_w, cfg.tile_h);
+                report(name, size, sec, 2 * img);
+            }
+        }
+
+        for (unsigned int p = 0; p < sizeof(chain_pairs) / sizeof(chain_pairs[0]); p++) {
+            for (int order = 0; order < 2; order++) {
+                int a = chain_pairs[p][order];
+                int b = chain_pairs[p][!order];
+                if (order == 1 && a == b) continue;
+                const conv_kernel_t* k1 = kernel_by_index(a);
+                const conv_kernel_t* k2 = kernel_by_index(b);
+                conv_options_t opts = { BORDER_ZERO, 0 };
+                double sec = TIME_LOOP(min_sec, convolve_chain(in, out, size, size, k1, k2, &opts));
+                char name[32];
+                snprintf(name, sizeof(name), "%s>%s", kernel_names[a], kernel_names[b]);
+                // Indata och utdata plus ringen med k2 mellanrader
+                report(name, size, sec, 2 * img + (double)k2->ksize * size);
+            }
+        }
+
+        for (unsigned int i = 0; i < sizeof(plans) / sizeof(plans[0]); i++) {
+            const bench_kernel_t* c = &custom_kernels[i];
+            char name[32];
+            double sec = TIME_LOOP(min_sec, convolve_kernel(in, out, size, size, &plans[i].kernel, NULL));
+            snprintf(name, sizeof(name), "%s plan", c->name);
+            report(name, size, sec, 2 * img);
+            sec = TIME_LOOP(min_sec, convolve_ex(in, out, size, size, c->table, c->ksize, c->divisor, 0, NULL));
+            snprintf(name, sizeof(name), "%s ex", c->name);
+            report(name, size, sec, 2 * img);
+        }
+
+        for (int i = 0; i < IIR_SIGMAS; i++) {
+            char name[32];
+            double sec = TIME_LOOP(min_sec, gauss_iir(in, out, size, size, &iir[i], BORDER_ZERO));
+            snprintf(name, sizeof(name), "iir s%d", iir_sigmas[i]);
+            // Utdata skrivs två gånger (mellanlager) och läses en gång
+            report(name, size, sec, 4 * img);
+        }
+
+        for (unsigned int i = 0; i < sizeof(rank_cases) / sizeof(rank_cases[0]); i++) {
+            char name[32];
+            double sec = TIME_LOOP(min_sec, rank_filter(in, out, size, size, rank_cases[i].radius, rank_cases[i].percentile, BORDER_ZERO));
+            snprintf(name, sizeof(name), "%s r%d", rank_cases[i].name, rank_cases[i].radius);
+            // Varje indatarad läses två gånger per band
+            report(name, size, sec, 3 * img);
+        }
+
+        // Avkodning rad för rad, ensam och direkt in i en kernel
+        double packed_size = packed_encode(in, size, size, packed);
+        double sec = TIME_LOOP(min_sec, packed_decode(packed, out));
+        report("unpack", size, sec, packed_size + img);
+        for (int k = 6; k <= 7; k++) {
+            sec = TIME_LOOP(min_sec, convolve_packed(packed, out, kernel_by_index(k), NULL));
+            char name[32];
+            snprintf(name, sizeof(name), "%s packed", kernel_names[k]);
+            report(name, size, sec, packed_size + img);
+        }
+    }
+
+    // Skalning över trådar på största storleken. Varje körning jämförs
+    // bit för bit med en enkeltrådad.
+    int size = 64;
+    while (size * 2 <= max_size) size *= 2;
+    unsigned char* ref = aligned_alloc(64, cap);
+    if (!ref) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            in[(size_t)y * size + x] = cat_img[y % 256][x % 256];
+        }
+    }
+    image_t src, dst;
+    image_init(&src, in, size, size, size);
+    image_init(&dst, out, size, size, size);
+    const conv_kernel_t* kg = kernel_by_index(6);
+    const conv_kernel_t* ks = kernel_by_index(3);
+    conv_options_t opts = { BORDER_ZERO, 0 };
+
+    printf("\n%-20s %5s  %7s  %13s  %8s\n", "parallel", "size", "threads", "time", "speedup");
+    for (int c = 0; c < 2; c++) {
+        const char* name = c == 0 ? "gauss5" : "gauss5>sharpen3";
+        if (c == 0) convolve_kernel(in, ref, size, size, kg, NULL);
+        else convolve_chain(in, ref, size, size, kg, ks, &opts);
+
+        double base = 0;
+        for (int t = 1; t <= max_threads; t *= 2) {
+            double sec = c == 0
+                ? TIME_LOOP(min_sec, convolve_parallel(&src, &dst, kg, NULL, t))
+                : TIME_LOOP(min_sec, convolve_chain_parallel(&src, &dst, kg, ks, &opts, t));
+            if (t == 1) base = sec;
+            printf("%-20s %5d  %7d  %10.3f ms  %7.2fx%s\n", name, size, t, sec * 1e3, base / sec,
+                   memcmp(ref, out, (size_t)size * size) ? "  MISMATCH" : "");
+        }
+    }
+
+    // Rekursiv Gauss mot en exakt samplad Gauss på kattbilden
+    static double exact[256 * 256];
+    printf("\n%-20s %5s  %8s  %8s  %8s\n", "iir accuracy", "sigma", "max err", "mean err", "PSNR");
+    for (int i = 0; i < IIR_SIGMAS; i++) {
+        for (int b = 0; b < 2; b++) {
+            double max, mean, sq = 0;
+            gauss_iir(&cat_img[0][0], out, 256, 256, &iir[i], (border_mode_t)b);
+            gauss_reference(&cat_img[0][0], exact, 256, 256, iir_sigmas[i], (border_mode_t)b);
+            gauss_error(out, exact, 256 * 256, &max, &mean);
+            for (int p = 0; p < 256 * 256; p++) sq += (out[p] - exact[p]) * (out[p] - exact[p]);
+            printf("%-20s %5d  %8.2f  %8.3f  %5.1f dB\n", border_names[b], iir_sigmas[i], max, mean,
+                   10 * log10(255.0 * 255.0 * 256 * 256 / sq));
+        }
+    }
+
+    free(ref);
+    free(in);
+    free(out);
+    return 0;
+}
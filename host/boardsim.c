@@ -0,0 +1,93 @@
+// boardsim.c
+// Kortets sida av UART-protokollet på värden, för att prova imglink utan
+// kort. JTAG UART ersätts av en pseudoterminal. xfer.c, jobben och
+// resultatcachen körs som i huvudloopen i main.c, och timer-ticket
+// (input_sample()) kommer från klockan i stället för från en interrupt.
+//
+//   boardsim                  skriv ut pty:ns namn och kör tills den avbryts
+//   boardsim kommando ...     kör kommandot med pty:ns namn i $DTEKV_PTY och
+//                             avsluta med dess exitstatus
+//
+// Till exempel: boardsim sh -c 'imglink -d $DTEKV_PTY upload cat.raw'
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "hal.h"
+#include "input.h"
+#include "process.h"
+#include "cache.h"
+#include "xfer.h"
+
+int main(int argc, char** argv) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+        perror("posix_openpt");
+        return 1;
+    }
+    const char* name = ptsname(master);
+
+    // Rått läge, och slaven hålls öppen så att pty:n finns kvar mellan
+    // klienterna
+    int slave = open(name, O_RDWR | O_NOCTTY);
+    struct termios t;
+    if (slave < 0 || tcgetattr(slave, &t) < 0) {
+        perror(name);
+        return 1;
+    }
+    cfmakeraw(&t);
+    tcsetattr(slave, TCSANOW, &t);
+    fcntl(master, F_SETFL, O_NONBLOCK);
+
+    pid_t child = 0;
+    if (argc > 1) {
+        setenv("DTEKV_PTY", name, 1);
+        child = fork();
+        if (child == 0) {
+            close(master);
+            execvp(argv[1], argv + 1);
+            perror(argv[1]);
+            _exit(127);
+        }
+    } else {
+        printf("%s\n", name);
+        fflush(stdout);
+    }
+
+    hal_host_set_uart_fd(master);
+    cache_init(CACHE_BUDGET);
+    xfer_init();
+    input_init();
+
+    unsigned long long next_tick = hal_cycles();
+    unsigned int job_tick = 0;
+    int status = 0;
+    while (1) {
+        if (child > 0 && waitpid(child, &status, WNOHANG) == child) break;
+
+        // Ett tick per millisekund, som timer-interrupten på kortet
+        unsigned long long now = hal_cycles();
+        while (now >= next_tick) {
+            input_sample();
+            next_tick += 1000000000ULL / INPUT_TICK_HZ;
+        }
+
+        xfer_status_t link = xfer_service();
+        if (link == XFER_STARTED) job_tick = input_ticks();
+
+        if (process_busy()) {
+            if (!process_step(PROCESS_CHUNK_ROWS)) {
+                fprintf(stderr, "boardsim: processing complete in %u ms\n", input_ticks() - job_tick);
+            }
+        } else if (link == XFER_IDLE) {
+            struct pollfd pfd = { master, POLLIN, 0 };
+            poll(&pfd, 1, 1);
+        }
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
@@ -0,0 +1,602 @@
+// golden.c
+// Regressionstest mot guldfacit: kör alla inbyggda kernels (alla kantlägen),
+// stor box blur och alla kedjor av två kernels på kattbilden och jämför en
+// FNV-1a-hash av varje utbild med golden/cat_256.txt. Dessutom ska
+// Gaussian 5x5 vara byte för byte lika med golden/processed_cat.raw.
+// Samma kernels och kedjor körs också direkt ur en packad kattbild.
+// Kompilerade planer (kernels_plan.c) av de inbyggda kernlarna ska ge samma
+// hashar, och egna kernels samma bytes som convolve_ex() med vikterna.
+// Rekursiv Gauss (gauss_iir.c) hashas också, och felet mot en exakt
+// samplad Gauss får inte överstiga gränserna i iir_cases. Rangfiltren
+// (rankfilter.c) ska ge samma bytes som en enkel räkning per pixel.
+// Cacheblockat (tile.c) med olika rutor ska ge samma hashar som hela bilden.
+// Box blur ska i alla kantlägen ge samma bytes som convolve_ex() med en
+// kernel av ettor, och integral_sum() samma summor som en enkel räkning.
+// Ett utsnitt (convolve_image() med roi) ska ge samma bytes som hela
+// bilden, och process_dirty() efter ändrade 32x32-block samma bytes som
+// att räkna om allt.
+//
+//   golden [-d katalog]   kontrollera, exit 1 vid avvikelse
+//   golden -w             skriv ut aktuella hashar i facitformat
+//
+// Facit togs fram med den ursprungliga konvolutionen pixel för pixel; en
+// optimerad väg måste ge exakt samma bytes.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "hal.h"
+#include "host_kernels.h"
+#include "main.h"
+#include "menu.h"
+#include "process.h"
+#include "kernels.h"
+#include "boxfilter.h"
+#include "gauss_iir.h"
+#include "rankfilter.h"
+#include "chain.h"
+#include "parallel.h"
+#include "tile.h"
+#include "packed.h"
+#include "kernels_plan.h"
+#include "cat_image.h"
+
+#define GOLDEN_MAX 256
+
+typedef struct {
+    char name[48];
+    unsigned long long hash;
+} golden_entry_t;
+
+static const int box_radii[8] = { 1, 2, 3, 5, 7, 10, 15, 31 };
+
+// Rekursiv Gauss: menyns sigma, och största tillåtna fel mot en exakt
+// samplad Gauss (max och medel, gråskalenivåer) i alla kantlägen.
+// Young-van Vliet är som sämst för små sigma.
+typedef struct {
+    int sigma;
+    double max_error, mean_error;
+} iir_case_t;
+
+static const iir_case_t iir_cases[8] = {
+    { 1, 20, 3.5 }, { 2, 10, 3.5 }, { 3, 9, 3 }, { 4, 12, 3.5 },
+    { 6, 8, 2 }, { 10, 5, 1 }, { 15, 3.5, 1 }, { 20, 3.5, 1 },
+};
+
+static golden_entry_t expected[GOLDEN_MAX];
+static int expected_count;
+static unsigned char out[IMG_HEIGHT * IMG_WIDTH];
+static int write_mode;
+static int failures;
+static int checked;
+
+static unsigned long long fnv1a64(const unsigned char* p, size_t n) {
+    unsigned long long h = 0xcbf29ce484222325ULL;
+    while (n--) {
+        h ^= *p++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static int load_manifest(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        if (expected_count == GOLDEN_MAX) break;
+        golden_entry_t* e = &expected[expected_count];
+        if (sscanf(line, "%47s %llx", e->name, &e->hash) == 2) expected_count++;
+    }
+    fclose(f);
+    return 1;
+}
+
+static void check(const char* name) {
+    unsigned long long h = fnv1a64(out, sizeof(out));
+    if (write_mode) {
+        printf("%-24s %016llx\n", name, h);
+        return;
+    }
+    checked++;
+    for (int i = 0; i < expected_count; i++) {
+        if (strcmp(expected[i].name, name) == 0) {
+            if (expected[i].hash != h) {
+                fprintf(stderr, "FAIL %s: got %016llx, expected %016llx\n", name, h, expected[i].hash);
+                failures++;
+            }
+            return;
+        }
+    }
+    fprintf(stderr, "FAIL %s: missing from manifest\n", name);
+    failures++;
+}
+
+// Egna kernels som täcker analysens alla vägar: glesa, täta, separerbara,
+// osymmetriska, fixpunkt (skift), udda divisorer (invers), negativa summor
+// och offset, och största storleken
+typedef struct {
+    const char* name;
+    int ksize, divisor, offset;
+    int (*weight)(int y, int x, int ksize);
+} custom_case_t;
+
+static int w_diagonal(int y, int x, int n) { (void)n; return y == x; }
+static int w_emboss(int y, int x, int n) { return (y < n / 2) - (y > n / 2) + (x < n / 2) - (x > n / 2); }
+static int w_binomial(int y, int x, int n) {
+    static const int b[9] = { 1, 8, 28, 56, 70, 56, 28, 8, 1 };
+    (void)n;
+    return b[y] * b[x];
+}
+static int w_box(int y, int x, int n) { (void)y; (void)x; (void)n; return 1; }
+static int w_ramp(int y, int x, int n) { return (y * n + x) * 37 % 29 - 9; }
+static int w_log(int y, int x, int n) {
+    int d = (y - n / 2) * (y - n / 2) + (x - n / 2) * (x - n / 2);
+    return d == 0 ? 24 : d <= 2 ? -2 : d <= 8 ? -1 : 0;
+}
+static int w_ring(int y, int x, int n) {
+    int d = (y - n / 2) * (y - n / 2) + (x - n / 2) * (x - n / 2);
+    return d >= 36 && d <= 49 ? 3 : 0;
+}
+static int w_large(int y, int x, int n) { return ((y + 1) * (x + 2) * 7919) % 60001 - 30000 + n; }
+
+static const custom_case_t custom_cases[] = {
+    { "diagonal7", 7, 7, 0, w_diagonal },
+    { "emboss5", 5, 1, 128, w_emboss },
+    { "binomial9", 9, 65536, 0, w_binomial },
+    { "box15", 15, 225, 0, w_box },
+    { "ramp3_fixed", 3, 1024, 64, w_ramp },
+    { "ramp7_div13", 7, 13, -20, w_ramp },
+    { "log9_div3", 9, 3, 10, w_log },
+    { "ring15", 15, 97, 0, w_ring },
+    { "large11", 11, 65521, 128, w_large },
+};
+
+static void check_same(const char* name, const unsigned char* ref, const char* what) {
+    checked++;
+    if (memcmp(out, ref, IMG_WIDTH * IMG_HEIGHT) != 0) {
+        fprintf(stderr, "FAIL %s differs from %s\n", name, what);
+        failures++;
+    }
+}
+
+// Planen mot convolve_ex() i alla kantlägen, flertrådat och i en kedja
+static void check_custom(const unsigned char* in, const custom_case_t* c) {
+    static kernel_plan_t plan;
+    static unsigned char ref[IMG_HEIGHT * IMG_WIDTH];
+    int table[KERNEL_MAX_SIZE * KERNEL_MAX_SIZE];
+    char name[64];
+    for (int y = 0; y < c->ksize; y++) {
+        for (int x = 0; x < c->ksize; x++) table[y * c->ksize + x] = c->weight(y, x, c->ksize);
+    }
+    checked++;
+    if (!kernel_plan_compile(&plan, table, c->ksize, c->divisor, c->offset)) {
+        fprintf(stderr, "FAIL %s: kernel_plan_compile refused it\n", c->name);
+        failures++;
+        return;
+    }
+
+    for (int b = 0; b < 4; b++) {
+        conv_options_t opts = { (border_mode_t)b, 0 };
+        convolve_ex(in, ref, IMG_WIDTH, IMG_HEIGHT, table, c->ksize, c->divisor, c->offset, &opts);
+        convolve_kernel(in, out, IMG_WIDTH, IMG_HEIGHT, &plan.kernel, &opts);
+        snprintf(name, sizeof(name), "plan_%s_%s", c->name, border_names[b]);
+        check_same(name, ref, "convolve_ex");
+
+        image_t src, dst;
+        image_init(&src, (unsigned char*)in, IMG_WIDTH, IMG_HEIGHT, IMG_WIDTH);
+        image_init(&dst, out, IMG_WIDTH, IMG_HEIGHT, IMG_WIDTH);
+        convolve_parallel(&src, &dst, &plan.kernel, &opts, 4);
+        snprintf(name, sizeof(name), "plan_%s_%s_parallel", c->name, border_names[b]);
+        check_same(name, ref, "convolve_ex");
+    }
+
+    // Kedjan med den generiska rutinen som facit
+    conv_kernel_t plain = { plan.table, c->ksize, c->divisor, c->offset, NULL, NULL };
+    conv_options_t opts = { BORDER_ZERO, 0 };
+    convolve_chain(in, ref, IMG_WIDTH, IMG_HEIGHT, &plain, kernel_by_index(6), &opts);
+    convolve_chain(in, out, IMG_WIDTH, IMG_HEIGHT, &plan.kernel, kernel_by_index(6), &opts);
+    snprintf(name, sizeof(name), "plan_%s_chain_gauss5", c->name);
+    check_same(name, ref, "convolve_ex");
+}
+
+// Facit för rank_filter(): ett histogram per rad som glider en kolumn i
+// taget (Huang), och rangvärdet letas upp bland alla 256 nivåer
+static void rank_reference(const unsigned char* in, unsigned char* ref, int width, int height, int radius, int percentile, border_mode_t border) {
+    int n = (2 * radius + 1) * (2 * radius + 1);
+    int rank = ((n - 1) * percentile + 50) / 100;
+    for (int y = 0; y < height; y++) {
+        int hist[256] = { 0 };
+        for (int x = 0; x < width; x++) {
+            for (int dy = -radius; dy <= radius; dy++) {
+                int sy = conv_border_index(y + dy, height, border);
+                const unsigned char* row = sy < 0 ? conv_zero_row : in + sy * width;
+                for (int dx = x ? radius : -radius; dx <= radius; dx++) {
+                    int sx = conv_border_index(x + dx, width, border);
+                    hist[sx < 0 ? 0 : row[sx]]++;
+                }
+                if (x) {
+                    int sx = conv_border_index(x - radius - 1, width, border);
+                    hist[sx < 0 ? 0 : row[sx]]--;
+                }
+            }
+            int v = 0, sum = hist[0];
+            while (sum <= rank) sum += hist[++v];
+            ref[y * width + x] = (unsigned char)v;
+        }
+    }
+}
+
+// Alla kantlägen, bilden som 256 bred och som 250 bred (ett ofullständigt band)
+static void check_rank(const unsigned char* in, const char* image, int radius, int percentile) {
+    static unsigned char ref[IMG_HEIGHT * IMG_WIDTH];
+    static const int shapes[2][2] = { { IMG_WIDTH, IMG_HEIGHT }, { 250, IMG_WIDTH * IMG_HEIGHT / 250 } };
+    char name[64];
+    for (int s = 0; s < 2; s++) {
+        int w = shapes[s][0], h = shapes[s][1];
+        for (int b = 0; b < 4; b++) {
+            memset(out, 0, sizeof(out));
+            memset(ref, 0, sizeof(ref));
+            rank_filter(in, out, w, h, radius, percentile, (border_mode_t)b);
+            rank_reference(in, ref, w, h, radius, percentile, (border_mode_t)b);
+            snprintf(name, sizeof(name), "rank_%s_r%d_p%d_%dx%d_%s", image, radius, percentile, w, h, border_names[b]);
+            check_same(name, ref, "the per-pixel count");
+        }
+    }
+}
+
+// box_filter() mot convolve_ex() med (2r+1)^2 ettor, alla kantlägen
+static void check_box(const unsigned char* in) {
+    static unsigned char ref[IMG_HEIGHT * IMG_WIDTH];
+    static int ones[KERNEL_MAX_SIZE * KERNEL_MAX_SIZE];
+    char name[64];
+    for (int i = 0; i < KERNEL_MAX_SIZE * KERNEL_MAX_SIZE; i++) ones[i] = 1;
+    for (int r = 0; 2 * r + 1 <= KERNEL_MAX_SIZE; r++) {
+        int ksize = 2 * r + 1;
+        for (int b = 0; b < 4; b++) {
+            conv_options_t opts = { (border_mode_t)b, 0 };
+            convolve_ex(in, ref, IMG_WIDTH, IMG_HEIGHT, ones, ksize, ksize * ksize, 0, &opts);
+            box_filter(in, out, IMG_WIDTH, IMG_HEIGHT, r, (border_mode_t)b);
+            snprintf(name, sizeof(name), "box_r%d_%s", r, border_names[b]);
+            check_same(name, ref, "convolve_ex");
+        }
+    }
+}
+
+// integral_sum() mot en summa pixel för pixel: slumpade rektanglar, och
+// rektanglar som når kanterna, hela bilden och tomma
+static void check_integral(const unsigned char* in) {
+    static unsigned int sat[(IMG_HEIGHT + 1) * (IMG_WIDTH + 1)];
+    integral_image(in, sat, IMG_WIDTH, IMG_HEIGHT);
+
+    unsigned int seed = 7;
+    for (int i = 0; i < 2000; i++) {
+        int c[4];
+        for (int j = 0; j < 4; j++) {
+            seed = seed * 1103515245u + 12345u;
+            c[j] = (seed >> 16) % (j & 1 ? IMG_HEIGHT + 1 : IMG_WIDTH + 1);
+        }
+        // Först hela bilden och två tomma; sedan når var annan en kant
+        // (vänster, övre, höger, nedre i tur och ordning)
+        if (i == 0) {
+            c[0] = 0; c[1] = 0; c[2] = IMG_WIDTH; c[3] = IMG_HEIGHT;
+        } else if (i == 1) {
+            c[2] = c[0];
+        } else if (i == 2) {
+            c[3] = c[1];
+        } else if (i % 2 == 0) {
+            int j = i / 2 % 4;
+            c[j] = j < 2 ? 0 : j == 2 ? IMG_WIDTH : IMG_HEIGHT;
+        }
+        int x0 = c[0] < c[2] ? c[0] : c[2], x1 = c[0] < c[2] ? c[2] : c[0];
+        int y0 = c[1] < c[3] ? c[1] : c[3], y1 = c[1] < c[3] ? c[3] : c[1];
+
+        unsigned int sum = 0;
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) sum += in[y * IMG_WIDTH + x];
+        }
+        unsigned int got = integral_sum(sat, IMG_WIDTH, x0, y0, x1, y1);
+        checked++;
+        if (got != sum) {
+            fprintf(stderr, "FAIL integral_sum [%d,%d) x [%d,%d): got %u, expected %u\n", x0, x1, y0, y1, got, sum);
+            failures++;
+        }
+    }
+}
+
+// Ett utsnitt som inte börjar i vänsterkanten: resten av out har redan
+// facit, utsnittet skräp tills convolve_image() skriver det
+static void check_roi(const unsigned char* in, int k, border_mode_t border) {
+    static const rect_t roi = { 37, 50, 61, 90 };
+    conv_options_t opts = { border, 0 };
+    image_t src, dst;
+    char name[48];
+    convolve_kernel(in, out, IMG_WIDTH, IMG_HEIGHT, kernel_by_index(k), &opts);
+    for (int y = roi.y; y < roi.y + roi.h; y++) memset(out + y * IMG_WIDTH + roi.x, 0xa5, roi.w);
+    image_init(&src, (unsigned char*)in, IMG_WIDTH, IMG_HEIGHT, IMG_WIDTH);
+    image_init(&dst, out, IMG_WIDTH, IMG_HEIGHT, IMG_WIDTH);
+    convolve_image(&src, &dst, kernel_by_index(k), &roi, &opts);
+    snprintf(name, sizeof(name), "%s_%s", kernel_names[k], border_names[border]);
+    check(name);
+}
+
+// Skriver brus i ett 32x32-block av indata och markerar det
+static void patch_input(int x, int y, unsigned int* seed) {
+    unsigned char* img = input_writable();
+    rect_t r = { x, y, 32, 32 };
+    for (int j = y; j < y + 32; j++) {
+        for (int i = x; i < x + 32; i++) {
+            *seed = *seed * 1103515245u + 12345u;
+            img[j * IMG_WIDTH + i] = (unsigned char)(*seed >> 16);
+        }
+    }
+    input_mark_dirty(&r);
+}
+
+// process_dirty() mot hela filtret på den ändrade bilden: ett block mitt i,
+// sedan två till, varav ett i hörnet, innan nästa omräkning
+static void check_dirty(int switches) {
+    static unsigned char ref[IMG_HEIGHT * IMG_WIDTH];
+    static const int blocks[3][2] = { { 100, 70 }, { IMG_WIDTH - 32, 0 }, { 0, 150 } };
+    menu_state_t menu;
+    char name[48];
+    unsigned int seed = (unsigned int)switches + 3;
+    menu_init(&menu);
+    menu_update(&menu, switches, 0);
+    const conv_kernel_t* k = get_selected_kernel(&menu);
+    conv_options_t opts = { BORDER_ZERO, 0 };
+
+    reset_images();
+    apply_filter(&menu, image_src, &output_img[0][0]);
+    for (int round = 0; round < 2; round++) {
+        if (round == 0) {
+            patch_input(blocks[0][0], blocks[0][1], &seed);
+        } else {
+            patch_input(blocks[1][0], blocks[1][1], &seed);
+            patch_input(blocks[2][0], blocks[2][1], &seed);
+        }
+        snprintf(name, sizeof(name), "dirty_%d%s", k->ksize, round ? "_edges" : "");
+        checked++;
+        if (!process_dirty()) {
+            fprintf(stderr, "FAIL %s (switches 0x%x): process_dirty refused\n", name, switches);
+            failures++;
+            continue;
+        }
+        convolve_kernel(image_src, ref, IMG_WIDTH, IMG_HEIGHT, k, &opts);
+        memcpy(out, output_img, sizeof(out));
+        check_same(name, ref, "a full recompute");
+    }
+}
+
+static int check_raw(const char* path) {
+    static unsigned char ref[IMG_HEIGHT * IMG_WIDTH];
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    size_t n = fread(ref, 1, sizeof(ref), f);
+    fclose(f);
+    return n == sizeof(ref) && memcmp(ref, out, sizeof(ref)) == 0;
+}
+
+int main(int argc, char** argv) {
+    const char* dir = "golden";
+    char path[512];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:w")) != -1) {
+        switch (opt) {
+            case 'd': dir = optarg; break;
+            case 'w': write_mode = 1; break;
+            default:
+                fprintf(stderr, "usage: %s [-d golden_dir] [-w]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    hal_host_set_quiet(1);
+    const unsigned char* in = &cat_img[0][0];
+
+    if (!write_mode) {
+        snprintf(path, sizeof(path), "%s/cat_256.txt", dir);
+        if (!load_manifest(path)) return 1;
+    }
+
+    char name[48];
+    for (int k = 0; k < 8; k++) {
+        for (int b = 0; b < 4; b++) {
+            conv_options_t opts = { (border_mode_t)b, 0 };
+            convolve_kernel(in, out, IMG_WIDTH, IMG_HEIGHT, kernel_by_index(k), &opts);
+            snprintf(name, sizeof(name), "%s_%s", kernel_names[k], border_names[b]);
+            check(name);
+
+            // Originalets referensutdata
+            if (!write_mode && k == 6 && b == BORDER_ZERO) {
+                snprintf(path, sizeof(path), "%s/processed_cat.raw", dir);
+                checked++;
+                if (!check_raw(path)) {
+                    fprintf(stderr, "FAIL %s differs from %s\n", name, path);
+                    failures++;
+                }
+            }
+        }
+    }
+
+    for (int r = 0; r < 8; r++) {
+        box_filter(in, out, IMG_WIDTH, IMG_HEIGHT, box_radii[r], BORDER_ZERO);
+        snprintf(name, sizeof(name), "box_r%d", box_radii[r]);
+        check(name);
+    }
+
+    // Rekursiv Gauss är inte bit-exakt mot något facit, men deterministisk
+    gauss_iir_t iir;
+    for (int s = 0; s < 8; s++) {
+        gauss_iir_init(&iir, iir_cases[s].sigma * GAUSS_IIR_SIGMA_ONE);
+        for (int b = 0; b < 4; b++) {
+            gauss_iir(in, out, IMG_WIDTH, IMG_HEIGHT, &iir, (border_mode_t)b);
+            snprintf(name, sizeof(name), "iir_s%d_%s", iir_cases[s].sigma, border_names[b]);
+            check(name);
+        }
+    }
+
+    // Alla par i båda ordningarna, strömmat utan sammansättning
+    for (int k1 = 0; k1 < 8; k1++) {
+        for (int k2 = 0; k2 < 8; k2++) {
+            conv_options_t opts = { BORDER_ZERO, 0 };
+            convolve_chain(in, out, IMG_WIDTH, IMG_HEIGHT, kernel_by_index(k1), kernel_by_index(k2), &opts);
+            snprintf(name, sizeof(name), "chain_%s_%s", kernel_names[k1], kernel_names[k2]);
+            check(name);
+        }
+    }
+
+    if (write_mode) return 0;
+
+    // Felet mot en exakt Gauss, med bilden och ett skarpt rutmönster
+    static unsigned char grid[IMG_HEIGHT * IMG_WIDTH];
+    static double ref[IMG_HEIGHT * IMG_WIDTH];
+    for (int i = 0; i < IMG_HEIGHT * IMG_WIDTH; i++) {
+        grid[i] = ((i / IMG_WIDTH / 16 + i % IMG_WIDTH / 16) & 1) ? 230 : 20;
+    }
+    for (int s = 0; s < 8; s++) {
+        const iir_case_t* c = &iir_cases[s];
+        gauss_iir_init(&iir, c->sigma * GAUSS_IIR_SIGMA_ONE);
+        for (int img = 0; img < 2; img++) {
+            const unsigned char* src = img ? grid : in;
+            for (int b = 0; b < 4; b++) {
+                double max, mean;
+                gauss_iir(src, out, IMG_WIDTH, IMG_HEIGHT, &iir, (border_mode_t)b);
+                gauss_reference(src, ref, IMG_WIDTH, IMG_HEIGHT, c->sigma, (border_mode_t)b);
+                gauss_error(out, ref, IMG_WIDTH * IMG_HEIGHT, &max, &mean);
+                checked++;
+                if (max > c->max_error || mean > c->mean_error) {
+                    fprintf(stderr, "FAIL iir_s%d_%s%s: error max %.2f mean %.3f, allowed %.2f %.3f\n",
+                            c->sigma, border_names[b], img ? "_grid" : "", max, mean, c->max_error, c->mean_error);
+                    failures++;
+                }
+            }
+        }
+    }
+
+    // Flertrådat ska ge samma bytes, jämförs mot samma facit
+    image_t src, dst;
+    image_init(&src, (unsigned char*)in, IMG_WIDTH, IMG_HEIGHT, IMG_WIDTH);
+    image_init(&dst, out, IMG_WIDTH, IMG_HEIGHT, IMG_WIDTH);
+    for (int k = 0; k < 8; k++) {
+        for (int b = 0; b < 4; b++) {
+            conv_options_t opts = { (border_mode_t)b, 0 };
+            convolve_parallel(&src, &dst, kernel_by_index(k), &opts, 4);
+            snprintf(name, sizeof(name), "%s_%s", kernel_names[k], border_names[b]);
+            check(name);
+        }
+    }
+    for (int k1 = 0; k1 < 8; k1++) {
+        for (int k2 = 0; k2 < 8; k2++) {
+            conv_options_t opts = { BORDER_ZERO, 0 };
+            convolve_chain_parallel(&src, &dst, kernel_by_index(k1), kernel_by_index(k2), &opts, 4);
+            snprintf(name, sizeof(name), "chain_%s_%s", kernel_names[k1], kernel_names[k2]);
+            check(name);
+        }
+    }
+
+    // Ruta för ruta: udda rutor, rutor bredare eller högre än bilden, hela
+    // bredden eller höjden, förslaget för en liten cache och det som
+    // tile_autotune() väljer. Mot samma facit.
+    static const tile_config_t tile_shapes[] = {
+        { 16, 8 }, { 32, 32 }, { 7, 5 }, { 0, 16 }, { 64, 0 }, { 100, 300 },
+    };
+    for (int k = 0; k < 8; k++) {
+        for (int b = 0; b < 4; b++) {
+            conv_options_t opts = { (border_mode_t)b, 0 };
+            const conv_kernel_t* kern = kernel_by_index(k);
+            tile_config_t cfg;
+            for (size_t t = 0; t < sizeof(tile_shapes) / sizeof(tile_shapes[0]); t++) {
+                memset(out, 0, sizeof(out));
+                convolve_tiled(&src, &dst, kern, &tile_shapes[t], &opts);
+                snprintf(name, sizeof(name), "%s_%s", kernel_names[k], border_names[b]);
+                check(name);
+            }
+            tile_config_for_cache(&cfg, 1024, kern->ksize);
+            memset(out, 0, sizeof(out));
+            convolve_tiled(&src, &dst, kern, &cfg, &opts);
+            check(name);
+
+            tile_autotune(&src, &dst, kern, &opts, &cfg);
+            memset(out, 0, sizeof(out));
+            convolve_tiled(&src, &dst, kern, &cfg, &opts);
+            check(name);
+        }
+    }
+
+    // De inbyggda kernlarna som kompilerade planer, mot samma facit
+    static kernel_plan_t plan;
+    for (int k = 0; k < 8; k++) {
+        const conv_kernel_t* builtin = kernel_by_index(k);
+        kernel_plan_compile(&plan, builtin->table, builtin->ksize, builtin->divisor, builtin->offset);
+        for (int b = 0; b < 4; b++) {
+            conv_options_t opts = { (border_mode_t)b, 0 };
+            convolve_kernel(in, out, IMG_WIDTH, IMG_HEIGHT, &plan.kernel, &opts);
+            snprintf(name, sizeof(name), "%s_%s", kernel_names[k], border_names[b]);
+            check(name);
+        }
+    }
+    for (size_t i = 0; i < sizeof(custom_cases) / sizeof(custom_cases[0]); i++) {
+        check_custom(in, &custom_cases[i]);
+    }
+
+    check_box(in);
+    check_integral(in);
+    for (int k = 0; k < 8; k++) {
+        for (int b = 0; b < 4; b++) check_roi(in, k, (border_mode_t)b);
+    }
+    for (int sw = 0; sw < 8; sw++) check_dirty(sw);
+
+    // Rangfilter, och median mot salt-och-peppar-brus
+    static const int rank_radii[] = { 1, 2, 7, 15 };
+    static const int rank_percentiles[] = { RANK_MIN, 25, RANK_MEDIAN, RANK_MAX };
+    for (int r = 0; r < 4; r++) {
+        for (int p = 0; p < 4; p++) check_rank(in, "cat", rank_radii[r], rank_percentiles[p]);
+    }
+    static unsigned char noisy[IMG_HEIGHT * IMG_WIDTH];
+    unsigned int seed = 1;
+    for (int i = 0; i < IMG_HEIGHT * IMG_WIDTH; i++) {
+        seed = seed * 1103515245u + 12345u;
+        int r = (seed >> 16) % 20;
+        noisy[i] = r == 0 ? 0 : r == 1 ? 255 : in[i];
+    }
+    check_rank(noisy, "noisy", 1, RANK_MEDIAN);
+    check_rank(noisy, "noisy", 2, RANK_MEDIAN);
+
+    // Direkt ur den packade bilden (wrap kan inte strömmas)
+    static unsigned char packed[IMG_HEIGHT * IMG_WIDTH * 2];
+    packed_encode(in, IMG_WIDTH, IMG_HEIGHT, packed);
+    packed_decode(packed, out);
+    checked++;
+    if (memcmp(out, cat_img, sizeof(out)) != 0) {
+        fprintf(stderr, "FAIL packed image does not decode to the original\n");
+        failures++;
+    }
+    for (int k = 0; k < 8; k++) {
+        for (int b = 0; b < 3; b++) {
+            conv_options_t opts = { (border_mode_t)b, 0 };
+            convolve_packed(packed, out, kernel_by_index(k), &opts);
+            snprintf(name, sizeof(name), "%s_%s", kernel_names[k], border_names[b]);
+            check(name);
+        }
+    }
+    for (int k1 = 0; k1 < 8; k1++) {
+        for (int k2 = 0; k2 < 8; k2++) {
+            conv_options_t opts = { BORDER_ZERO, 0 };
+            convolve_chain_packed(packed, out, kernel_by_index(k1), kernel_by_index(k2), &opts);
+            snprintf(name, sizeof(name), "chain_%s_%s", kernel_names[k1], kernel_names[k2]);
+            check(name);
+        }
+    }
+
+    printf("golden: %d checked, %d failed\n", checked, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+// hal_host.c
+// hal.h för värddatorn: switchar, knappar och lysdioder är variabler som
+// värdprogrammet sätter, JTAG UART går till stdout/stdin eller till en
+// fildeskriptor (hal_host_set_uart_fd()).
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal.h"
+
+static unsigned int host_switches;
+static unsigned int host_buttons;
+static unsigned int host_leds;
+static unsigned int host_displays[6];
+static unsigned int host_timer_period;
+static int host_quiet;
+static int host_uart_fd = -1;
+
+// Motsvarar RAM-minnet ovanför stacken på kortet
+static unsigned char host_spare_ram[4 << 20] __attribute__((aligned(4)));
+
+unsigned int hal_read_switches(void) {
+    return host_switches & 0x3FF;
+}
+
+unsigned int hal_read_buttons(void) {
+    return host_buttons;
+}
+
+void hal_write_leds(unsigned int mask) {
+    host_leds = mask & 0x3FF;
+}
+
+void hal_write_display(int n, unsigned int segments) {
+    if (n >= 0 && n < 6) host_displays[n] = segments & 0xFF;
+}
+
+// Blockerar som på kortet tills byten fått plats
+void hal_uart_putc(unsigned char c) {
+    if (host_uart_fd < 0) {
+        if (!host_quiet) putchar(c);
+        return;
+    }
+    while (write(host_uart_fd, &c, 1) != 1) {
+        if (errno != EAGAIN && errno != EINTR) return;
+        struct pollfd pfd = { host_uart_fd, POLLOUT, 0 };
+        poll(&pfd, 1, 10);
+    }
+}
+
+// Som FIFO:n på kortet; hal_uart_putc() väntar ändå själv
+unsigned int hal_uart_tx_space(void) {
+    return 64;
+}
+
+int hal_uart_getc(void) {
+    if (host_uart_fd >= 0) {
+        unsigned char c;
+        return read(host_uart_fd, &c, 1) == 1 ? c : -1;
+    }
+    int c = getchar();
+    return c == EOF ? -1 : c;
+}
+
+// Ingen interrupt på värden; perioden sparas bara
+void hal_timer_start(unsigned int period) {
+    host_timer_period = period;
+}
+
+int hal_timer_ack(void) {
+    return 0;
+}
+
+void hal_irq_enable(void) {
+}
+
+unsigned int hal_irq_save(void) {
+    return 0;
+}
+
+void hal_irq_restore(unsigned int state) {
+    (void)state;
+}
+
+void hal_wait_for_interrupt(void) {
+}
+
+unsigned long long hal_cycles(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+unsigned char* hal_spare_ram(unsigned int* size) {
+    *size = sizeof(host_spare_ram);
+    return host_spare_ram;
+}
+
+void hal_host_set_switches(unsigned int sw) {
+    host_switches = sw;
+}
+
+void hal_host_set_buttons(unsigned int btn) {
+    host_buttons = btn;
+}
+
+void hal_host_set_uart_fd(int fd) {
+    host_uart_fd = fd;
+}
+
+void hal_host_set_quiet(int quiet) {
+    host_quiet = quiet;
+}
+
+unsigned int hal_host_leds(void) {
+    return host_leds;
+}
+
+unsigned int hal_host_display(int n) {
+    return n >= 0 && n < 6 ? host_displays[n] : 0xFF;
+}
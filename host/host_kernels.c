@@ -0,0 +1,128 @@
+// host_kernels.c
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_kernels.h"
+#include "kernels_plan.h"
+#include "menu.h"
+
+const char* const kernel_names[HOST_KERNEL_COUNT] = {
+    "edge3", "box3", "gauss3", "sharpen3", "edge5", "box5", "gauss5", "sharpen5"
+};
+
+const char* const border_names[4] = { "zero", "clamp", "mirror", "wrap" };
+
+const conv_kernel_t* kernel_by_index(int i) {
+    menu_state_t menu;
+    menu_init(&menu);
+    menu_update(&menu, (i & 3) | ((i >> 2) << 2), 0);
+    return get_selected_kernel(&menu);
+}
+
+int kernel_index(const char* name) {
+    for (int i = 0; i < HOST_KERNEL_COUNT; i++) {
+        if (strcmp(name, kernel_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+int border_index(const char* name) {
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(name, border_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+// Nästa heltal i f, förbi blanktecken och kommentarer
+static int read_int(FILE* f, int* v) {
+    int c;
+    while ((c = fgetc(f)) != EOF) {
+        if (c == '#') {
+            while ((c = fgetc(f)) != EOF && c != '\n');
+        } else if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+            ungetc(c, f);
+            return fscanf(f, "%d", v) == 1;
+        }
+    }
+    return 0;
+}
+
+int kernel_file_read(const char* path, int* table, int* ksize, int* divisor, int* offset) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    int ok = read_int(f, ksize) && read_int(f, divisor) && read_int(f, offset) &&
+             *ksize >= 1 && *ksize <= KERNEL_MAX_SIZE;
+    for (int i = 0; ok && i < *ksize * *ksize; i++) {
+        ok = read_int(f, &table[i]);
+    }
+    fclose(f);
+    if (!ok) fprintf(stderr, "%s: expected size (odd, 1..%d), divisor, offset and size*size weights\n", path, KERNEL_MAX_SIZE);
+    return ok;
+}
+
+int kernel_file_load(const char* arg) {
+    char* end;
+    int slot = (int)strtol(arg, &end, 0);
+    if (*end != ':') {
+        fprintf(stderr, "%s: expected slot:file\n", arg);
+        return 0;
+    }
+
+    int table[KERNEL_MAX_SIZE * KERNEL_MAX_SIZE];
+    int ksize, divisor, offset;
+    if (!kernel_file_read(end + 1, table, &ksize, &divisor, &offset)) return 0;
+    if (!kernel_custom_load(slot, table, ksize, divisor, offset)) {
+        fprintf(stderr, "%s: invalid kernel or slot (1..%d)\n", arg, KERNEL_CUSTOM_SLOTS);
+        return 0;
+    }
+    return 1;
+}
+
+// Ett 1-D-pass längs n sampel med steget step, från src till dst
+static void gauss_line(const double* src, double* dst, int n, int step, const double* k, int r, border_mode_t border) {
+    for (int i = 0; i < n; i++) {
+        double acc = 0;
+        if (i - r >= 0 && i + r < n) {
+            for (int j = -r; j <= r; j++) acc += k[j + r] * src[(i + j) * step];
+        } else {
+            for (int j = -r; j <= r; j++) {
+                int t = conv_border_index(i + j, n, border);
+                if (t >= 0) acc += k[j + r] * src[t * step];
+            }
+        }
+        dst[i * step] = acc;
+    }
+}
+
+void gauss_reference(const unsigned char* in, double* out, int width, int height, double sigma, border_mode_t border) {
+    int r = (int)ceil(5 * sigma);
+    double* k = malloc((2 * r + 1) * sizeof(double));
+    double* tmp = malloc((size_t)width * height * sizeof(double));
+    double sum = 0;
+    for (int j = -r; j <= r; j++) {
+        k[j + r] = exp(-j * j / (2 * sigma * sigma));
+        sum += k[j + r];
+    }
+    for (int j = 0; j <= 2 * r; j++) k[j] /= sum;
+
+    for (int i = 0; i < width * height; i++) out[i] = in[i];
+    for (int y = 0; y < height; y++) gauss_line(out + y * width, tmp + y * width, width, 1, k, r, border);
+    for (int x = 0; x < width; x++) gauss_line(tmp + x, out + x, height, width, k, r, border);
+    free(tmp);
+    free(k);
+}
+
+void gauss_error(const unsigned char* img, const double* ref, int n, double* max, double* mean) {
+    double m = 0, sum = 0;
+    for (int i = 0; i < n; i++) {
+        double e = fabs(img[i] - ref[i]);
+        if (e > m) m = e;
+        sum += e;
+    }
+    *max = m;
+    *mean = sum / n;
+}
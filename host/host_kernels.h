@@ -0,0 +1,40 @@
+// host_kernels.h
+// Namn på de inbyggda kernlarna och kantlägena för värdprogrammen.
+#ifndef HOST_KERNELS_H
+#define HOST_KERNELS_H
+
+#include "kernels.h"
+
+#define HOST_KERNEL_COUNT 8
+
+// Index 0..7 i menyordning: SW[1:0] typ, SW[2] storlek
+extern const char* const kernel_names[HOST_KERNEL_COUNT];
+extern const char* const border_names[4];
+
+// Kernel i så som get_selected_kernel() väljer den
+const conv_kernel_t* kernel_by_index(int i);
+
+// "gauss5" osv, -1 om namnet är okänt
+int kernel_index(const char* name);
+
+// "zero", "clamp", "mirror" eller "wrap", -1 om okänt
+int border_index(const char* name);
+
+// Läser en egen kernel från en textfil: storlek, divisor, offset och sedan
+// storlek * storlek vikter radvis, åtskilda av blanktecken. Text efter #
+// på en rad är kommentar. Skriver ut felet och returnerar 0 om filen inte
+// går att läsa.
+int kernel_file_read(const char* path, int* table, int* ksize, int* divisor, int* offset);
+
+// "slot:fil" från -K: läser filen och laddar kerneln på platsen
+int kernel_file_load(const char* arg);
+
+// Exakt gaussisk oskärpa i flyttal, facit för gauss_iir(): samplad
+// normaliserad kernel med radie ceil(5 * sigma), rader och sedan kolumner,
+// pixlar utanför bilden enligt kantläget. out har width * height element.
+void gauss_reference(const unsigned char* in, double* out, int width, int height, double sigma, border_mode_t border);
+
+// Största och medel av |img - ref| över n pixlar
+void gauss_error(const unsigned char* img, const double* ref, int n, double* max, double* mean);
+
+#endif
@@ -0,0 +1,142 @@
+// host_main.c
+// Kör bildbehandlingskärnan på värddatorn. Switcharna anges som på kortet,
+// så samma menyval och filter körs som i firmwaren.
+//
+//   imgproc [-s switchar] [-c switchar2] [-K plats:fil] [-n varv] [-p x,y,w,h] [-o ut.raw] [in.raw]
+//
+// Utan in.raw används den inbyggda kattbilden. -c kör en kedja där -s är
+// första filtret och -c det andra. -p inverterar en rektangel i indata
+// efter filtreringen och räknar bara om den påverkade delen av utdata.
+// -K laddar en egen kernel (se host_kernels.h för filen), som sedan väljs
+// med SW[9:7] = plats och SW[5] av, som på kortet.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal.h"
+#include "main.h"
+#include "menu.h"
+#include "process.h"
+#include "host_kernels.h"
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int load_raw(const char* path, unsigned char* dst, size_t size) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    size_t n = fread(dst, 1, size, f);
+    fclose(f);
+    if (n != size) {
+        fprintf(stderr, "%s: expected %zu bytes, got %zu\n", path, size, n);
+        return 0;
+    }
+    return 1;
+}
+
+static int save_raw(const char* path, const unsigned char* src, size_t size) {
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    size_t n = fwrite(src, 1, size, f);
+    fclose(f);
+    return n == size;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "usage: %s [-s switches] [-c switches2] [-K slot:kernel.txt] [-n reps] [-p x,y,w,h] [-o out.raw] [in.raw]\n"
+        "  switches as on the board, e.g. 0x0A = Gauss 3x3 (SW[1:0]=10, SW[3]=1)\n"
+        "  -K loads a custom kernel, selected with SW[9:7] = slot (e.g. 0x88 for slot 1)\n",
+        prog);
+}
+
+int main(int argc, char** argv) {
+    unsigned int sw = 0x0A;
+    unsigned int sw2 = 0;
+    int chain = 0;
+    int reps = 1;
+    const char* out_path = "out.raw";
+    rect_t patch = { 0, 0, 0, 0 };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:c:K:n:p:o:h")) != -1) {
+        switch (opt) {
+            case 's': sw = strtoul(optarg, NULL, 0); break;
+            case 'c': sw2 = strtoul(optarg, NULL, 0); chain = 1; break;
+            case 'K':
+                if (!kernel_file_load(optarg)) return 2;
+                break;
+            case 'n': reps = atoi(optarg); break;
+            case 'p':
+                if (sscanf(optarg, "%d,%d,%d,%d", &patch.x, &patch.y, &patch.w, &patch.h) != 4) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'o': out_path = optarg; break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    if (optind < argc) {
+        if (!load_raw(argv[optind], input_writable(), IMG_WIDTH * IMG_HEIGHT)) return 1;
+        rect_t all = { 0, 0, IMG_WIDTH, IMG_HEIGHT };
+        input_mark_dirty(&all);
+    }
+
+    menu_state_t first, second;
+    menu_init(&first);
+    hal_host_set_switches(sw);
+    menu_update(&first, hal_read_switches(), 1);
+    menu_show(&first);
+    menu_init(&second);
+    menu_update(&second, sw2 & 0x3FF, 1);
+
+    double t0 = now_sec();
+    for (int r = 0; r < reps; r++) {
+        int ok = chain
+            ? apply_chain(&first, &second, image_src, &output_img[0][0])
+            : apply_filter(&first, image_src, &output_img[0][0]);
+        if (!ok) return 1;
+    }
+    double dt = (now_sec() - t0) / (reps > 0 ? reps : 1);
+
+    fprintf(stderr, "leds=0x%03x  %.3f ms/image  %.2f ns/pixel\n",
+            hal_host_leds(), dt * 1e3, dt * 1e9 / (IMG_WIDTH * IMG_HEIGHT));
+
+    if (!rect_empty(&patch) && rect_clip(&patch, IMG_WIDTH, IMG_HEIGHT)) {
+        unsigned char* in = input_writable();
+        for (int y = patch.y; y < patch.y + patch.h; y++) {
+            for (int x = patch.x; x < patch.x + patch.w; x++) {
+                in[y * IMG_WIDTH + x] ^= 0xFF;
+            }
+        }
+        input_mark_dirty(&patch);
+
+        t0 = now_sec();
+        if (!process_dirty()) {
+            fprintf(stderr, "patch: last output is not a single filter, reprocessing all\n");
+            int ok = chain
+                ? apply_chain(&first, &second, image_src, &output_img[0][0])
+                : apply_filter(&first, image_src, &output_img[0][0]);
+            if (!ok) return 1;
+        }
+        double pt = now_sec() - t0;
+        fprintf(stderr, "patch %dx%d: %.3f ms (%.1f%% of a full image)\n",
+                patch.w, patch.h, pt * 1e3, pt / dt * 100);
+    }
+
+    return save_raw(out_path, &output_img[0][0], IMG_WIDTH * IMG_HEIGHT) ? 0 : 1;
+}
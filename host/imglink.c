@@ -0,0 +1,528 @@
+// imglink.c
+// Värdens sida av UART-protokollet (src/frame.h, src/xfer.c): laddar upp
+// och ner bilder utan dtekv-download och utan att känna till adresser.
+//
+//   imglink -d enhet [-s sw] [-c sw2] [-r] [-e n] [-v] upload in.raw
+//   imglink -d enhet [-i] [-r] [-e n] [-v] -o ut.raw download
+//   imglink -d enhet [-n antal] ping
+//   imglink -d enhet [-v] kernel plats kernel.txt
+//
+// -s kör filtret som switcharna anger medan bilden laddas upp, -c gör det
+// till en kedja (som imgproc). download hämtar senaste resultatet, eller
+// indata med -i. -r skickar råa rader i stället för packade. -e n förstör
+// var n:te radram som skickas och slänger var n:te som tas emot, för att
+// prova omsändningen (omsända rader räknas inte). -v skriver ut kortets text. ping mäter rundturstiden.
+// kernel laddar en egen kernel (filen som för imgproc -K) till plats 1-7,
+// där kortet kompilerar den; välj den sedan med SW[9:7] = plats.
+//
+// Enheten är en tty, t.ex. pty:n från boardsim. Ingen rad kvitteras för
+// sig: raderna skickas i ett svep inom ett fönster (FRAME_WINDOW_ROWS) och
+// mottagaren begär om från första saknade rad.
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal.h"
+#include "main.h"
+#include "kernels.h"
+#include "packed.h"
+#include "frame.h"
+#include "kernels_plan.h"
+#include "host_kernels.h"
+
+#define LINK_TIMEOUT_MS 2000
+#define LINK_RETRIES 5
+
+// Hur länge ett resultat får räknas klart innan nedladdningen startar
+#define LINK_FIRST_TIMEOUT_MS 30000
+
+typedef struct {
+    int fd;
+    frame_parser_t rx;
+    int verbose;
+    int damage_every;           // -e
+    unsigned long rows_out, rows_in;
+    int fresh_out, fresh_in;    // Rader under dessa har redan gått en gång
+    unsigned long bytes_out, bytes_in;
+    unsigned long damaged;
+
+    // Bytes som lästs medan en skrivning väntade
+    unsigned char* pending;
+    size_t pending_len, pending_pos, pending_cap;
+} link_t;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int link_open(link_t* l, const char* path) {
+    memset(l, 0, sizeof(*l));
+    l->fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (l->fd < 0) {
+        perror(path);
+        return 0;
+    }
+    struct termios t;
+    if (tcgetattr(l->fd, &t) == 0) {
+        cfmakeraw(&t);
+        tcsetattr(l->fd, TCSANOW, &t);
+    }
+    frame_parser_init(&l->rx);
+    l->pending_cap = 1 << 16;
+    l->pending = malloc(l->pending_cap);
+    return l->pending != NULL;
+}
+
+static void link_close(link_t* l) {
+    free(l->pending);
+    close(l->fd);
+}
+
+// Sparar det som kortet skickar medan vi väntar på att få skriva, så att
+// ingen av sidorna blir stående med full buffert
+static void link_stash(link_t* l) {
+    if (l->pending_pos == l->pending_len) l->pending_pos = l->pending_len = 0;
+    if (l->pending_len == l->pending_cap) {
+        l->pending_cap *= 2;
+        l->pending = realloc(l->pending, l->pending_cap);
+    }
+    ssize_t n = read(l->fd, l->pending + l->pending_len, l->pending_cap - l->pending_len);
+    if (n > 0) l->pending_len += n;
+}
+
+static int link_write(link_t* l, const unsigned char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(l->fd, data, len);
+        if (n > 0) {
+            data += n;
+            len -= n;
+            l->bytes_out += n;
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EINTR) {
+            perror("write");
+            return 0;
+        }
+        struct pollfd pfd = { l->fd, POLLIN | POLLOUT, 0 };
+        poll(&pfd, 1, 100);
+        if (pfd.revents & POLLIN) link_stash(l);
+    }
+    return 1;
+}
+
+// -e: var n:te rad som går för första gången. En omsänd rad förstörs
+// aldrig; annars kan omsändningarna hamna i takt med n, så att samma rad
+// förstörs varje gång och överföringen aldrig blir klar.
+static int link_damage(link_t* l, int row, int* fresh, unsigned long* count) {
+    if (!l->damage_every || row < *fresh) return 0;
+    *fresh = row + 1;
+    if (++*count % l->damage_every) return 0;
+    l->damaged++;
+    return 1;
+}
+
+static int link_send(link_t* l, int type, const unsigned char* payload, int len) {
+    unsigned char frame[FRAME_MAX_PAYLOAD + FRAME_OVERHEAD];
+    int n = frame_build(frame, type, payload, len);
+    if (type == FRAME_ROW && link_damage(l, frame_get16(payload), &l->fresh_out, &l->rows_out)) {
+        frame[n - 3] ^= 0x55; // Sista databyten; kontrollen stämmer inte längre
+    }
+    return link_write(l, frame, n);
+}
+
+static int link_send_row_number(link_t* l, int type, int row) {
+    unsigned char p[2];
+    frame_put16(p, row);
+    return link_send(l, type, p, 2);
+}
+
+// Nästa byte, eller -1 om inget kommer inom timeout_ms
+static int link_getc(link_t* l, int timeout_ms) {
+    if (l->pending_pos < l->pending_len) return l->pending[l->pending_pos++];
+    unsigned char c;
+    while (1) {
+        ssize_t n = read(l->fd, &c, 1);
+        if (n == 1) {
+            l->bytes_in++;
+            return c;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EINTR) return -1;
+        struct pollfd pfd = { l->fd, POLLIN, 0 };
+        if (poll(&pfd, 1, timeout_ms) <= 0) return -1;
+    }
+}
+
+/*
+ * Funktion: link_recv
+ * -------------------
+ * Väntar på nästa hela ram. Bytes utanför ramar är kortets text och skrivs
+ * till stderr med -v. Med -e slängs var n:te radram, som om kontrollen
+ * inte stämt. Returnerar 0 om ingen ram kommit inom timeout_ms.
+ */
+static int link_recv(link_t* l, int timeout_ms) {
+    double deadline = now_sec() + timeout_ms * 1e-3;
+    while (1) {
+        int left = (int)((deadline - now_sec()) * 1e3);
+        int c = link_getc(l, left > 0 ? left : 0);
+        if (c < 0) return 0;
+        if (frame_idle(&l->rx) && c != FRAME_SYNC0) {
+            if (l->verbose) fputc(c, stderr);
+            continue;
+        }
+        if (!frame_feed(&l->rx, (unsigned char)c)) continue;
+        if (l->rx.type == FRAME_ROW && l->rx.len >= 2 &&
+            link_damage(l, frame_get16(l->rx.data), &l->fresh_in, &l->rows_in)) {
+            continue;
+        }
+        return 1;
+    }
+}
+
+static void report_error(const frame_parser_t* f) {
+    static const char* const names[] = { "?", "wrong image size", "invalid filter", "bad request", "invalid kernel",
+                                          "image changed during the download" };
+    int code = f->len > 0 && f->data[0] < sizeof(names) / sizeof(names[0]) ? f->data[0] : 0;
+    fprintf(stderr, "board refused the request: %s\n", names[code]);
+}
+
+static void report_transfer(const char* what, const link_t* l, double sec, unsigned long payload, int naks) {
+    unsigned long bytes = l->bytes_out + l->bytes_in;
+    fprintf(stderr, "%s: %d rows, %lu bytes on the wire for %d (%.1f%%), %.3f s, %.1f KiB/s, %d resend requests",
+            what, IMG_HEIGHT, bytes, IMG_WIDTH * IMG_HEIGHT, 100.0 * bytes / (IMG_WIDTH * IMG_HEIGHT),
+            sec, payload / 1024.0 / sec, naks);
+    if (l->damaged) fprintf(stderr, ", %lu frames damaged on purpose", l->damaged);
+    fprintf(stderr, "\n");
+}
+
+/*
+ * Funktion: upload
+ * ----------------
+ * Alla rader kodas först och skickas sedan utan att vänta så länge fönstret
+ * räcker. Svaren läses mellan raderna: FRAME_ACK r flyttar fönstret och
+ * FRAME_NAK r flyttar tillbaka till rad r. Står fönstret still skickas allt
+ * från första okvitterade rad om efter LINK_TIMEOUT_MS. Kortet begär bara
+ * om en gång per lucka, så varje FRAME_NAK följs.
+ */
+static int upload(link_t* l, const unsigned char* img, int mode, int sw, int sw2, int packed) {
+    int offsets[IMG_HEIGHT + 1];
+    unsigned char* rows = malloc((size_t)IMG_HEIGHT * (FRAME_ROW_HEADER + PACKED_ROW_BOUND(IMG_WIDTH)));
+    if (!rows) return 0;
+    offsets[0] = 0;
+    for (int y = 0; y < IMG_HEIGHT; y++) {
+        const unsigned char* prev = y > 0 ? img + (y - 1) * IMG_WIDTH : conv_zero_row;
+        offsets[y + 1] = offsets[y] + frame_row_payload(rows + offsets[y], y, img + y * IMG_WIDTH, prev, IMG_WIDTH, packed);
+    }
+
+    unsigned char req[9];
+    frame_put16(req, IMG_WIDTH);
+    frame_put16(req + 2, IMG_HEIGHT);
+    req[4] = (unsigned char)mode;
+    frame_put16(req + 5, sw);
+    frame_put16(req + 7, sw2);
+
+    double t0 = now_sec();
+    int ok = link_send(l, FRAME_UPLOAD, req, sizeof(req));
+    int next = 0, acked = 0, end_sent = 0, naks = 0, timeouts = 0;
+
+    while (ok) {
+        int got;
+        if (next < IMG_HEIGHT && next < acked + FRAME_WINDOW_ROWS) {
+            ok = link_send(l, FRAME_ROW, rows + offsets[next], offsets[next + 1] - offsets[next]);
+            next++;
+            end_sent = 0;
+            got = link_recv(l, 0);
+        } else {
+            if (next == IMG_HEIGHT && !end_sent) {
+                ok = link_send_row_number(l, FRAME_END, IMG_HEIGHT);
+                end_sent = 1;
+            }
+            got = link_recv(l, LINK_TIMEOUT_MS);
+            if (!got) {
+                if (++timeouts > LINK_RETRIES) {
+                    fprintf(stderr, "upload: no answer from the board\n");
+                    ok = 0;
+                }
+                if (next < IMG_HEIGHT) next = acked;
+                end_sent = 0;
+                continue;
+            }
+        }
+        if (!got) continue;
+
+        const frame_parser_t* f = &l->rx;
+        if (f->type == FRAME_ERROR) {
+            report_error(f);
+            ok = 0;
+        } else if ((f->type == FRAME_ACK || f->type == FRAME_NAK) && f->len >= 2) {
+            int r = frame_get16(f->data);
+            if (f->type == FRAME_ACK && r >= IMG_HEIGHT) break;
+            if (r > acked) {
+                acked = r;
+                timeouts = 0;
+            }
+            if (f->type == FRAME_NAK && r < IMG_HEIGHT) {
+                next = r;
+                naks++;
+            }
+        }
+    }
+
+    if (ok) report_transfer("upload", l, now_sec() - t0, IMG_WIDTH * IMG_HEIGHT, naks);
+    free(rows);
+    return ok;
+}
+
+/*
+ * Funktion: download
+ * ------------------
+ * Tar emot rader i ordning och kvitterar var FRAME_ACK_ROWS:e. En lucka
+ * eller trasig rad ger en FRAME_NAK från första saknade rad, en gång per
+ * lucka som på kortet (request_resend() i xfer.c): en rad eller FRAME_END
+ * som inte ligger efter den förra betyder att kortet gått tillbaka och att
+ * raden föll bort igen.
+ */
+static int download(link_t* l, unsigned char* img, int which, int packed) {
+    unsigned char req[2] = { (unsigned char)which, (unsigned char)packed };
+    double t0 = now_sec();
+    int ok = link_send(l, FRAME_DOWNLOAD, req, 2);
+    int got_info = 0, next = 0, nak_sent = 0, seen = 0, naks = 0, timeouts = 0;
+
+    while (ok) {
+        if (!link_recv(l, got_info ? LINK_TIMEOUT_MS : LINK_FIRST_TIMEOUT_MS)) {
+            if (++timeouts > LINK_RETRIES) {
+                fprintf(stderr, "download: no answer from the board\n");
+                return 0;
+            }
+            ok = got_info ? link_send_row_number(l, FRAME_NAK, next) : link_send(l, FRAME_DOWNLOAD, req, 2);
+            continue;
+        }
+
+        const frame_parser_t* f = &l->rx;
+        switch (f->type) {
+            case FRAME_ERROR:
+                report_error(f);
+                return 0;
+
+            case FRAME_INFO:
+                if (f->len < 4 || frame_get16(f->data) != IMG_WIDTH || frame_get16(f->data + 2) != IMG_HEIGHT) {
+                    fprintf(stderr, "download: unexpected image size\n");
+                    return 0;
+                }
+                if (!got_info) t0 = now_sec();
+                got_info = 1;
+                break;
+
+            case FRAME_ROW: {
+                if (!got_info || f->len < 2) break;
+                int r = frame_get16(f->data);
+                if (r < next) break;
+                if (r == next && r < IMG_HEIGHT) {
+                    const unsigned char* prev = r > 0 ? img + (r - 1) * IMG_WIDTH : conv_zero_row;
+                    if (frame_row_decode(f->data, f->len, IMG_WIDTH, img + r * IMG_WIDTH, prev)) {
+                        next++;
+                        nak_sent = 0;
+                        if (next % FRAME_ACK_ROWS == 0 && next < IMG_HEIGHT) {
+                            ok = link_send_row_number(l, FRAME_ACK, next);
+                        }
+                        break;
+                    }
+                }
+                if (!nak_sent || r <= seen) {
+                    ok = link_send_row_number(l, FRAME_NAK, next);
+                    nak_sent = 1;
+                    naks++;
+                }
+                seen = r;
+                break;
+            }
+
+            case FRAME_END:
+                if (!got_info) break;
+                if (next == IMG_HEIGHT) {
+                    if (!link_send_row_number(l, FRAME_ACK, IMG_HEIGHT)) return 0;
+                    report_transfer("download", l, now_sec() - t0, IMG_WIDTH * IMG_HEIGHT, naks);
+                    return 1;
+                }
+                if (!nak_sent || seen == IMG_HEIGHT) {
+                    ok = link_send_row_number(l, FRAME_NAK, next);
+                    nak_sent = 1;
+                    naks++;
+                }
+                seen = IMG_HEIGHT;
+                break;
+        }
+    }
+    return 0;
+}
+
+// Rundturstid för en liten ram, dvs vad varje kvittens skulle kosta
+static int ping(link_t* l, int count) {
+    double sum = 0, min = 1e9, max = 0;
+    for (int i = 0; i < count; i++) {
+        unsigned char p[4];
+        frame_put16(p, i);
+        frame_put16(p + 2, ~i);
+        double t0 = now_sec();
+        if (!link_send(l, FRAME_PING, p, 4)) return 0;
+        int got = 0;
+        while (!got) {
+            if (!link_recv(l, LINK_TIMEOUT_MS)) {
+                fprintf(stderr, "ping: no answer from the board\n");
+                return 0;
+            }
+            got = l->rx.type == FRAME_PING && l->rx.len == 4 && !memcmp(l->rx.data, p, 4);
+        }
+        double dt = now_sec() - t0;
+        sum += dt;
+        if (dt < min) min = dt;
+        if (dt > max) max = dt;
+    }
+    printf("ping: %d frames, round trip min %.3f ms, avg %.3f ms, max %.3f ms\n",
+           count, min * 1e3, sum / count * 1e3, max * 1e3);
+    return 1;
+}
+
+// Skickar vikterna i FRAME_KERNEL och väntar på FRAME_ACK med platsen.
+// Att ladda samma kernel två gånger gör inget, så den skickas bara om.
+static int kernel_send(link_t* l, int slot, const char* path) {
+    int table[KERNEL_MAX_SIZE * KERNEL_MAX_SIZE];
+    int ksize, divisor, offset;
+    if (!kernel_file_read(path, table, &ksize, &divisor, &offset)) return 0;
+
+    // Allt måste rymmas i ramens fält; resten kontrollerar kortet
+    int fits = offset >= -32768 && offset <= 32767 && divisor >= 1;
+    for (int i = 0; i < ksize * ksize; i++) {
+        if (table[i] < -KERNEL_PLAN_MAX_WEIGHT || table[i] > KERNEL_PLAN_MAX_WEIGHT) fits = 0;
+    }
+    if (!fits) {
+        fprintf(stderr, "%s: weights must be within +-%d, offset 16 bits and divisor >= 1\n", path, KERNEL_PLAN_MAX_WEIGHT);
+        return 0;
+    }
+
+    unsigned char req[FRAME_KERNEL_HEADER + 2 * KERNEL_MAX_SIZE * KERNEL_MAX_SIZE];
+    req[0] = (unsigned char)slot;
+    req[1] = (unsigned char)ksize;
+    frame_put16(req + 2, divisor & 0xFFFF);
+    frame_put16(req + 4, divisor >> 16);
+    frame_put16(req + 6, offset);
+    for (int i = 0; i < ksize * ksize; i++) {
+        frame_put16(req + FRAME_KERNEL_HEADER + 2 * i, table[i]);
+    }
+
+    for (int tries = 0; tries <= LINK_RETRIES; tries++) {
+        if (!link_send(l, FRAME_KERNEL, req, FRAME_KERNEL_HEADER + 2 * ksize * ksize)) return 0;
+        while (link_recv(l, LINK_TIMEOUT_MS)) {
+            const frame_parser_t* f = &l->rx;
+            if (f->type == FRAME_ERROR) {
+                report_error(f);
+                return 0;
+            }
+            if (f->type == FRAME_ACK && f->len >= 2 && (int)frame_get16(f->data) == slot) {
+                fprintf(stderr, "kernel: %dx%d loaded to slot %d\n", ksize, ksize, slot);
+                return 1;
+            }
+        }
+    }
+    fprintf(stderr, "kernel: no answer from the board\n");
+    return 0;
+}
+
+static int load_raw(const char* path, unsigned char* dst, size_t size) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    size_t n = fread(dst, 1, size, f);
+    fclose(f);
+    if (n != size) {
+        fprintf(stderr, "%s: expected %zu bytes, got %zu\n", path, size, n);
+        return 0;
+    }
+    return 1;
+}
+
+static int save_raw(const char* path, const unsigned char* data, size_t size) {
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    size_t n = fwrite(data, 1, size, f);
+    fclose(f);
+    return n == size;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "usage: %s -d device [-s sw] [-c sw2] [-r] [-e n] [-v] upload in.raw\n"
+        "       %s -d device [-i] [-r] [-e n] [-v] -o out.raw download\n"
+        "       %s -d device [-n count] ping\n"
+        "       %s -d device [-v] kernel slot kernel.txt\n",
+        prog, prog, prog, prog);
+}
+
+int main(int argc, char** argv) {
+    const char* device = NULL;
+    const char* out_path = NULL;
+    int sw = -1, sw2 = -1, which = FRAME_IMG_RESULT, packed = 1, count = 10;
+    int damage = 0, verbose = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:s:c:o:ire:vn:h")) != -1) {
+        switch (opt) {
+            case 'd': device = optarg; break;
+            case 's': sw = (int)strtol(optarg, NULL, 0); break;
+            case 'c': sw2 = (int)strtol(optarg, NULL, 0); break;
+            case 'o': out_path = optarg; break;
+            case 'i': which = FRAME_IMG_INPUT; break;
+            case 'r': packed = 0; break;
+            case 'e': damage = atoi(optarg); break;
+            case 'v': verbose = 1; break;
+            case 'n': count = atoi(optarg); break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (!device || optind >= argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    link_t link;
+    if (!link_open(&link, device)) return 1;
+    link.verbose = verbose;
+    link.damage_every = damage;
+
+    static unsigned char img[IMG_HEIGHT * IMG_WIDTH];
+    const char* cmd = argv[optind];
+    int ok;
+    if (!strcmp(cmd, "upload") && optind + 1 < argc) {
+        int mode = sw < 0 ? FRAME_MODE_STORE : sw2 < 0 ? FRAME_MODE_FILTER : FRAME_MODE_CHAIN;
+        ok = load_raw(argv[optind + 1], img, sizeof(img)) &&
+             upload(&link, img, mode, sw < 0 ? 0 : sw, sw2 < 0 ? 0 : sw2, packed);
+    } else if (!strcmp(cmd, "download") && out_path) {
+        ok = download(&link, img, which, packed) && save_raw(out_path, img, sizeof(img));
+    } else if (!strcmp(cmd, "ping")) {
+        ok = ping(&link, count > 0 ? count : 1);
+    } else if (!strcmp(cmd, "kernel") && optind + 2 < argc) {
+        ok = kernel_send(&link, atoi(argv[optind + 1]), argv[optind + 2]);
+    } else {
+        usage(argv[0]);
+        link_close(&link);
+        return 2;
+    }
+
+    // Kortets sista rader text, om något hann komma
+    if (verbose) while (link_recv(&link, 50));
+    link_close(&link);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+// pack.c
+// Packar en rå gråskalebild till formatet i src/packed.c, för firmware
+// byggd med make IMAGE=packed. Skriver storlek och avkodningshastighet.
+//
+//   imgpack [-W bredd] [-H höjd] -o ut.pk in.raw    packa
+//   imgpack -d -o ut.raw in.pk                      packa upp
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hal.h"
+#include "packed.h"
+
+static unsigned char* load_file(const char* path, size_t* size) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char* data = n > 0 ? malloc(n) : NULL;
+    if (!data || fread(data, 1, n, f) != (size_t)n) {
+        fprintf(stderr, "%s: could not read\n", path);
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    *size = n;
+    return data;
+}
+
+static int save_file(const char* path, const unsigned char* data, size_t size) {
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    size_t n = fwrite(data, 1, size, f);
+    fclose(f);
+    return n == size;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "usage: %s [-W width] [-H height] -o out.pk in.raw\n"
+        "       %s -d -o out.raw in.pk\n",
+        prog, prog);
+}
+
+int main(int argc, char** argv) {
+    int width = 256, height = 256, unpack = 0, opt;
+    const char* out_path = NULL;
+
+    while ((opt = getopt(argc, argv, "W:H:do:h")) != -1) {
+        switch (opt) {
+            case 'W': width = atoi(optarg); break;
+            case 'H': height = atoi(optarg); break;
+            case 'd': unpack = 1; break;
+            case 'o': out_path = optarg; break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (!out_path || optind + 1 != argc) {
+        usage(argv[0]);
+        return 2;
+    }
+    hal_host_set_quiet(1);
+
+    size_t size;
+    unsigned char* in = load_file(argv[optind], &size);
+    if (!in) return 1;
+
+    if (unpack) {
+        packed_reader_t rd;
+        if (size < PACKED_HEADER_SIZE || !packed_open(&rd, in)) {
+            fprintf(stderr, "%s: not a packed image of width 1..%d\n", argv[optind], PACKED_MAX_WIDTH);
+            free(in);
+            return 1;
+        }
+        // Filen kan vara trunkerad eller fel: varje rad kontrolleras mot
+        // det som finns kvar innan den avkodas
+        unsigned char* out = malloc((size_t)rd.width * rd.height);
+        const unsigned char* prev = conv_zero_row;
+        size_t pos = PACKED_HEADER_SIZE;
+        for (int y = 0; y < rd.height; y++) {
+            unsigned char* row = out + (size_t)y * rd.width;
+            size_t avail = size - pos < (size_t)PACKED_ROW_BOUND(rd.width) ? size - pos : (size_t)PACKED_ROW_BOUND(rd.width);
+            int len = packed_row_length(in + pos, (int)avail, rd.width);
+            if (!len || !packed_decode_row(in + pos, len, rd.width, row, prev)) {
+                fprintf(stderr, "%s: corrupt or truncated at row %d\n", argv[optind], y);
+                free(out);
+                free(in);
+                return 1;
+            }
+            pos += len;
+            prev = row;
+        }
+        int ok = save_file(out_path, out, (size_t)rd.width * rd.height);
+        free(out);
+        free(in);
+        return ok ? 0 : 1;
+    }
+
+    if (width <= 0 || height <= 0 || size != (size_t)width * height) {
+        fprintf(stderr, "%s: %zu bytes, expected %dx%d\n", argv[optind], size, width, height);
+        return 1;
+    }
+    unsigned char* packed = malloc(packed_bound(width, height));
+    int n = packed_encode(in, width, height, packed);
+    if (n == 0) {
+        fprintf(stderr, "%dx%d is too large to pack\n", width, height);
+        return 1;
+    }
+
+    // Kontroll och avkodningshastighet: packa upp tills minst 0.2 s gått
+    unsigned char* check = malloc(size);
+    int reps = 0;
+    double t0 = now_sec(), t;
+    do {
+        packed_decode(packed, check);
+        reps++;
+        t = now_sec() - t0;
+    } while (t < 0.2);
+    if (memcmp(check, in, size) != 0) {
+        fprintf(stderr, "internal error: decoded image differs\n");
+        return 1;
+    }
+
+    printf("%s: %zu -> %d bytes (%.1f%%), decode %.1f Mpixel/s\n",
+           out_path, size, n, 100.0 * n / size, reps * size * 1e-6 / t);
+    int ok = save_file(out_path, packed, n);
+    free(check);
+    free(packed);
+    free(in);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+// boxfilter.c
+// Box blur med löpande summor och integralbild.
+#include "dtekv-lib.h"
+#include "boxfilter.h"
+#include "kernels.h"
+
+// Kolumnsummor för aktuell rad, samt en utfylld kopia med radius
+// kolumner på varje sida enligt kantläget.
+static CONV_SCRATCH unsigned int box_cols[CONV_MAX_WIDTH];
+static CONV_SCRATCH unsigned int box_padded[CONV_MAX_WIDTH + 2 * BOX_MAX_RADIUS];
+
+// Lägger till (sign = 1) eller drar bort (sign = -1) rad iy från kolumnsummorna
+static void box_add_row(const unsigned char* input, int width, int height, int iy, int sign, border_mode_t border) {
+    int sy = conv_border_index(iy, height, border);
+    if (sy < 0) return; // Nollrad, inget att göra
+
+    const unsigned char* in = input + sy * width;
+    if (sign > 0) {
+        for (int x = 0; x < width; x++) box_cols[x] += in[x];
+    } else {
+        for (int x = 0; x < width; x++) box_cols[x] -= in[x];
+    }
+}
+
+/*
+ * Funktion: box_filter
+ * --------------------
+ * Glidande fönster i två led. box_cols håller summan av de 2r+1 raderna
+ * runt aktuell rad för varje kolumn; när vi går en rad nedåt läggs den nya
+ * raden till och den äldsta dras bort. Längs raden glider på samma sätt en
+ * horisontell summa över 2r+1 kolumnsummor. Varje pixel kostar alltså ett
+ * par additioner och en division oavsett radie.
+ *
+ * Divisionen är heltalsdivision med hela fönstrets storlek, precis som
+ * convolve() med boxblur-kernlarna, så även kanterna blir bit-identiska.
+ */
+void box_filter(const unsigned char* input, unsigned char* output, int width, int height, int radius, border_mode_t border) {
+    if (width > CONV_MAX_WIDTH || radius < 0 || radius > BOX_MAX_RADIUS) {
+        print("box_filter: unsupported size\n");
+        return;
+    }
+
+    int ksize = 2 * radius + 1;
+    unsigned int area = (unsigned int)(ksize * ksize);
+
+    // Kolumnsummor för rad 0: raderna -radius .. radius
+    for (int x = 0; x < width; x++) box_cols[x] = 0;
+    for (int dy = -radius; dy <= radius; dy++) {
+        box_add_row(input, width, height, dy, 1, border);
+    }
+
+    for (int y = 0; y < height; y++) {
+        // Fyll ut kolumnsummorna, box_padded[j] hör till kolumn j - radius
+        unsigned int* cols = box_padded + radius;
+        for (int x = 0; x < width; x++) cols[x] = box_cols[x];
+        for (int i = 1; i <= radius; i++) {
+            int l = conv_border_index(-i, width, border);
+            int r = conv_border_index(width - 1 + i, width, border);
+            cols[-i] = l < 0 ? 0 : box_cols[l];
+            cols[width - 1 + i] = r < 0 ? 0 : box_cols[r];
+        }
+
+        // Horisontellt glidande fönster
+        unsigned int sum = 0;
+        for (int j = 0; j < ksize - 1; j++) sum += box_padded[j];
+
+        unsigned char* out = output + y * width;
+        for (int x = 0; x < width; x++) {
+            sum += box_padded[x + ksize - 1];
+            out[x] = (unsigned char)(sum / area);
+            sum -= box_padded[x];
+        }
+
+        // Flytta fönstret en rad nedåt
+        if (y + 1 < height) {
+            box_add_row(input, width, height, y + radius + 1, 1, border);
+            box_add_row(input, width, height, y - radius, -1, border);
+        }
+    }
+}
+
+/*
+ * Funktion: integral_image
+ * ------------------------
+ * sat[(y+1)*(width+1) + (x+1)] = summan av input[0..y][0..x].
+ * Med 8-bitars pixlar räcker 32 bitar upp till 4096x4096.
+ */
+void integral_image(const unsigned char* input, unsigned int* sat, int width, int height) {
+    int stride = width + 1;
+    for (int x = 0; x <= width; x++) sat[x] = 0;
+
+    for (int y = 0; y < height; y++) {
+        const unsigned char* in = input + y * width;
+        unsigned int* above = sat + y * stride;
+        unsigned int* cur = above + stride;
+        unsigned int rowsum = 0;
+        cur[0] = 0;
+        for (int x = 0; x < width; x++) {
+            rowsum += in[x];
+            cur[x + 1] = above[x + 1] + rowsum;
+        }
+    }
+}
+
+unsigned int integral_sum(const unsigned int* sat, int width, int x0, int y0, int x1, int y1) {
+    int stride = width + 1;
+    return sat[y1 * stride + x1] - sat[y0 * stride + x1]
+         - sat[y1 * stride + x0] + sat[y0 * stride + x0];
+}
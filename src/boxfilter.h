@@ -0,0 +1,24 @@
+// boxfilter.h
+#ifndef BOXFILTER_H
+#define BOXFILTER_H
+
+#include "kernels.h"
+
+// Största radie för box_filter: hela bredden, men högst 1024 eftersom
+// summan (2r+1)^2 * 255 måste rymmas i 32 bitar.
+#define BOX_MAX_RADIUS (CONV_MAX_WIDTH < 1024 ? CONV_MAX_WIDTH : 1024)
+
+// Box blur med godtycklig radie, dvs en (2r+1)x(2r+1) medelvärdeskernel.
+// Kostnaden per pixel är konstant oavsett radie. Samma resultat som
+// convolve_ex() med en kernel av ettor och divisor (2r+1)^2.
+void box_filter(const unsigned char* input, unsigned char* output, int width, int height, int radius, border_mode_t border);
+
+// Integralbild (summed-area table). sat måste rymma (width+1)*(height+1)
+// element; sat[y*(width+1)+x] är summan av alla pixlar ovanför och till
+// vänster om (x, y). Första raden och kolumnen är 0.
+void integral_image(const unsigned char* input, unsigned int* sat, int width, int height);
+
+// Summan av pixlarna i rektangeln [x0, x1) x [y0, y1), i O(1).
+unsigned int integral_sum(const unsigned int* sat, int width, int x0, int y0, int x1, int y1);
+
+#endif
@@ -0,0 +1,155 @@
+// cache.c
+// Resultatcache med LRU-utkastning. Platserna är lika stora (en hel bild)
+// och ligger i följd i det lediga RAM som hal_spare_ram() ger, så ingen
+// allokering behövs. Med högst CACHE_MAX_ENTRIES platser räcker en linjär
+// sökning; jämfört med en konvolution av hela bilden kostar den ingenting.
+#include "dtekv-lib.h"
+#include "main.h"
+#include "cache.h"
+#include <stddef.h>
+
+#define CACHE_SLOT_BYTES (IMG_WIDTH * IMG_HEIGHT)
+
+typedef enum {
+    SLOT_FREE,
+    SLOT_PENDING,  // Reserverad, ett jobb räknar in i den
+    SLOT_VALID
+} slot_state_t;
+
+typedef struct {
+    slot_state_t state;
+    cache_key_t key;
+    unsigned int last_use;  // Värdet på use_clock vid senaste användning
+    unsigned char* buf;
+} cache_slot_t;
+
+static cache_slot_t slots[CACHE_MAX_ENTRIES];
+static int slot_count;
+static unsigned int use_clock;
+static const unsigned char* pinned;
+static unsigned int hits, misses, evictions;
+
+static int key_equal(const cache_key_t* a, const cache_key_t* b) {
+    return a->generation == b->generation && a->stage1 == b->stage1 && a->stage2 == b->stage2;
+}
+
+static cache_slot_t* slot_of(const unsigned char* buf) {
+    for (int i = 0; i < slot_count; i++) {
+        if (slots[i].buf == buf) return &slots[i];
+    }
+    return NULL;
+}
+
+int cache_init(unsigned int budget) {
+    unsigned int spare;
+    unsigned char* base = hal_spare_ram(&spare);
+
+    // Platserna ordjusteras som de andra bildbuffertarna
+    unsigned int skip = (4 - ((unsigned long)base & 3)) & 3;
+    spare = spare > skip ? spare - skip : 0;
+    base += skip;
+
+    if (budget > spare) budget = spare;
+    slot_count = budget / CACHE_SLOT_BYTES;
+    if (slot_count > CACHE_MAX_ENTRIES) slot_count = CACHE_MAX_ENTRIES;
+    if (slot_count < 3) slot_count = 0;
+
+    for (int i = 0; i < slot_count; i++) {
+        slots[i].state = SLOT_FREE;
+        slots[i].last_use = 0;
+        slots[i].buf = base + i * CACHE_SLOT_BYTES;
+    }
+    use_clock = 0;
+    pinned = NULL;
+    hits = misses = evictions = 0;
+    return slot_count;
+}
+
+int cache_enabled(void) {
+    return slot_count > 0;
+}
+
+unsigned char* cache_lookup(const cache_key_t* key) {
+    if (!slot_count) return NULL;
+    for (int i = 0; i < slot_count; i++) {
+        if (slots[i].state == SLOT_VALID && key_equal(&slots[i].key, key)) {
+            slots[i].last_use = ++use_clock;
+            hits++;
+            return slots[i].buf;
+        }
+    }
+    misses++;
+    return NULL;
+}
+
+/*
+ * Funktion: cache_reserve
+ * -----------------------
+ * Tar en ledig plats om det finns, annars den giltiga plats som använts
+ * längst tillbaka. Reserverade platser och den fästa (visade) bilden
+ * kastas aldrig. Ett gammalt resultat med samma nyckel ersätts.
+ */
+unsigned char* cache_reserve(const cache_key_t* key) {
+    cache_slot_t* victim = NULL;
+
+    for (int i = 0; i < slot_count; i++) {
+        cache_slot_t* s = &slots[i];
+        if (s->state == SLOT_VALID && key_equal(&s->key, key) && s->buf != pinned) {
+            victim = s;
+            break;
+        }
+        if (s->state == SLOT_PENDING || s->buf == pinned) continue;
+        if (s->state == SLOT_FREE) {
+            if (!victim || victim->state != SLOT_FREE) victim = s;
+        } else if (!victim || (victim->state == SLOT_VALID && s->last_use < victim->last_use)) {
+            victim = s;
+        }
+    }
+    if (!victim) return NULL;
+
+    if (victim->state == SLOT_VALID) evictions++;
+    victim->state = SLOT_PENDING;
+    victim->key = *key;
+    victim->last_use = ++use_clock;
+    return victim->buf;
+}
+
+void cache_commit(const unsigned char* buf) {
+    cache_slot_t* s = slot_of(buf);
+    if (s && s->state == SLOT_PENDING) {
+        s->state = SLOT_VALID;
+        s->last_use = ++use_clock;
+    }
+}
+
+void cache_abort(const unsigned char* buf) {
+    cache_slot_t* s = slot_of(buf);
+    if (s && s->state == SLOT_PENDING) s->state = SLOT_FREE;
+}
+
+void cache_pin(const unsigned char* buf) {
+    pinned = buf;
+}
+
+void cache_retag(const unsigned char* buf, unsigned int generation) {
+    cache_slot_t* s = slot_of(buf);
+    if (s && s->state == SLOT_VALID) s->key.generation = generation;
+}
+
+void cache_report(void) {
+    int used = 0;
+    for (int i = 0; i < slot_count; i++) {
+        if (slots[i].state != SLOT_FREE) used++;
+    }
+    print("Result cache: ");
+    print_dec(hits);
+    print(" hits, ");
+    print_dec(misses);
+    print(" misses, ");
+    print_dec(evictions);
+    print(" evicted, ");
+    print_dec(used);
+    print("/");
+    print_dec(slot_count);
+    print(" slots used\n");
+}
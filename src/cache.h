@@ -0,0 +1,57 @@
+// cache.h
+#ifndef CACHE_H
+#define CACHE_H
+
+// Resultatcache: färdiga utbilder (IMG_WIDTH x IMG_HEIGHT) i det RAM som
+// dtekv-script.lds lämnar ledigt ovanför stacken. Ett val som körts förut
+// med samma indata ger direkt en pekare till den sparade bilden.
+
+// Högst så här mycket minne används (make CACHE_BUDGET=...).
+// 1 MiB räcker till 16 bilder om 256x256.
+#ifndef CACHE_BUDGET
+#define CACHE_BUDGET 0x100000
+#endif
+
+#define CACHE_MAX_ENTRIES 64
+
+// Vad ett resultat räknades fram ur. stage1/stage2 är filterkoder från
+// process.c (0 = inget andra steg); generation räknas upp när indata ändras.
+typedef struct {
+    unsigned int generation;
+    unsigned int stage1;
+    unsigned int stage2;
+} cache_key_t;
+
+// Delar in min(budget, ledigt RAM) i platser. Under tre platser (ett
+// visat resultat plus båda stegen i en kedja) stängs cachen av. Returnerar
+// antalet platser.
+int cache_init(unsigned int budget);
+
+// 1 om cachen har platser
+int cache_enabled(void);
+
+// Bufferten med ett färdigt resultat för key, eller NULL. Räknas som
+// träff eller miss och flyttar en träff först i LRU-ordningen.
+unsigned char* cache_lookup(const cache_key_t* key);
+
+// Reserverar en plats för key att räkna in i och kastar vid behov det
+// resultat som använts längst tillbaka. Platsen ger inga träffar förrän
+// cache_commit(). NULL om cachen är avstängd.
+unsigned char* cache_reserve(const cache_key_t* key);
+
+// Resultatet i buf är klart. Ingen verkan om buf inte är en reserverad plats.
+void cache_commit(const unsigned char* buf);
+
+// Släpper en reserverad plats som aldrig blev klar (avbrutet jobb)
+void cache_abort(const unsigned char* buf);
+
+// buf får inte kastas, t.ex. för att den är det resultat som visas (NULL = ingen)
+void cache_pin(const unsigned char* buf);
+
+// Resultatet i buf har räknats om för indata med en ny generation
+void cache_retag(const unsigned char* buf, unsigned int generation);
+
+// Skriver träffar, missar och hur många platser som används
+void cache_report(void);
+
+#endif
@@ -3,7 +3,7 @@
 #ifndef CAT_IMAGE_H
 #define CAT_IMAGE_H
 
-unsigned char cat_img[256][256] = {
+static const unsigned char cat_img[256][256] __attribute__((aligned(4))) = {
     { 60, 62, 67, 73, 71, 71, 72, 66, 61, 59, 60, 64, 63, 56, 56, 59, 56, 54, 49, 48, 44, 41, 46, 51, 54, 57, 57, 53, 57, 64, 61, 53, 43, 41, 43, 45, 47, 48, 49, 52, 54, 55, 56, 57, 59, 60, 64, 66, 68, 68, 66, 68, 64, 66, 68, 64, 65, 65, 62, 64, 66, 65, 64, 64, 62, 63, 62, 59, 60, 59, 61, 61, 62, 69, 87, 112, 125, 134, 146, 147, 150, 157, 157, 155, 152, 144, 131, 133, 136, 136, 143, 143, 129, 99, 69, 65, 63, 63, 66, 64, 65, 62, 62, 66, 64, 63, 63, 62, 61, 61, 61, 64, 67, 66, 66, 64, 64, 64, 66, 66, 67, 65, 62, 60, 62, 62, 62, 64, 65, 66, 65, 63, 61, 60, 61, 63, 64, 62, 62, 63, 62, 64, 65, 63, 66, 67, 68, 68, 64, 65, 65, 66, 66, 65, 62, 60, 60, 62, 59, 56, 59, 62, 64, 67, 67, 67, 66, 67, 66, 65, 68, 73, 75, 74, 71, 70, 66, 58, 46, 39, 41, 41, 40, 44, 46, 51, 51, 49, 51, 57, 60, 60, 59, 59, 60, 56, 58, 59, 55, 55, 58, 60, 60, 61, 60, 62, 60, 61, 62, 62, 60, 60, 62, 62, 63, 63, 64, 63, 63, 62, 58, 57, 57, 57, 59, 53, 54, 55, 53, 53, 56, 55, 53, 54, 55, 56, 57, 56, 58, 59, 64, 65, 65, 64, 66, 67, 60, 64, 67, 56, 65, 107, 90, 59, 60, 65 },
     { 69, 69, 72, 71, 69, 69, 66, 64, 63, 62, 59, 60, 63, 60, 58, 58, 58, 56, 53, 55, 54, 48, 43, 49, 52, 54, 54, 52, 55, 54, 49, 47, 43, 42, 46, 47, 48, 48, 48, 53, 56, 58, 57, 56, 58, 59, 62, 63, 66, 66, 65, 65, 64, 65, 64, 62, 62, 63, 60, 62, 65, 65, 61, 60, 61, 65, 63, 58, 59, 61, 61, 57, 59, 63, 80, 105, 121, 131, 141, 147, 157, 158, 157, 158, 156, 157, 139, 132, 135, 134, 139, 141, 146, 134, 101, 77, 64, 62, 65, 66, 69, 66, 63, 66, 65, 63, 65, 64, 60, 61, 65, 65, 65, 68, 67, 65, 65, 66, 68, 67, 65, 64, 62, 62, 63, 64, 64, 63, 63, 63, 64, 63, 62, 60, 61, 64, 64, 62, 63, 64, 63, 63, 63, 63, 62, 66, 67, 64, 63, 64, 64, 63, 62, 61, 62, 60, 61, 63, 61, 57, 59, 62, 63, 64, 64, 66, 66, 66, 65, 63, 68, 71, 73, 75, 72, 71, 68, 64, 57, 50, 49, 47, 47, 50, 50, 51, 48, 43, 45, 50, 53, 54, 54, 56, 57, 54, 56, 57, 56, 57, 60, 60, 61, 62, 62, 62, 61, 62, 63, 62, 60, 60, 63, 62, 62, 61, 61, 61, 62, 62, 60, 59, 57, 58, 61, 56, 58, 56, 56, 56, 57, 56, 56, 58, 57, 57, 59, 60, 61, 58, 64, 67, 66, 65, 65, 69, 65, 67, 67, 61, 67, 104, 90, 58, 57, 65 },
     { 74, 74, 75, 71, 68, 70, 69, 70, 68, 64, 62, 63, 64, 60, 58, 60, 62, 60, 53, 52, 53, 56, 53, 50, 46, 45, 49, 51, 54, 56, 48, 45, 45, 48, 53, 55, 56, 55, 54, 52, 54, 58, 57, 56, 56, 56, 59, 62, 62, 62, 62, 65, 65, 64, 62, 62, 62, 63, 62, 63, 63, 65, 62, 61, 62, 64, 59, 56, 56, 60, 64, 61, 58, 62, 74, 96, 120, 131, 135, 144, 159, 159, 154, 158, 157, 155, 145, 135, 134, 135, 136, 135, 145, 151, 143, 121, 85, 65, 63, 66, 69, 65, 63, 64, 65, 64, 64, 65, 62, 63, 68, 68, 65, 65, 66, 65, 64, 61, 62, 66, 69, 69, 68, 63, 61, 63, 63, 62, 63, 63, 64, 64, 62, 62, 62, 61, 62, 63, 64, 63, 63, 62, 60, 63, 61, 63, 64, 62, 62, 61, 62, 61, 60, 59, 59, 59, 61, 64, 62, 58, 61, 63, 63, 63, 62, 62, 64, 64, 65, 65, 69, 68, 71, 74, 73, 71, 68, 66, 62, 61, 61, 61, 62, 64, 61, 60, 57, 53, 50, 49, 49, 50, 47, 48, 52, 54, 53, 54, 55, 57, 57, 58, 60, 61, 62, 61, 61, 64, 63, 62, 61, 61, 61, 61, 62, 62, 63, 64, 64, 63, 62, 63, 62, 59, 59, 59, 61, 60, 57, 57, 57, 57, 58, 59, 59, 60, 62, 63, 65, 65, 67, 66, 69, 69, 66, 67, 66, 68, 69, 67, 63, 68, 63, 58, 57, 65 },
@@ -0,0 +1,181 @@
+// chain.c
+// Strömmande kedja av två kernels med radbuffert i stället för mellanbild.
+#include "dtekv-lib.h"
+#include "chain.h"
+#include "kernels.h"
+#include "profile.h"
+#include "log.h"
+#include <stddef.h>
+
+// Ring med steg 1:s utrader. Mellanrad r ligger på plats r % k2->ksize.
+static CONV_SCRATCH unsigned char chain_ring[KERNEL_MAX_SIZE][CONV_MAX_WIDTH] __attribute__((aligned(4)));
+
+int chain_init(chain_state_t* st, const unsigned char* input, unsigned char* output, int width, int height, const conv_kernel_t* k1, const conv_kernel_t* k2, const conv_options_t* opts) {
+    border_mode_t border = opts ? opts->border : BORDER_ZERO;
+
+    // Wrap behöver rader från motsatt kant innan första utraden kan räknas
+    if (border == BORDER_WRAP || width > CONV_MAX_WIDTH ||
+        k1->ksize > KERNEL_MAX_SIZE || k2->ksize > KERNEL_MAX_SIZE) {
+        return 0;
+    }
+
+    st->input = input;
+    st->output = output;
+    st->width = width;
+    st->height = height;
+    st->k1 = k1;
+    st->k2 = k2;
+    st->border = border;
+    st->next_mid = 0;
+    st->next_out = 0;
+    st->packed = NULL;
+    return 1;
+}
+
+// Hoppar till utrad y. Mellanraderna före y - kcenter2 behövs inte, så
+// ringen fylls från där; resultatet blir detsamma som från rad 0.
+void chain_seek(chain_state_t* st, int y) {
+    int c2 = st->k2->ksize / 2;
+    st->next_out = y;
+    st->next_mid = y - c2 > 0 ? y - c2 : 0;
+}
+
+/*
+ * Funktion: chain_step
+ * --------------------
+ * För varje utrad y i steg 2 produceras först de mellanrader som fattas,
+ * upp till y + kcenter2, direkt ur indata. Sedan räknas utraden ur ringen.
+ * Clamp och mirror pekar alltid på rader inom fönstret y +- kcenter2, som
+ * ligger kvar i ringen.
+ */
+int chain_step(chain_state_t* st, int max_rows) {
+    const conv_kernel_t* k1 = st->k1;
+    const conv_kernel_t* k2 = st->k2;
+    int c1 = k1->ksize / 2;
+    int c2 = k2->ksize / 2;
+    int width = st->width;
+    int height = st->height;
+    const unsigned char* src[KERNEL_MAX_SIZE];
+
+    while (max_rows-- > 0 && st->next_out < height) {
+        int y = st->next_out;
+
+        // Steg 1: fyll ringen fram till y + c2
+        int need = y + c2 < height ? y + c2 : height - 1;
+        PROF_BEGIN(PROF_CHAIN_STAGE1);
+        while (st->next_mid <= need) {
+            int m = st->next_mid;
+            for (int ky = 0; ky < k1->ksize; ky++) {
+                src[ky] = st->packed ? packed_source_row(st->packed, m + ky - c1, st->border)
+                                     : conv_source_row(st->input, width, height, m + ky - c1, st->border);
+            }
+            convolve_row(src, chain_ring[m % k2->ksize], width, k1, st->border);
+            st->next_mid++;
+        }
+        PROF_END(PROF_CHAIN_STAGE1);
+
+        // Steg 2: utraden ur ringen
+        PROF_BEGIN(PROF_CHAIN_STAGE2);
+        for (int ky = 0; ky < k2->ksize; ky++) {
+            int iy = conv_border_index(y + ky - c2, height, st->border);
+            src[ky] = iy < 0 ? conv_zero_row : chain_ring[iy % k2->ksize];
+        }
+        convolve_row(src, st->output + y * width, width, k2, st->border);
+        PROF_END(PROF_CHAIN_STAGE2);
+        st->next_out++;
+    }
+    return height - st->next_out;
+}
+
+/*
+ * Funktion: kernel_compose
+ * ------------------------
+ * Två korrelationer i följd är en korrelation med faltningen av kernlarna:
+ * table[m] = summan av k1[i] * k2[j] över alla i + j = m (i båda led).
+ * Divisorn blir d1 * d2. Gaussian 3x3 följt av box 3x3 blir till exempel
+ * [1 3 4 3 1]^T x [1 3 4 3 1] / 144.
+ */
+int kernel_compose(const conv_kernel_t* k1, const conv_kernel_t* k2, int* table) {
+    int s1 = k1->ksize;
+    int s2 = k2->ksize;
+    int size = s1 + s2 - 1;
+    if (size > KERNEL_MAX_SIZE) return 0;
+
+    for (int i = 0; i < size * size; i++) table[i] = 0;
+
+    for (int y1 = 0; y1 < s1; y1++) {
+        for (int x1 = 0; x1 < s1; x1++) {
+            int w1 = k1->table[y1 * s1 + x1];
+            if (w1 == 0) continue;
+            for (int y2 = 0; y2 < s2; y2++) {
+                for (int x2 = 0; x2 < s2; x2++) {
+                    table[(y1 + y2) * size + x1 + x2] += w1 * k2->table[y2 * s2 + x2];
+                }
+            }
+        }
+    }
+    return size;
+}
+
+// Klippningen till [0,255] efter kerneln kan aldrig slå till om alla vikter
+// är icke-negativa och de summerar till högst divisorn (ingen offset).
+// Gäller box och gaussian, men inte edge och sharpen.
+static int clamp_inactive(const conv_kernel_t* k) {
+    int sum = 0;
+    for (int i = 0; i < k->ksize * k->ksize; i++) {
+        if (k->table[i] < 0) return 0;
+        sum += k->table[i];
+    }
+    return k->offset == 0 && k->divisor > 0 && sum <= k->divisor;
+}
+
+/*
+ * Funktion: chain_plan
+ * --------------------
+ * Blur -> blur kan köras som en enda sammansatt kernel, vilket halverar
+ * antalet pass. Båda stegen måste vara blur-filter (se clamp_inactive),
+ * annars körs kedjan strömmad.
+ *
+ * Sammansättningen är inte bit-identisk med två pass: mellanbilden avrundas
+ * nedåt efter steg 1 och nollkanten läggs på mellanbilden, medan den
+ * sammansatta kerneln delar bara en gång och ser förbi kanten. Mer än
+ * kcenter2 pixlar från kanten blir skillnaden högst 1 (sammansatt >= två
+ * pass); i kantbandet kan den vara större. Planen väljer därför bara
+ * CHAIN_FUSED när anroparen tillåter det med opts->allow_fusion.
+ */
+void chain_plan(chain_plan_t* plan, const conv_kernel_t* k1, const conv_kernel_t* k2, const conv_options_t* opts) {
+    plan->mode = CHAIN_STREAM;
+    if (!opts || !opts->allow_fusion) return;
+    if (!clamp_inactive(k1) || !clamp_inactive(k2)) return;
+    if (k1->divisor * k2->divisor > 65536) return; // 255 * divisor måste rymmas i int
+
+    int size = kernel_compose(k1, k2, plan->table);
+    if (size == 0) return;
+
+    plan->fused.table = plan->table;
+    plan->fused.ksize = size;
+    plan->fused.divisor = k1->divisor * k2->divisor;
+    plan->fused.offset = k2->offset;
+    plan->fused.span = NULL;
+    plan->fused.plan = NULL;
+    plan->mode = CHAIN_FUSED;
+}
+
+int convolve_chain(const unsigned char* input, unsigned char* output, int width, int height, const conv_kernel_t* k1, const conv_kernel_t* k2, const conv_options_t* opts) {
+    chain_plan_t plan;
+    chain_plan(&plan, k1, k2, opts);
+    if (plan.mode == CHAIN_FUSED) {
+        LOG_DEBUG("Chain fused into one kernel\n");
+        convolve_kernel(input, output, width, height, &plan.fused, opts);
+        return 1;
+    }
+
+    chain_state_t st;
+    if (!chain_init(&st, input, output, width, height, k1, k2, opts)) {
+        return 0;
+    }
+    LOG_DEBUG("Chain started\n");
+    chain_step(&st, height);
+    LOG_DEBUG("Chain done\n");
+    return 1;
+}
@@ -0,0 +1,62 @@
+// chain.h
+#ifndef CHAIN_H
+#define CHAIN_H
+
+#include "kernels.h"
+#include "packed.h"
+
+// Tillstånd för en kedja av två kernels som körs rad för rad.
+// Steg 1 skriver bara till en ring med k2->ksize rader; steg 2 läser en
+// rad så fort hela dess vertikala fönster finns i ringen.
+typedef struct {
+    const unsigned char* input;
+    unsigned char* output;
+    int width, height;
+    const conv_kernel_t* k1;
+    const conv_kernel_t* k2;
+    border_mode_t border;
+    int next_mid;   // Nästa rad som steg 1 ska producera
+    int next_out;   // Nästa rad som steg 2 ska producera
+    packed_reader_t* packed;  // Läs indata ur en packad bild i stället (NULL = input)
+} chain_state_t;
+
+// Hur en kedja körs
+typedef enum {
+    CHAIN_STREAM,  // Två steg via radbuffert, bit-identiskt med två pass
+    CHAIN_FUSED    // En sammansatt kernel, ett enda pass
+} chain_mode_t;
+
+// Plan för en kedja. Vid CHAIN_FUSED pekar fused.table på table.
+typedef struct {
+    chain_mode_t mode;
+    conv_kernel_t fused;
+    int table[KERNEL_MAX_SIZE * KERNEL_MAX_SIZE];
+} chain_plan_t;
+
+// Sätter ihop k1 följt av k2 till en kernel av storlek k1->ksize + k2->ksize - 1.
+// Returnerar den nya storleken, eller 0 om den inte ryms i KERNEL_MAX_SIZE.
+int kernel_compose(const conv_kernel_t* k1, const conv_kernel_t* k2, int* table);
+
+// Väljer hur kedjan ska köras. Sammansättning väljs bara om opts->allow_fusion
+// är satt och det går att bevisa att klippningen efter stegen aldrig slår till
+// (blur -> blur). Se chain.c för hur resultatet då skiljer sig från två pass.
+void chain_plan(chain_plan_t* plan, const conv_kernel_t* k1, const conv_kernel_t* k2, const conv_options_t* opts);
+
+// Förbereder en kedja. Returnerar 0 om kombinationen inte kan strömmas
+// (BORDER_WRAP, för stor kernel eller bild); kör då två hela pass i stället.
+int chain_init(chain_state_t* st, const unsigned char* input, unsigned char* output, int width, int height, const conv_kernel_t* k1, const conv_kernel_t* k2, const conv_options_t* opts);
+
+// Producerar upp till max_rows utrader. Returnerar antalet rader som återstår.
+int chain_step(chain_state_t* st, int max_rows);
+
+// Börjar om från utrad y (efter chain_init), t.ex. för att köra ett band
+// av bilden för sig. Kostar kcenter2 extra mellanrader i bandets överkant.
+// Går inte med packad indata, som bara kan avkodas framåt.
+void chain_seek(chain_state_t* st, int y);
+
+// Hela kedjan i ett anrop enligt chain_plan(). Strömmad kedja ger samma
+// resultat som två convolve_kernel() via en mellanbild (inklusive klippningen
+// till [0,255] mellan stegen). Returnerar 0 om kedjan inte kan köras så.
+int convolve_chain(const unsigned char* input, unsigned char* output, int width, int height, const conv_kernel_t* k1, const conv_kernel_t* k2, const conv_options_t* opts);
+
+#endif
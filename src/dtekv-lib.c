@@ -1,68 +1,79 @@
 //dtekv-lib.c
 #include "dtekv-lib.h"
+#include "main.h"
+#include "hal.h"
+#include "log.h"
 
-#define JTAG_UART ((volatile unsigned int*) 0x04000040)
-#define JTAG_CTRL ((volatile unsigned int*) 0x04000044)
-
+// Texten och ramarna går genom samma buffert (log.c), i ordning
 void uart_putchar(unsigned char c) {
-    while (((*JTAG_CTRL) & 0xFFFF0000) == 0);  // vänta tills ledig
-    *JTAG_UART = c;
+    uart_write(&c, 1);
+}
+
+void uart_write(const unsigned char* data, int len) {
+    log_write_wait((const char*)data, (unsigned int)len); // väntar på plats
 }
 
 int uart_getchar(void) {
-    if (((*JTAG_CTRL) & 0x0000FFFF) == 0)
-        return -1; // inget att läsa
-    return *JTAG_UART;
+    return hal_uart_getc(); // -1 om inget att läsa
 }
 
 void printc(char s)
 {
-    while (((*JTAG_CTRL)&0xffff0000) == 0);
-    *JTAG_UART = s;
+    log_write(&s, 1);
 }
 
 void print(const char *s)
 {  
-  while (*s != '\0') {    
-      printc(*s);
-      s++;
-  }
+  unsigned int len = 0;
+  while (s[len] != '\0') len++;
+  log_write(s, len);
 }
 
 void print_dec(unsigned int x)
 {
-  unsigned divident = 1000000000;
-  char first = 0;
-  do {
-    int dv = x / divident;
-    if (dv != 0) first = 1;
-    if (first != 0)
-      printc(48+dv);
-    x -= dv*divident;
-    divident /= 10;
-  } while (divident != 0);
-    if (first == 0)
-	printc(48);
+  char digits[10];
+  log_write(digits, log_format_dec(digits, x));
 }
 
 void print_hex32 ( unsigned int x)
 {
-  printc('0');
-  printc('x');
+  char text[10];
+  text[0] = '0';
+  text[1] = 'x';
   for (int i = 7; i >= 0; i--) {
     char hd = (char) ((x >> (i*4)) & 0xf);
     if (hd < 10)
       hd += '0';
     else
       hd += ('A' - 10);
-    printc(hd);
+    text[9 - i] = hd;
   }   
+  log_write(text, 10);
+}
+
+// 64/32-bitars division genom skift och subtraktion. Länkningen sker utan
+// libgcc, så __udivdi3 finns inte. Bara konstanta skift, de blir inline.
+unsigned long long u64_div_u32(unsigned long long n, unsigned int d)
+{
+  unsigned long long q = 0, r = 0;
+  for (int i = 0; i < 64; i++) {
+    r = (r << 1) | (n >> 63);
+    n <<= 1;
+    q <<= 1;
+    if (r >= d) {
+      r -= d;
+      q |= 1;
+    }
+  }
+  return q;
 }
 
+#ifndef HOST
 /* function: handle_exception
    Description: This code handles an exception. */
 void handle_exception ( unsigned arg0, unsigned arg1, unsigned arg2, unsigned arg3, unsigned arg4, unsigned arg5, unsigned mcause, unsigned syscall_num )
 {
+  log_flush(); /* Interrupten tömmer inte bufferten här, och felet får inte släppas */
   switch (mcause)
     {
     case 0:
@@ -85,8 +96,10 @@ void handle_exception ( unsigned arg0, unsigned arg1, unsigned arg2, unsigned ar
   
   print("Exception Address: ");
   print_hex32(arg0); printc('\n');
+  log_flush();
   while (1);
 }
+#endif
 
 /*
  * nextprime
@@ -2,5 +2,7 @@ void printc(char );
 void print(const char *s);
 void print_dec(unsigned int);
 void print_hex32 ( unsigned int);
+// n / d utan libgcc (kortet har ingen 64-bitars division)
+unsigned long long u64_div_u32(unsigned long long n, unsigned int d);
 void handle_exception ( unsigned arg0, unsigned arg1, unsigned arg2, unsigned arg3, unsigned arg4, unsigned arg5, unsigned mcause, unsigned syscall_num );
 int nextprime( int inval );
\ No newline at end of file
@@ -0,0 +1,144 @@
+// frame.c
+// Ramformatet i frame.h. Används både på kortet och på värden.
+#include "frame.h"
+#include "packed.h"
+#include <string.h>
+
+enum {
+    PARSE_SYNC0,
+    PARSE_SYNC1,
+    PARSE_TYPE,
+    PARSE_LEN0,
+    PARSE_LEN1,
+    PARSE_DATA,
+    PARSE_CHECK0,
+    PARSE_CHECK1
+};
+
+// Fletcher-16. Summorna reduceras först i frame_check(): efter
+// FRAME_MAX_PAYLOAD + 3 bytes är s2 högst 255 * 515 * 516 / 2, långt under 2^32.
+static void check_add(unsigned int* s1, unsigned int* s2, unsigned char b) {
+    *s1 += b;
+    *s2 += *s1;
+}
+
+static unsigned int frame_check(unsigned int s1, unsigned int s2) {
+    return ((s2 % 255) << 8) | (s1 % 255);
+}
+
+void frame_parser_init(frame_parser_t* p) {
+    p->state = PARSE_SYNC0;
+    p->errors = 0;
+}
+
+int frame_idle(const frame_parser_t* p) {
+    return p->state == PARSE_SYNC0;
+}
+
+/*
+ * Funktion: frame_feed
+ * --------------------
+ * En tillståndsmaskin per byte. Efter en ram med fel kontroll letas nästa
+ * synk upp från byten efter den. En förstörd längd kan alltså dra med sig
+ * några ramar till; de saknade raderna begärs då om med FRAME_NAK.
+ */
+int frame_feed(frame_parser_t* p, unsigned char b) {
+    switch (p->state) {
+        case PARSE_SYNC0:
+            if (b == FRAME_SYNC0) p->state = PARSE_SYNC1;
+            return 0;
+
+        case PARSE_SYNC1:
+            p->state = b == FRAME_SYNC1 ? PARSE_TYPE : b == FRAME_SYNC0 ? PARSE_SYNC1 : PARSE_SYNC0;
+            return 0;
+
+        case PARSE_TYPE:
+            p->type = b;
+            p->s1 = 0;
+            p->s2 = 0;
+            check_add(&p->s1, &p->s2, b);
+            p->state = PARSE_LEN0;
+            return 0;
+
+        case PARSE_LEN0:
+            p->len = b;
+            check_add(&p->s1, &p->s2, b);
+            p->state = PARSE_LEN1;
+            return 0;
+
+        case PARSE_LEN1:
+            p->len |= b << 8;
+            check_add(&p->s1, &p->s2, b);
+            if (p->len > FRAME_MAX_PAYLOAD) {
+                p->errors++;
+                p->state = PARSE_SYNC0;
+                return 0;
+            }
+            p->pos = 0;
+            p->state = p->len ? PARSE_DATA : PARSE_CHECK0;
+            return 0;
+
+        case PARSE_DATA:
+            p->data[p->pos++] = b;
+            check_add(&p->s1, &p->s2, b);
+            if (p->pos == p->len) p->state = PARSE_CHECK0;
+            return 0;
+
+        case PARSE_CHECK0:
+            p->check = b;
+            p->state = PARSE_CHECK1;
+            return 0;
+
+        case PARSE_CHECK1:
+            p->check |= b << 8;
+            p->state = PARSE_SYNC0;
+            if (p->check != frame_check(p->s1, p->s2)) {
+                p->errors++;
+                return 0;
+            }
+            return 1;
+    }
+    p->state = PARSE_SYNC0;
+    return 0;
+}
+
+int frame_build(unsigned char* out, int type, const unsigned char* payload, int len) {
+    unsigned int s1 = 0, s2 = 0;
+    out[0] = FRAME_SYNC0;
+    out[1] = FRAME_SYNC1;
+    out[2] = (unsigned char)type;
+    frame_put16(out + 3, len);
+    if (len) memcpy(out + 5, payload, len);
+    for (int i = 2; i < 5 + len; i++) check_add(&s1, &s2, out[i]);
+    frame_put16(out + 5 + len, frame_check(s1, s2));
+    return len + FRAME_OVERHEAD;
+}
+
+int frame_row_payload(unsigned char* out, int row, const unsigned char* pixels, const unsigned char* prev, int width, int packed) {
+    frame_put16(out, row);
+    if (packed) {
+        int n = packed_encode_row(pixels, prev, width, out + FRAME_ROW_HEADER);
+        if (n < width) {
+            out[2] = FRAME_ROW_PACKED;
+            return FRAME_ROW_HEADER + n;
+        }
+    }
+    out[2] = FRAME_ROW_RAW;
+    memcpy(out + FRAME_ROW_HEADER, pixels, width);
+    return FRAME_ROW_HEADER + width;
+}
+
+int frame_row_decode(const unsigned char* payload, int len, int width, unsigned char* out, const unsigned char* prev) {
+    if (len < FRAME_ROW_HEADER) return 0;
+    const unsigned char* data = payload + FRAME_ROW_HEADER;
+    len -= FRAME_ROW_HEADER;
+    switch (payload[2]) {
+        case FRAME_ROW_RAW:
+            if (len != width) return 0;
+            memcpy(out, data, width);
+            return 1;
+        case FRAME_ROW_PACKED:
+            return packed_decode_row(data, len, width, out, prev);
+    }
+    return 0;
+}
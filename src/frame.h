@@ -0,0 +1,118 @@
+// frame.h
+#ifndef FRAME_H
+#define FRAME_H
+
+// Binära ramar över JTAG UART, för bildöverföring mellan kortet (xfer.c)
+// och värden (host/imglink.c):
+//
+//   0xA5 0x5A  typ  längd (16 bitar LE)  data  kontroll (16 bitar LE)
+//
+// Kontrollen är Fletcher-16 över typ, längd och data. Mottagaren letar
+// efter synkbytes, så text från print() mellan ramarna hoppas över.
+#define FRAME_SYNC0 0xA5
+#define FRAME_SYNC1 0x5A
+#define FRAME_OVERHEAD 7
+
+// En rad med packed.c-kodning plus radhuvud ryms med marginal
+#define FRAME_MAX_PAYLOAD 512
+
+// Flödeskontroll för rader. Mottagaren kvitterar med FRAME_ACK (nästa rad
+// den väntar på) var FRAME_ACK_ROWS:e rad, och sändaren har högst
+// FRAME_WINDOW_ROWS rader okvitterade. Fönstret döljer rundturstiden så
+// länge det tar längre tid att skicka det än en rundtur tar, och begränsar
+// hur mycket som skickas om efter ett fel.
+#define FRAME_ACK_ROWS 16
+#define FRAME_WINDOW_ROWS 64
+
+typedef enum {
+    FRAME_PING = 'P',      // Ekas tillbaka oförändrad, för att mäta rundturstiden
+    FRAME_UPLOAD = 'U',    // Värd -> kort: bredd, höjd, läge, switchar 1 och 2
+    FRAME_DOWNLOAD = 'D',  // Värd -> kort: bild (FRAME_IMG_*), 1 = packade rader tillåtna
+    FRAME_INFO = 'I',      // Kort -> värd: bredd, höjd inför en nedladdning
+    FRAME_ROW = 'R',       // Radnummer, kodning (FRAME_ROW_*), pixlar
+    FRAME_END = 'E',       // Alla rader skickade: antal rader
+    FRAME_ACK = 'A',       // Rader mottagna t.o.m. n - 1; n = höjden efter FRAME_END
+    FRAME_NAK = 'N',       // Skicka om från rad n och framåt (go-back-N)
+    FRAME_KERNEL = 'K',    // Värd -> kort: egen kernel (FRAME_KERNEL_*), svar FRAME_ACK med platsen
+    FRAME_ERROR = 'X'      // Begäran avvisad: felkod (FRAME_ERR_*)
+} frame_type_t;
+
+// Uppladdningens läge: spara bara, eller kör filter/kedja medan raderna kommer
+typedef enum {
+    FRAME_MODE_STORE,
+    FRAME_MODE_FILTER,
+    FRAME_MODE_CHAIN
+} frame_mode_t;
+
+// Bild att ladda ner
+typedef enum {
+    FRAME_IMG_RESULT,
+    FRAME_IMG_INPUT
+} frame_image_t;
+
+// Radens kodning
+typedef enum {
+    FRAME_ROW_RAW,     // width bytes som de är
+    FRAME_ROW_PACKED   // packed_encode_row() mot föregående rad
+} frame_row_t;
+
+typedef enum {
+    FRAME_ERR_SIZE = 1,    // Annan storlek än IMG_WIDTH x IMG_HEIGHT
+    FRAME_ERR_FILTER,      // Inget giltigt filter i switcharna
+    FRAME_ERR_REQUEST,     // Okänt läge eller för kort begäran
+    FRAME_ERR_KERNEL,      // Ogiltig egen kernel eller plats
+    FRAME_ERR_CHANGED      // Bilden skrevs över under nedladdningen
+} frame_error_t;
+
+// FRAME_KERNEL: plats (1-7), storlek, divisor (32 bitar, så att 1 << 16
+// ryms), offset (16 bitar med tecken), sedan storlek * storlek vikter radvis
+// (16 bitar med tecken)
+#define FRAME_KERNEL_HEADER 8
+
+// Mottagarens tillstånd; matas en byte i taget
+typedef struct {
+    int state;
+    int type;
+    int len;
+    int pos;
+    unsigned int s1, s2;   // Löpande Fletcher-summor
+    unsigned int check;
+    unsigned int errors;   // Ramar med fel kontroll eller för lång längd
+    unsigned char data[FRAME_MAX_PAYLOAD];
+} frame_parser_t;
+
+void frame_parser_init(frame_parser_t* p);
+
+// 1 om mottagaren står mellan ramar; en byte som inte är FRAME_SYNC0 är då text
+int frame_idle(const frame_parser_t* p);
+
+// Tar emot en byte. Returnerar 1 när en hel ram med rätt kontroll ligger
+// i p->type, p->len och p->data; de gäller till nästa anrop.
+int frame_feed(frame_parser_t* p, unsigned char b);
+
+// Bygger en ram i out, som måste rymma len + FRAME_OVERHEAD bytes.
+// Returnerar ramens längd.
+int frame_build(unsigned char* out, int type, const unsigned char* payload, int len);
+
+// Data för en FRAME_ROW. prev är raden ovanför (conv_zero_row för rad 0);
+// med packed = 1 väljs packad kodning när den blir mindre. out måste rymma
+// FRAME_ROW_HEADER + PACKED_ROW_BOUND(width) bytes. Returnerar längden.
+#define FRAME_ROW_HEADER 3
+int frame_row_payload(unsigned char* out, int row, const unsigned char* pixels, const unsigned char* prev, int width, int packed);
+
+// Avkodar data i en FRAME_ROW till out. Radnumret står först
+// (frame_get16(payload)) och avgör vilken rad som är prev. Returnerar 0 om
+// raden är felaktig.
+int frame_row_decode(const unsigned char* payload, int len, int width, unsigned char* out, const unsigned char* prev);
+
+// 16-bitars tal i data, little endian
+static inline void frame_put16(unsigned char* p, unsigned int v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static inline unsigned int frame_get16(const unsigned char* p) {
+    return p[0] | (p[1] << 8);
+}
+
+#endif
@@ -0,0 +1,272 @@
+// gauss_iir.c
+// Rekursiv gaussisk oskärpa (se gauss_iir.h).
+//
+// Filtret är w[n] = B x[n] + a1 w[n-1] + a2 w[n-2] + a3 w[n-3] framåt och
+// samma sak bakåt på w. B + a1 + a2 + a3 = 1 exakt i fixpunkt, så en jämn
+// yta förblir jämn. Tillstånden har 20 bråkbitar: med sigma 32 förstärks
+// avrundningsfel upp till ~8000 gånger (1 / B), och 20 bitar håller dem
+// långt under en gråskalenivå.
+#include "dtekv-lib.h"
+#include "gauss_iir.h"
+
+#define IIR_COEF_BITS 28
+#define IIR_STATE_BITS 20
+
+// Kolumnpasset går i band av kolumner; bandet ryms i IIR_STRIP_INTS, som
+// räcker till 16 kolumner av en bild lika hög som CONV_MAX_WIDTH. Smalare
+// band kostar bara fler varv, inte fler operationer per pixel.
+#define IIR_STRIP_INTS (16 * CONV_MAX_WIDTH)
+#define IIR_STRIP_MAX_COLS (CONV_MAX_WIDTH / 16)
+
+// Längsta simulering i gauss_iir_init(), som också använder iir_line
+#define IIR_TRIGGS_LEN (16 * (GAUSS_IIR_MAX_SIGMA / GAUSS_IIR_SIGMA_ONE) + 64)
+#define IIR_LINE_INTS (CONV_MAX_WIDTH + 2 * GAUSS_IIR_MAX_MARGIN > IIR_TRIGGS_LEN ? \
+                       CONV_MAX_WIDTH + 2 * GAUSS_IIR_MAX_MARGIN : IIR_TRIGGS_LEN)
+
+// Raden som filtreras (framåtvärden, sedan bakåtvärden), med utfyllnad
+static CONV_SCRATCH int iir_line[IIR_LINE_INTS];
+// Bandet för kolumnpasset, rad för rad
+static CONV_SCRATCH int iir_strip[IIR_STRIP_INTS];
+// Startvärden per kolumn i bandet: före första raden och efter sista (3 rader)
+static CONV_SCRATCH int iir_edge[4][IIR_STRIP_MAX_COLS];
+
+// Ett steg av filtret. x och w1..w3 har IIR_STATE_BITS bråkbitar.
+static inline __attribute__((always_inline)) int iir_step(const gauss_iir_t* g, int x, int w1, int w2, int w3) {
+    long long acc = (long long)g->b * x + (long long)g->a[0] * w1 + (long long)g->a[1] * w2 + (long long)g->a[2] * w3;
+    return (int)((acc + (1LL << (IIR_COEF_BITS - 1))) >> IIR_COEF_BITS);
+}
+
+static inline int iir_pixel(int v) {
+    v = (v + (1 << (IIR_STATE_BITS - 1))) >> IIR_STATE_BITS;
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+/*
+ * Funktion: iir_tail
+ * ------------------
+ * Bakåtpassets tre startvärden efter sista samplet (Triggs och Sdika
+ * 2006). Bortom änden antas indata vara u för alltid; framåtpasset hade då
+ * fortsatt från w1..w3 (de tre sista framåtvärdena) mot u, och bakåtpasset
+ * startat i u långt bort. Startvärdena blir u + M * (w - u), vilket är
+ * exakt för BORDER_ZERO (u = 0) och BORDER_CLAMP (u = sista pixeln).
+ */
+static inline void iir_tail(const gauss_iir_t* g, int u, int w1, int w2, int w3, int* e0, int* e1, int* e2) {
+    int d0 = w1 - u, d1 = w2 - u, d2 = w3 - u;
+    int* e[3] = { e0, e1, e2 };
+    for (int k = 0; k < 3; k++) {
+        long long acc = (long long)g->m[k][0] * d0 + (long long)g->m[k][1] * d1 + (long long)g->m[k][2] * d2;
+        *e[k] = u + (int)((acc + (1LL << (IIR_STATE_BITS - 1))) >> IIR_STATE_BITS);
+    }
+}
+
+// ===========================================================
+// Koefficienter
+// ===========================================================
+
+// Heltalsroten ur x
+static unsigned int iir_isqrt(unsigned int x) {
+    unsigned int r = 0, bit = 1u << 30;
+    while (bit > x) bit >>= 2;
+    while (bit != 0) {
+        if (x >= r + bit) {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return r;
+}
+
+// n / d med tecken, via u64_div_u32() (dtekv-lib.c)
+static long long iir_div(long long n, unsigned int d) {
+    unsigned long long u = n < 0 ? -(unsigned long long)n : (unsigned long long)n;
+    unsigned long long q = u64_div_u32(u, d);
+    return n < 0 ? -(long long)q : (long long)q;
+}
+
+// c * x >> 16 för en konstant c med 16 bråkbitar
+#define IIR_Q16(c, x) (((long long)(c) * (x)) >> 16)
+
+/*
+ * Funktion: gauss_iir_init
+ * ------------------------
+ * Young och van Vliets formler med 16 bråkbitar:
+ *
+ *   q  = 0.98711 sigma - 0.96330                 (sigma >= 2.5)
+ *   q  = 3.97156 - 4.14554 sqrt(1 - 0.26891 sigma)  (annars)
+ *   b0 = 1.57825 + 2.44413 q + 1.4281 q^2 + 0.422205 q^3
+ *   b1 = 2.44413 q + 2.85619 q^2 + 1.26661 q^3
+ *   b2 = -(1.4281 q^2 + 1.26661 q^3)
+ *   b3 = 0.422205 q^3
+ *
+ * ai = bi / b0 och B = 1 - a1 - a2 - a3. Med sigma <= 32 ryms q^3 i 32
+ * bitar. Triggs-Sdika-matrisen tas fram genom att köra filtret själv på
+ * de tre enhetsstarterna, så den blir exakt för de avrundade
+ * koefficienterna.
+ */
+int gauss_iir_init(gauss_iir_t* g, int sigma) {
+    if (sigma < GAUSS_IIR_MIN_SIGMA || sigma > GAUSS_IIR_MAX_SIGMA) return 0;
+
+    // sigma har 8 bråkbitar, q 16
+    int q;
+    if (sigma >= 640) {
+        q = ((64691 * sigma) >> 8) - 63131;
+    } else {
+        unsigned int t = 65536 - ((17623 * sigma) >> 8);
+        q = 260281 - (int)IIR_Q16(271682, iir_isqrt(t << 16));
+    }
+    int q2 = (int)IIR_Q16(q, q);
+    int q3 = (int)IIR_Q16(q2, q);
+
+    long long b0 = 103432 + IIR_Q16(160178, q) + IIR_Q16(93592, q2) + IIR_Q16(27670, q3);
+    long long b1 = IIR_Q16(160178, q) + IIR_Q16(187183, q2) + IIR_Q16(83009, q3);
+    long long b2 = -(IIR_Q16(93592, q2) + IIR_Q16(83009, q3));
+    long long b3 = IIR_Q16(27670, q3);
+
+    g->sigma = sigma;
+    g->a[0] = (int)iir_div(b1 * (1LL << IIR_COEF_BITS), (unsigned int)b0);
+    g->a[1] = (int)iir_div(b2 * (1LL << IIR_COEF_BITS), (unsigned int)b0);
+    g->a[2] = (int)iir_div(b3 * (1LL << IIR_COEF_BITS), (unsigned int)b0);
+    g->b = (1 << IIR_COEF_BITS) - g->a[0] - g->a[1] - g->a[2];
+    g->margin = (4 * sigma + GAUSS_IIR_SIGMA_ONE - 1) / GAUSS_IIR_SIGMA_ONE;
+
+    // Kolumn j: framåtpasset från w[N-1-j] = 1 utan indata, sedan bakåt
+    // från 0 långt bort. Svaret har klingat av efter ungefär 16 sigma.
+    int len = 16 * ((sigma + GAUSS_IIR_SIGMA_ONE - 1) / GAUSS_IIR_SIGMA_ONE) + 64;
+    for (int j = 0; j < 3; j++) {
+        int w[3] = { 0, 0, 0 };
+        w[j] = 1 << IIR_STATE_BITS;
+        for (int i = 0; i < len; i++) {
+            int v = iir_step(g, 0, w[0], w[1], w[2]);
+            w[2] = w[1];
+            w[1] = w[0];
+            w[0] = v;
+            iir_line[i] = v;
+        }
+        int e0 = 0, e1 = 0, e2 = 0;
+        for (int i = len - 1; i >= 0; i--) {
+            int v = iir_step(g, iir_line[i], e0, e1, e2);
+            e2 = e1;
+            e1 = e0;
+            e0 = v;
+        }
+        g->m[0][j] = e0;
+        g->m[1][j] = e1;
+        g->m[2][j] = e2;
+    }
+    return 1;
+}
+
+// ===========================================================
+// Filtret
+// ===========================================================
+
+// Radpasset: in -> out, en rad. Utfyllnaden (margin) hämtas enligt kantläget.
+static void iir_row(const unsigned char* in, unsigned char* out, int width, int margin, const gauss_iir_t* g, border_mode_t border) {
+    int n = width + 2 * margin;
+    int* w = iir_line;
+    for (int i = 0; i < n; i++) {
+        int sx = margin ? conv_border_index(i - margin, width, border) : i;
+        w[i] = in[sx] << IIR_STATE_BITS;
+    }
+
+    int u = border == BORDER_ZERO ? 0 : w[0];
+    int w1 = u, w2 = u, w3 = u;
+    for (int i = 0; i < n; i++) {
+        int v = iir_step(g, w[i], w1, w2, w3);
+        w3 = w2;
+        w2 = w1;
+        w1 = v;
+        w[i] = v;
+    }
+
+    u = border == BORDER_ZERO ? 0 : in[margin ? conv_border_index(width - 1 + margin, width, border) : width - 1] << IIR_STATE_BITS;
+    int e0, e1, e2;
+    iir_tail(g, u, w1, w2, w3, &e0, &e1, &e2);
+    for (int i = n - 1; i >= 0; i--) {
+        int v = iir_step(g, w[i], e0, e1, e2);
+        e2 = e1;
+        e1 = e0;
+        e0 = v;
+        if (i >= margin && i < margin + width) out[i - margin] = (unsigned char)iir_pixel(v);
+    }
+}
+
+/*
+ * Funktion: iir_columns
+ * ---------------------
+ * Kolumnpasset för kolumnerna x0..x0+cols-1 av img, på plats. Framåtpasset
+ * går rad för rad över bandet, så varje rad läses i följd; alla rader
+ * sparas i iir_strip eftersom bakåtpasset behöver dem. Sedan går
+ * bakåtpasset nedifrån och skriver tillbaka till img.
+ */
+static void iir_columns(unsigned char* img, int width, int height, int x0, int cols, int margin, const gauss_iir_t* g, border_mode_t border) {
+    int n = height + 2 * margin;
+    int* init = iir_edge[0];
+    const unsigned char* first = img + (margin ? conv_border_index(-margin, height, border) : 0) * width + x0;
+    const unsigned char* last = img + (margin ? conv_border_index(height - 1 + margin, height, border) : height - 1) * width + x0;
+    for (int c = 0; c < cols; c++) {
+        init[c] = border == BORDER_ZERO ? 0 : first[c] << IIR_STATE_BITS;
+    }
+
+    const int *w1 = init, *w2 = init, *w3 = init;
+    for (int r = 0; r < n; r++) {
+        const unsigned char* src = img + (margin ? conv_border_index(r - margin, height, border) : r) * width + x0;
+        int* w = iir_strip + r * cols;
+        for (int c = 0; c < cols; c++) {
+            w[c] = iir_step(g, src[c] << IIR_STATE_BITS, w1[c], w2[c], w3[c]);
+        }
+        w3 = w2;
+        w2 = w1;
+        w1 = w;
+    }
+
+    // Startvärden efter sista raden, innan bakåtpasset skriver över img
+    int *e0 = iir_edge[1], *e1 = iir_edge[2], *e2 = iir_edge[3];
+    for (int c = 0; c < cols; c++) {
+        int u = border == BORDER_ZERO ? 0 : last[c] << IIR_STATE_BITS;
+        iir_tail(g, u, w1[c], w2[c], w3[c], &e0[c], &e1[c], &e2[c]);
+    }
+
+    const int *y1 = e0, *y2 = e1, *y3 = e2;
+    for (int r = n - 1; r >= 0; r--) {
+        int* w = iir_strip + r * cols;
+        for (int c = 0; c < cols; c++) {
+            w[c] = iir_step(g, w[c], y1[c], y2[c], y3[c]);
+        }
+        if (r >= margin && r < margin + height) {
+            unsigned char* out = img + (r - margin) * width + x0;
+            for (int c = 0; c < cols; c++) out[c] = (unsigned char)iir_pixel(w[c]);
+        }
+        y3 = y2;
+        y2 = y1;
+        y1 = w;
+    }
+}
+
+/*
+ * Funktion: gauss_iir
+ * -------------------
+ * Radpasset skriver till output, som sedan filtreras kolumnvis på plats.
+ * Mellanresultatet avrundas alltså till 8 bitar en gång. Varje pass kostar
+ * 8 multiplikationer per pixel, plus utfyllnaden vid spegling och wrap.
+ */
+void gauss_iir(const unsigned char* input, unsigned char* output, int width, int height, const gauss_iir_t* g, border_mode_t border) {
+    int margin = border == BORDER_MIRROR || border == BORDER_WRAP ? g->margin : 0;
+    if (width > CONV_MAX_WIDTH || height + 2 * margin > IIR_STRIP_INTS) {
+        print("gauss_iir: unsupported size\n");
+        return;
+    }
+
+    for (int y = 0; y < height; y++) {
+        iir_row(input + y * width, output + y * width, width, margin, g, border);
+    }
+
+    int cols = IIR_STRIP_INTS / (height + 2 * margin);
+    if (cols > IIR_STRIP_MAX_COLS) cols = IIR_STRIP_MAX_COLS;
+    for (int x0 = 0; x0 < width; x0 += cols) {
+        iir_columns(output, width, height, x0, width - x0 < cols ? width - x0 : cols, margin, g, border);
+    }
+}
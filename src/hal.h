@@ -0,0 +1,151 @@
+// hal.h
+// Hårdvarulager för DTEK-V. På kortet är funktionerna tunna inline-omslag
+// kring MMIO-registren; med -DHOST (make host) finns de i host/hal_host.c
+// och läser/skriver vanliga variabler i processen.
+#ifndef HAL_H
+#define HAL_H
+
+#ifndef HOST
+
+// Hardware Registers mapping
+// Timer Registers
+#define timer_status (*(volatile unsigned int *) 0x04000020)
+#define timer_control (*(volatile unsigned int *) 0x04000024)
+#define timer_periodl (*(volatile unsigned int *) 0x04000028)
+#define timer_periodh (*(volatile unsigned int *) 0x0400002C)
+
+// I/O Registers
+#define toggle_reg (*(volatile unsigned int *) 0x04000010)
+#define toggle_regOffset (*(volatile unsigned int *) 0x04000018)
+#define btn_reg (*(volatile unsigned int *) 0x040000d0)
+#define led_reg (*(volatile unsigned int *) 0x04000000)
+#define display_reg ((volatile unsigned int *) 0x04000050) // Sex 7-segment, 0x10 isär
+
+// JTAG UART
+#define jtag_uart (*(volatile unsigned int *) 0x04000040)
+#define jtag_ctrl (*(volatile unsigned int *) 0x04000044)
+
+static inline unsigned int hal_read_switches(void) { return toggle_reg & 0x3FF; }
+static inline unsigned int hal_read_buttons(void) { return btn_reg; }
+static inline void hal_write_leds(unsigned int mask) { led_reg = mask & 0x3FF; }
+
+// Segment för display n (0 = längst till höger), aktivt låga: bit 0-6 = a-g
+static inline void hal_write_display(int n, unsigned int segments) { display_reg[n * 4] = segments & 0xFF; }
+
+// Blockerar tills det finns plats i sändbufferten
+static inline void hal_uart_putc(unsigned char c) {
+    while ((jtag_ctrl & 0xFFFF0000) == 0);
+    jtag_uart = c;
+}
+
+// Lediga platser i sändbufferten (WSPACE), dvs hur många hal_uart_putc()
+// som går utan att vänta
+static inline unsigned int hal_uart_tx_space(void) {
+    return jtag_ctrl >> 16;
+}
+
+// -1 om inget tecken väntar. Dataregistret läses en gång: RVALID (bit 15)
+// säger om byten i bit 0-7 är giltig, och läsningen tar den ur kön.
+static inline int hal_uart_getc(void) {
+    unsigned int d = jtag_uart;
+    if (!(d & 0x8000)) return -1;
+    return d & 0xFF;
+}
+
+// Periodisk timer-interrupt, period i klockcykler
+static inline void hal_timer_start(unsigned int period) {
+    timer_control = 0x8; // Stäng av timer medan vi konfigurerar
+    timer_periodl = period & 0xFFFF;
+    timer_periodh = (period >> 16) & 0xFFFF;
+    timer_status = 0;    // Nollställ status
+    timer_control = 0x7; // Aktivera timer, starta, och tillåt interrupt
+}
+
+// Kvitterar timeouten; returnerar 1 om timern hade löst ut
+static inline int hal_timer_ack(void) {
+    if (timer_status & 1) {
+        timer_status = 0;
+        return 1;
+    }
+    return 0;
+}
+
+// Slår på timerns interrupt (linje 16, som handle_interrupt väntar på)
+// och interrupts globalt (mstatus.MIE)
+static inline void hal_irq_enable(void) {
+    asm volatile ("csrs mie, %0" :: "r"(1u << 16));
+    asm volatile ("csrsi mstatus, 8");
+}
+
+// Stänger av interrupts och returnerar det tidigare läget (mstatus.MIE),
+// som hal_irq_restore() lämnar tillbaka
+static inline unsigned int hal_irq_save(void) {
+    unsigned int status;
+    asm volatile ("csrrci %0, mstatus, 8" : "=r"(status) :: "memory");
+    return status & 8;
+}
+
+static inline void hal_irq_restore(unsigned int state) {
+    if (state) asm volatile ("csrsi mstatus, 8" ::: "memory");
+}
+
+// Sover tills nästa interrupt. En kärna får göra wfi till en nop, så
+// anroparen ska alltid kontrollera sitt villkor igen efteråt.
+static inline void hal_wait_for_interrupt(void) {
+    asm volatile ("wfi");
+}
+
+// Monoton tidbas för mätningar: klockcykler (mcycle) på kortet.
+// Halvorna läses om ifall den övre ändrades mellan läsningarna.
+static inline unsigned long long hal_cycles(void) {
+    unsigned int hi, lo, hi2;
+    do {
+        asm volatile ("csrr %0, mcycleh" : "=r"(hi));
+        asm volatile ("csrr %0, mcycle" : "=r"(lo));
+        asm volatile ("csrr %0, mcycleh" : "=r"(hi2));
+    } while (hi != hi2);
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+// RAM som inget annat använder: från stackens topp till slutet av RAM
+// (dtekv-script.lds). Ligger inte i main.bin och nollställs inte vid start.
+extern unsigned char _stack_end[], _ram_end[];
+static inline unsigned char* hal_spare_ram(unsigned int* size) {
+    *size = (unsigned int)(_ram_end - _stack_end);
+    return _stack_end;
+}
+
+#else
+
+unsigned int hal_read_switches(void);
+unsigned int hal_read_buttons(void);
+void hal_write_leds(unsigned int mask);
+void hal_write_display(int n, unsigned int segments);
+void hal_uart_putc(unsigned char c);
+unsigned int hal_uart_tx_space(void);  // hal_uart_putc() väntar själv på värden
+int hal_uart_getc(void);
+void hal_timer_start(unsigned int period);
+int hal_timer_ack(void);
+void hal_irq_enable(void);
+unsigned int hal_irq_save(void);
+void hal_irq_restore(unsigned int state);
+void hal_wait_for_interrupt(void);   // återvänder direkt på värden
+unsigned long long hal_cycles(void); // nanosekunder på värden
+unsigned char* hal_spare_ram(unsigned int* size); // en statisk buffert på värden
+
+// Styrs av värdprogrammet i stället för av kortets switchar och knappar
+void hal_host_set_switches(unsigned int sw);
+void hal_host_set_buttons(unsigned int btn);
+unsigned int hal_host_leds(void);
+unsigned int hal_host_display(int n);
+
+// 1 = släng allt som skrivs till UART (t.ex. under benchmark)
+void hal_host_set_quiet(int quiet);
+
+// JTAG UART via fd i stället för stdin/stdout, t.ex. en pseudoterminal
+// (host/boardsim.c). fd ska vara icke-blockerande.
+void hal_host_set_uart_fd(int fd);
+
+#endif
+
+#endif
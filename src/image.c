@@ -0,0 +1,122 @@
+// image.c
+// Bildbeskrivningar med stride och konvolution av ett delområde (ROI).
+#include "image.h"
+#include "profile.h"
+#include <stddef.h>
+
+void image_init(image_t* img, unsigned char* data, int width, int height, int stride) {
+    img->width = width;
+    img->height = height;
+    img->stride = stride;
+    img->data = data;
+}
+
+int image_view(const image_t* img, const rect_t* r, image_t* view) {
+    if (r->x < 0 || r->y < 0 || r->w <= 0 || r->h <= 0 ||
+        r->x + r->w > img->width || r->y + r->h > img->height) {
+        return 0;
+    }
+    image_init(view, img->data + r->y * img->stride + r->x, r->w, r->h, img->stride);
+    return 1;
+}
+
+int rect_empty(const rect_t* r) {
+    return r->w <= 0 || r->h <= 0;
+}
+
+void rect_union(rect_t* acc, const rect_t* r) {
+    if (rect_empty(r)) return;
+    if (rect_empty(acc)) {
+        *acc = *r;
+        return;
+    }
+    int x0 = acc->x < r->x ? acc->x : r->x;
+    int y0 = acc->y < r->y ? acc->y : r->y;
+    int x1 = acc->x + acc->w > r->x + r->w ? acc->x + acc->w : r->x + r->w;
+    int y1 = acc->y + acc->h > r->y + r->h ? acc->y + acc->h : r->y + r->h;
+    acc->x = x0;
+    acc->y = y0;
+    acc->w = x1 - x0;
+    acc->h = y1 - y0;
+}
+
+int rect_clip(rect_t* r, int width, int height) {
+    int x0 = r->x < 0 ? 0 : r->x;
+    int y0 = r->y < 0 ? 0 : r->y;
+    int x1 = r->x + r->w > width ? width : r->x + r->w;
+    int y1 = r->y + r->h > height ? height : r->y + r->h;
+    r->x = x0;
+    r->y = y0;
+    r->w = x1 - x0;
+    r->h = y1 - y0;
+    return !rect_empty(r);
+}
+
+void rect_affected(rect_t* r, int apron, int width, int height, border_mode_t border) {
+    if (rect_empty(r)) return;
+    r->x -= apron;
+    r->y -= apron;
+    r->w += 2 * apron;
+    r->h += 2 * apron;
+    if (border == BORDER_WRAP) {
+        if (r->x < 0 || r->x + r->w > width) {
+            r->x = 0;
+            r->w = width;
+        }
+        if (r->y < 0 || r->y + r->h > height) {
+            r->y = 0;
+            r->h = height;
+        }
+    }
+    rect_clip(r, width, height);
+}
+
+// Reservväg per pixel för kernels eller bredder som motorn inte klarar
+static void convolve_image_generic(const image_t* src, image_t* dst, const conv_kernel_t* k, const rect_t* r, border_mode_t border) {
+    int kcenter = k->ksize / 2;
+    for (int y = r->y; y < r->y + r->h; y++) {
+        unsigned char* out = dst->data + y * dst->stride;
+        for (int x = r->x; x < r->x + r->w; x++) {
+            int acc = 0;
+            for (int ky = 0; ky < k->ksize; ky++) {
+                int iy = conv_border_index(y + ky - kcenter, src->height, border);
+                if (iy < 0) continue;
+                const unsigned char* row = src->data + iy * src->stride;
+                for (int kx = 0; kx < k->ksize; kx++) {
+                    int ix = conv_border_index(x + kx - kcenter, src->width, border);
+                    if (ix >= 0) {
+                        acc += row[ix] * k->table[ky * k->ksize + kx];
+                    }
+                }
+            }
+            acc = acc / k->divisor + k->offset;
+            if (acc < 0) acc = 0;
+            if (acc > 255) acc = 255;
+            out[x] = (unsigned char)acc;
+        }
+    }
+}
+
+void convolve_image(const image_t* src, image_t* dst, const conv_kernel_t* k, const rect_t* roi, const conv_options_t* opts) {
+    border_mode_t border = opts ? opts->border : BORDER_ZERO;
+    rect_t r = { 0, 0, src->width, src->height };
+    if (roi) r = *roi;
+    if (src->width != dst->width || src->height != dst->height) return;
+    if (!rect_clip(&r, src->width, src->height)) return;
+
+    PROF_BEGIN(PROF_CONVOLVE);
+    if (k->ksize > KERNEL_MAX_SIZE || src->width > CONV_MAX_WIDTH) {
+        convolve_image_generic(src, dst, k, &r, border);
+    } else {
+        int kcenter = k->ksize / 2;
+        const unsigned char* rows[KERNEL_MAX_SIZE];
+        for (int y = r.y; y < r.y + r.h; y++) {
+            for (int ky = 0; ky < k->ksize; ky++) {
+                int sy = conv_border_index(y + ky - kcenter, src->height, border);
+                rows[ky] = sy < 0 ? conv_zero_row : src->data + sy * src->stride;
+            }
+            convolve_row_span(rows, dst->data + y * dst->stride + r.x, src->width, r.x, r.x + r.w, k, border);
+        }
+    }
+    PROF_END(PROF_CONVOLVE);
+}
@@ -0,0 +1,48 @@
+// image.h
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "kernels.h"
+
+// Gråskalebild i minnet. Rad y börjar på data + y * stride, stride >= width.
+typedef struct {
+    int width;
+    int height;
+    int stride;
+    unsigned char* data;
+} image_t;
+
+// Rektangel [x, x+w) x [y, y+h). Tom om w <= 0 eller h <= 0.
+typedef struct {
+    int x;
+    int y;
+    int w;
+    int h;
+} rect_t;
+
+void image_init(image_t* img, unsigned char* data, int width, int height, int stride);
+
+// Delbild r ur img (samma minne, samma stride). 0 om r hamnar utanför.
+int image_view(const image_t* img, const rect_t* r, image_t* view);
+
+int rect_empty(const rect_t* r);
+
+// acc = minsta rektangel som täcker både acc och r
+void rect_union(rect_t* acc, const rect_t* r);
+
+// Klipper r till [0, width) x [0, height); 0 om inget blir kvar
+int rect_clip(rect_t* r, int width, int height);
+
+// Utpixlar som påverkas när indata i r ändras: r utvidgad med apron åt
+// alla håll och klippt till bilden. Vid BORDER_WRAP som når kanten blir
+// det hela bredden eller höjden, eftersom pixlarna syns på andra sidan.
+void rect_affected(rect_t* r, int apron, int width, int height, border_mode_t border);
+
+/*
+ * Konvolution av rektangeln roi i dst (NULL = hela bilden). Kanten räknas
+ * mot hela src, så resultatet i roi blir exakt detsamma som för en hel
+ * bild. src och dst måste ha samma storlek men får ha olika stride.
+ */
+void convolve_image(const image_t* src, image_t* dst, const conv_kernel_t* k, const rect_t* roi, const conv_options_t* opts);
+
+#endif
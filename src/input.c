@@ -0,0 +1,110 @@
+// input.c
+// Avstudsning och händelsekö för switchar och knappar.
+//
+// input_sample() körs i timer-interrupten och är ensam om att skriva
+// queue_head; huvudloopen är ensam om queue_tail. Med en producent och en
+// konsument behövs inga lås, bara att indexen är volatile och att
+// händelsen skrivs innan head flyttas fram.
+#include "input.h"
+#include "hal.h"
+
+// Switchar i bit 0-9, BTN[0] i bit 10
+#define INPUT_BTN_BIT (1u << 10)
+#define INPUT_SW_MASK 0x3FFu
+
+static input_event_t queue[INPUT_QUEUE_SIZE];
+static volatile unsigned int queue_head;
+static volatile unsigned int queue_tail;
+static volatile unsigned int dropped;
+
+static volatile unsigned int tick;
+static unsigned int last_raw;     // Senast lästa råvärde
+static unsigned int stable_ticks; // Hur länge last_raw har varit oförändrat
+static volatile unsigned int stable; // Avstudsat läge
+
+static unsigned int read_raw(void) {
+    return (hal_read_switches() & INPUT_SW_MASK) | ((hal_read_buttons() & 1) ? INPUT_BTN_BIT : 0);
+}
+
+static void push(input_event_type_t type, unsigned int value) {
+    unsigned int head = queue_head;
+    if (head - queue_tail == INPUT_QUEUE_SIZE) {
+        dropped++;
+        return;
+    }
+    input_event_t* ev = &queue[head & (INPUT_QUEUE_SIZE - 1)];
+    ev->type = type;
+    ev->value = value;
+    ev->tick = tick;
+    // Händelsen måste ligga i minnet innan konsumenten ser nya head
+    asm volatile ("" ::: "memory");
+    queue_head = head + 1;
+}
+
+void input_init(void) {
+    last_raw = read_raw();
+    stable = last_raw;
+    stable_ticks = 0;
+    queue_head = queue_tail = 0;
+}
+
+/*
+ * Funktion: input_sample
+ * ----------------------
+ * Ett nytt läge godtas när samma råvärde lästs INPUT_DEBOUNCE_TICKS tick i
+ * följd. Då jämförs det med det förra stabila läget: ändrade switchar ger
+ * en INPUT_SWITCHES, ändrad knapp en INPUT_BTN_PRESS eller _RELEASE.
+ * Switcharna köas före knappen, så en handling ser alltid läget den
+ * trycktes i.
+ */
+void input_sample(void) {
+    unsigned int raw = read_raw();
+    tick++;
+
+    if (raw != last_raw) {
+        last_raw = raw;
+        stable_ticks = 0;
+        return;
+    }
+    if (stable_ticks < INPUT_DEBOUNCE_TICKS) stable_ticks++;
+    if (stable_ticks < INPUT_DEBOUNCE_TICKS || raw == stable) return;
+
+    unsigned int changed = raw ^ stable;
+    stable = raw;
+    unsigned int sw = raw & INPUT_SW_MASK;
+    if (changed & INPUT_SW_MASK) push(INPUT_SWITCHES, sw);
+    if (changed & INPUT_BTN_BIT) push((raw & INPUT_BTN_BIT) ? INPUT_BTN_PRESS : INPUT_BTN_RELEASE, sw);
+}
+
+int input_poll(input_event_t* ev) {
+    unsigned int tail = queue_tail;
+    if (tail == queue_head) return 0;
+    *ev = queue[tail & (INPUT_QUEUE_SIZE - 1)];
+    asm volatile ("" ::: "memory");
+    queue_tail = tail + 1;
+    return 1;
+}
+
+int input_pending(void) {
+    return queue_tail != queue_head;
+}
+
+// Ett tick som kommer mellan kontrollen och wfi väcker inte, men nästa
+// gör det; väntan blir då som mest ett tick längre.
+void input_wait(input_event_t* ev) {
+    while (!input_poll(ev)) {
+        hal_wait_for_interrupt();
+    }
+}
+
+unsigned int input_switches(void) {
+    return stable & INPUT_SW_MASK;
+}
+
+unsigned int input_ticks(void) {
+    return tick;
+}
+
+unsigned int input_dropped(void) {
+    return dropped;
+}
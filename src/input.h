@@ -0,0 +1,55 @@
+// input.h
+#ifndef INPUT_H
+#define INPUT_H
+
+// Händelsestyrd inmatning. Timer-interrupten läser switchar och knappar
+// INPUT_TICK_HZ gånger per sekund och lägger avstudsade ändringar i en kö;
+// huvudloopen sover tills det finns något i den.
+#define INPUT_CLOCK_HZ 30000000
+#define INPUT_TICK_HZ 1000
+#define INPUT_TICK_CYCLES (INPUT_CLOCK_HZ / INPUT_TICK_HZ)
+
+// Ett nytt läge räknas först när det varit stabilt så här många tick.
+// En knapptryckning syns alltså efter 8-9 ms, oavsett vad loopen gör.
+#define INPUT_DEBOUNCE_TICKS 8
+
+// Köns storlek, en tvåpotens
+#define INPUT_QUEUE_SIZE 16
+
+typedef enum {
+    INPUT_BTN_PRESS,    // BTN[0] trycktes ned
+    INPUT_BTN_RELEASE,  // BTN[0] släpptes
+    INPUT_SWITCHES      // Switcharna ändrades, value = nya läget
+} input_event_type_t;
+
+typedef struct {
+    input_event_type_t type;
+    unsigned int value;  // Switchläget efter händelsen
+    unsigned int tick;   // Tick då ändringen blev stabil
+} input_event_t;
+
+// Tar nuvarande läge som utgångsläge, utan händelser
+void input_init(void);
+
+// Ett tick: läs, avstudsa och köa. Anropas från timer-interrupten.
+void input_sample(void);
+
+// Tar nästa händelse ur kön. Returnerar 0 om kön är tom.
+int input_poll(input_event_t* ev);
+
+// 1 om det finns en händelse i kön (läser bara minne, ingen MMIO)
+int input_pending(void);
+
+// Som input_poll(), men sover med wfi tills en händelse finns
+void input_wait(input_event_t* ev);
+
+// Senaste avstudsade switchläge
+unsigned int input_switches(void);
+
+// Antal tick sedan start, för tidmätning i hela millisekunder
+unsigned int input_ticks(void);
+
+// Antal händelser som slängts för att kön var full
+unsigned int input_dropped(void);
+
+#endif
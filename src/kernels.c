@@ -3,7 +3,10 @@
 // kernels.c
 #include "dtekv-lib.h"
 #include "kernels.h"
+#include "kernels_plan.h"
 #include "menu.h"
+#include "profile.h"
+#include "log.h"
 #include <stddef.h>
 
 // (3x3) och (5x5) områden
@@ -88,47 +91,56 @@ const int sharpen_5x5[5][5] = {
     {  0,  0, -1,  0,  0 }
 };
 
-const int* get_selected_kernel(const menu_state_t* menu, int* divisor) {
+static const conv_kernel_t* select_kernel(const menu_state_t* menu);
+
+const conv_kernel_t* get_selected_kernel(const menu_state_t* menu) {
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
     // 🔍 Debugutskrift för att se vilket kernel som valts via switchar
     print("Kernel select: ");
     print_dec(menu->kernel_selected);
     print("  size=");
     print_dec(menu->kernel_size);
     print("\n");
-    
+#endif
+
+    PROF_BEGIN(PROF_SELECT_KERNEL);
+    const conv_kernel_t* k = select_kernel(menu);
+    PROF_END(PROF_SELECT_KERNEL);
+    return k;
+}
+
+static const conv_kernel_t* select_kernel(const menu_state_t* menu) {
+    // En laddad egen kernel går före switcharna för typ och storlek
+    if (menu->custom && kernel_custom(menu->custom)) {
+        return kernel_custom(menu->custom);
+    }
+
+    // Divisorerna står i kernels_spec.c (1 för edge och sharpen,
+    // 9/25 för box blur, 16/256 för gaussian)
     if (menu->kernel_size == KERNEL_SIZE_3) {
         switch (menu->kernel_selected) {
             case KERNEL_EDGE:
-                *divisor = 1; // Edge detection behöver ingen normalisering
-                return (const int*)edge_3x3;
+                return &conv_edge_3x3;
             case KERNEL_BOXBLUR:
-                *divisor = 9; // Box blur 3x3
-                return (const int*)boxblur_3x3;
+                return &conv_boxblur_3x3;
             case KERNEL_GAUSSIAN:
-                *divisor = 16; // Gaussian blur 3x3
-                return (const int*)gaussian_3x3;
+                return &conv_gaussian_3x3;
             case KERNEL_SHARPEN:
-                *divisor = 1; // Sharpen behöver ingen normalisering
-                return (const int*)sharpen_3x3;
+                return &conv_sharpen_3x3;
         }
     } else if (menu->kernel_size == KERNEL_SIZE_5) {
         switch (menu->kernel_selected) {
             case KERNEL_EDGE:
-                *divisor = 1; // Edge detection behöver ingen normalisering
-                return (const int*)edge_5x5;
+                return &conv_edge_5x5;
             case KERNEL_BOXBLUR:
-                *divisor = 25; // Box blur 5x5
-                return (const int*)boxblur_5x5;
+                return &conv_boxblur_5x5;
             case KERNEL_GAUSSIAN:
-                *divisor = 256; // Gaussian blur 5x5
-                return (const int*)gaussian_5x5;
+                return &conv_gaussian_5x5;
             case KERNEL_SHARPEN:
-                *divisor = 1; // Sharpen behöver ingen normalisering
-                return (const int*)sharpen_5x5;
+                return &conv_sharpen_5x5;
         }
     }
     // Fallback, bör inte nås
-    *divisor = 1;
     return NULL;
 }
 /*
@@ -145,19 +157,196 @@ const int* get_selected_kernel(const menu_state_t* menu, int* divisor) {
  *
  * För varje pixel summeras produkten av kernel och motsvarande bildområde.
  * Resultatet normaliseras och klipps till [0,255].
+ * Pixlar utanför bilden räknas som 0, se convolve_ex() för andra kantlägen.
  */
 void convolve(const unsigned char* input, unsigned char* output, int width, int height, const int* kernel, int ksize, int divisor, int offset) {
-     print("Convolve started\n");
+    convolve_ex(input, output, width, height, kernel, ksize, divisor, offset, NULL);
+}
+
+/*
+ * Funktion: conv_border_index
+ * ---------------------------
+ * Översätter index i (rad eller kolumn) till ett index innanför [0, n)
+ * enligt kantläget. Returnerar -1 om pixeln ska räknas som 0 (BORDER_ZERO).
+ * Spegling sker kring kantpixeln utan att upprepa den: -1 -> 1, n -> n-2.
+ */
+int conv_border_index(int i, int n, border_mode_t border) {
+    if (i >= 0 && i < n) return i;
+
+    switch (border) {
+        case BORDER_CLAMP:
+            return i < 0 ? 0 : n - 1;
+        case BORDER_MIRROR:
+            if (n == 1) return 0;
+            // Loopa ifall kerneln är större än bilden
+            while (i < 0 || i >= n) {
+                if (i < 0) i = -i;
+                if (i >= n) i = 2 * (n - 1) - i;
+            }
+            return i;
+        case BORDER_WRAP:
+            i %= n;
+            return i < 0 ? i + n : i;
+        default:
+            return -1;
+    }
+}
+
+// Halo: korta utfyllda radbitar för kantkolumnerna, byggda enligt kantläget.
+// Allt kantberoende sker när halon fylls, så konvolutionsloopen själv
+// behöver aldrig kontrollera bildens gränser. Bilder smalare än 2*kcenter
+// fylls ut i sin helhet (högst 4*kcenter pixlar).
+static CONV_SCRATCH unsigned char halo_buf[KERNEL_MAX_SIZE][4 * KERNEL_MAX_SIZE];
+
+// Rad av nollor, används som källrad ovanför/under bilden vid BORDER_ZERO.
+// Ordjusterad så att SWAR-rutinerna kan läsa den ordvis.
+const unsigned char conv_zero_row[CONV_MAX_WIDTH] __attribute__((aligned(4))) = { 0 };
+
+// Fyller dst[0..n) med pixlarna xs..xs+n-1 ur raden src, även utanför raden.
+static void halo_fill(unsigned char* dst, const unsigned char* src, int width, int xs, int n, border_mode_t border) {
+    int j = 0;
+    for (; j < n && xs + j < 0; j++) {
+        int sx = conv_border_index(xs + j, width, border);
+        dst[j] = sx < 0 ? 0 : src[sx];
+    }
+    for (; j < n && xs + j < width; j++) {
+        dst[j] = src[xs + j];
+    }
+    for (; j < n; j++) {
+        int sx = conv_border_index(xs + j, width, border);
+        dst[j] = sx < 0 ? 0 : src[sx];
+    }
+}
+
+/*
+ * Räknar ut n utpixlar i följd. rows[ky][i + kx] är indatapixeln under
+ * kernelelement (ky, kx) för utpixel i, dvs rows pekar kcenter kolumner
+ * till vänster om första utpixeln. Inga gränskontroller.
+ */
+static void conv_span(const unsigned char* const* rows, unsigned char* out, int n, const int* kernel, int ksize, int divisor, int offset) {
+    for (int i = 0; i < n; i++) {
+        const int* k = kernel;
+        int acc = 0;
+        for (int ky = 0; ky < ksize; ky++) {
+            const unsigned char* r = rows[ky] + i;
+            for (int kx = 0; kx < ksize; kx++) {
+                acc += r[kx] * *k++;
+            }
+        }
+        acc = acc / divisor + offset;
+        if (acc < 0) acc = 0;
+        if (acc > 255) acc = 255;
+        out[i] = (unsigned char)acc;
+    }
+}
+
+// Kör kernelns plan eller specialiserade rutin om den har en, annars den
+// generiska
+static void run_span(const conv_kernel_t* k, const unsigned char* const* rows, unsigned char* out, int n) {
+    if (k->plan) {
+        kernel_plan_run(k->plan, rows, out, n);
+    } else if (k->span) {
+        k->span(rows, out, n);
+    } else {
+        conv_span(rows, out, n, k->table, k->ksize, k->divisor, k->offset);
+    }
+}
+
+/*
+ * Funktion: convolve_row_span
+ * ---------------------------
+ * Räknar ut kolumnerna x0..x1-1 av en utrad från ksize källrader (src[ky] =
+ * raden under kernelrad ky, hela raden med width pixlar). out pekar på
+ * utkolumn x0. Vertikala kanten löser anroparen genom att välja källrader,
+ * se conv_source_row(). Spannet delas i inre område, som läser direkt ur
+ * källraderna, och de delar som ligger inom kcenter kolumner från kanten,
+ * som räknas på halo-rader. Ingen pixel behöver gränskontroll per
+ * kernelelement. Kräver ksize <= KERNEL_MAX_SIZE och 0 <= x0 <= x1 <= width.
+ */
+void convolve_row_span(const unsigned char* const* src, unsigned char* out, int width, int x0, int x1, const conv_kernel_t* k, border_mode_t border) {
+    int ksize = k->ksize;
+    int kcenter = ksize / 2;
+    const unsigned char* rows[KERNEL_MAX_SIZE];
+
+    for (int ky = 0; ky < KERNEL_MAX_SIZE; ky++) {
+        rows[ky] = halo_buf[ky];
+    }
+
+    if (width <= 2 * kcenter) {
+        // Smal bild: hela spannet från halon
+        for (int ky = 0; ky < ksize; ky++) {
+            halo_fill(halo_buf[ky], src[ky], width, x0 - kcenter, x1 - x0 + 2 * kcenter, border);
+        }
+        run_span(k, rows, out, x1 - x0);
+        return;
+    }
+
+    // Vänster kant: utkolumnerna x0 .. kcenter-1
+    int left = x1 < kcenter ? x1 : kcenter;
+    if (x0 < left) {
+        for (int ky = 0; ky < ksize; ky++) {
+            halo_fill(halo_buf[ky], src[ky], width, x0 - kcenter, left - x0 + 2 * kcenter, border);
+        }
+        run_span(k, rows, out, left - x0);
+    }
+
+    // Höger kant: utkolumnerna width-kcenter .. x1-1
+    int right = x0 > width - kcenter ? x0 : width - kcenter;
+    if (right < x1) {
+        for (int ky = 0; ky < ksize; ky++) {
+            halo_fill(halo_buf[ky], src[ky], width, right - kcenter, x1 - right + 2 * kcenter, border);
+        }
+        run_span(k, rows, out + right - x0, x1 - right);
+    }
+
+    // Inre område direkt ur källraderna
+    int a = x0 > kcenter ? x0 : kcenter;
+    int b = x1 < width - kcenter ? x1 : width - kcenter;
+    if (a < b) {
+        for (int ky = 0; ky < ksize; ky++) {
+            rows[ky] = src[ky] + a - kcenter;
+        }
+        run_span(k, rows, out + a - x0, b - a);
+    }
+}
+
+// En hel utrad, se convolve_row_span()
+void convolve_row(const unsigned char* const* src, unsigned char* out, int width, const conv_kernel_t* k, border_mode_t border) {
+    convolve_row_span(src, out, width, 0, width, k, border);
+}
+
+// Källrad iy i en bild med height rader, enligt kantläget.
+// Rader som ska räknas som 0 ger en nollrad (högst CONV_MAX_WIDTH bred).
+const unsigned char* conv_source_row(const unsigned char* input, int width, int height, int iy, border_mode_t border) {
+    int sy = conv_border_index(iy, height, border);
+    return sy < 0 ? conv_zero_row : input + sy * width;
+}
+
+// Tät konvolution av en hel bild, rad för rad.
+static void convolve_dense(const unsigned char* input, unsigned char* output, int width, int height, const conv_kernel_t* k, border_mode_t border) {
+    int kcenter = k->ksize / 2;
+    const unsigned char* src[KERNEL_MAX_SIZE];
+
+    for (int y = 0; y < height; y++) {
+        for (int ky = 0; ky < k->ksize; ky++) {
+            src[ky] = conv_source_row(input, width, height, y + ky - kcenter, border);
+        }
+        convolve_row(src, output + y * width, width, k, border);
+    }
+}
+
+// Reservväg för kernels eller bilder som inte ryms i halo-buffertarna.
+static void convolve_generic(const unsigned char* input, unsigned char* output, int width, int height, const int* kernel, int ksize, int divisor, int offset, border_mode_t border) {
     int kcenter = ksize / 2;
     for (int y = 0; y < height; y++) {
         for (int x = 0; x < width; x++) {
             int acc = 0;
             for (int ky = 0; ky < ksize; ky++) {
+                int iy = conv_border_index(y + ky - kcenter, height, border);
+                if (iy < 0) continue;
                 for (int kx = 0; kx < ksize; kx++) {
-                    int ix = x + kx - kcenter;
-                    int iy = y + ky - kcenter;
-                    // Kontrollera att vi är inom bildens gränser
-                    if (ix >= 0 && ix < width && iy >= 0 && iy < height) {
+                    int ix = conv_border_index(x + kx - kcenter, width, border);
+                    if (ix >= 0) {
                         acc += input[iy * width + ix] * kernel[ky * ksize + kx];
                     }
                 }
@@ -168,5 +357,168 @@ void convolve(const unsigned char* input, unsigned char* output, int width, int
             output[y * width + x] = (unsigned char)acc;
         }
     }
-    print("Convolve done\n");
-}
\ No newline at end of file
+}
+
+/*
+ * Funktion: convolve_ex
+ * ---------------------
+ * Som convolve(), men med inställningar. opts får vara NULL, vilket ger
+ * standardvärdena (BORDER_ZERO, samma resultat som tidigare).
+ */
+void convolve_ex(const unsigned char* input, unsigned char* output, int width, int height, const int* kernel, int ksize, int divisor, int offset, const conv_options_t* opts) {
+    LOG_DEBUG("Convolve started\n");
+    border_mode_t border = opts ? opts->border : BORDER_ZERO;
+    PROF_BEGIN(PROF_CONVOLVE);
+
+    if (ksize > KERNEL_MAX_SIZE || width > CONV_MAX_WIDTH) {
+        convolve_generic(input, output, width, height, kernel, ksize, divisor, offset, border);
+        PROF_END(PROF_CONVOLVE);
+        LOG_DEBUG("Convolve done\n");
+        return;
+    }
+
+    // Box- och gausskernlarna är separerbara, kör dem som två 1-D-pass
+    int col[KERNEL_MAX_SIZE], row[KERNEL_MAX_SIZE];
+    if (kernel_factorize(kernel, ksize, col, row)) {
+        convolve_separable(input, output, width, height, col, row, ksize, divisor, offset, border);
+    } else {
+        conv_kernel_t k = { kernel, ksize, divisor, offset, NULL, NULL };
+        convolve_dense(input, output, width, height, &k, border);
+    }
+    PROF_END(PROF_CONVOLVE);
+    LOG_DEBUG("Convolve done\n");
+}
+
+/*
+ * Funktion: convolve_kernel
+ * -------------------------
+ * Som convolve_ex(), men med en kernelbeskrivning från get_selected_kernel().
+ * De inbyggda kernlarna har specialiserade rutiner (kernels_spec.c) och
+ * egna kernels en kompilerad plan (kernels_plan.c); båda körs via samma
+ * halo-motor, så kantlägena fungerar som vanligt.
+ */
+void convolve_kernel(const unsigned char* input, unsigned char* output, int width, int height, const conv_kernel_t* k, const conv_options_t* opts) {
+    if ((!k->span && !k->plan) || k->ksize > KERNEL_MAX_SIZE || width > CONV_MAX_WIDTH) {
+        convolve_ex(input, output, width, height, k->table, k->ksize, k->divisor, k->offset, opts);
+        return;
+    }
+
+    LOG_DEBUG("Convolve started\n");
+    PROF_BEGIN(PROF_CONVOLVE);
+    convolve_dense(input, output, width, height, k, opts ? opts->border : BORDER_ZERO);
+    PROF_END(PROF_CONVOLVE);
+    LOG_DEBUG("Convolve done\n");
+}
+
+static int gcd(int a, int b) {
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/*
+ * Funktion: kernel_factorize
+ * --------------------------
+ * Försöker skriva kerneln som en yttre produkt col x row av två heltalsvektorer.
+ * Radvektorn tas från första raden med ett nollskilt element, delad med
+ * radens gcd. Kolumnvektorn fås genom att dividera pivotkolumnen med radens
+ * pivotelement. Till sist kontrolleras att alla element stämmer.
+ *
+ * Exempel: gaussian_5x5 = [1 4 6 4 1]^T x [1 4 6 4 1]
+ */
+int kernel_factorize(const int* kernel, int ksize, int* col, int* row) {
+    int py = -1, px = -1;
+    for (int i = 0; i < ksize * ksize; i++) {
+        if (kernel[i] != 0) {
+            py = i / ksize;
+            px = i % ksize;
+            break;
+        }
+    }
+    if (py < 0) return 0; // Nollkernel, inget att vinna
+
+    const int* prow = kernel + py * ksize;
+    int g = 0;
+    for (int x = 0; x < ksize; x++) {
+        g = gcd(g, prow[x] < 0 ? -prow[x] : prow[x]);
+    }
+    if (prow[px] < 0) g = -g; // Håll pivotelementet i radvektorn positivt
+
+    for (int x = 0; x < ksize; x++) {
+        row[x] = prow[x] / g;
+    }
+    for (int y = 0; y < ksize; y++) {
+        col[y] = kernel[y * ksize + px] / row[px];
+    }
+
+    for (int y = 0; y < ksize; y++) {
+        for (int x = 0; x < ksize; x++) {
+            if (kernel[y * ksize + x] != col[y] * row[x]) return 0;
+        }
+    }
+    return 1;
+}
+
+// Radbuffert för det vertikala passet, med kcenter utfyllnadskolumner på båda
+// sidor så att det horisontella passet slipper gränskontroller.
+static CONV_SCRATCH int sep_buf[CONV_MAX_WIDTH + 2 * KERNEL_MAX_SIZE];
+
+/*
+ * Funktion: convolve_separable
+ * ----------------------------
+ * Samma sak som convolve_ex(), men för kernels som är en yttre produkt col x row.
+ * För varje utrad summeras först ksize inrader vertikalt med vikterna i col,
+ * sedan filtreras summan horisontellt med row. Radbufferten fylls ut enligt
+ * kantläget innan det horisontella passet. Division görs bara en gång per
+ * pixel, i slutet.
+ *
+ * Eftersom allt är heltal och alla kantlägen verkar var för sig på rader och
+ * kolumner blir resultatet bit-identiskt med den täta konvolutionen, men 5x5
+ * kostar 10 multiplikationer i stället för 25.
+ * Kräver ksize <= KERNEL_MAX_SIZE och width <= CONV_MAX_WIDTH.
+ */
+void convolve_separable(const unsigned char* input, unsigned char* output, int width, int height, const int* col, const int* row, int ksize, int divisor, int offset, border_mode_t border) {
+    int kcenter = ksize / 2;
+    int* vsum = sep_buf + kcenter;
+
+    for (int y = 0; y < height; y++) {
+        // Vertikalt pass, rader utanför bilden enligt kantläget
+        for (int x = 0; x < width; x++) {
+            vsum[x] = 0;
+        }
+        for (int ky = 0; ky < ksize; ky++) {
+            int sy = conv_border_index(y + ky - kcenter, height, border);
+            if (sy < 0) continue;
+            const unsigned char* in = input + sy * width;
+            int w = col[ky];
+            for (int x = 0; x < width; x++) {
+                vsum[x] += in[x] * w;
+            }
+        }
+
+        // Fyll ut radbufferten, kolumnsummorna följer samma kantläge
+        for (int i = 1; i <= kcenter; i++) {
+            int l = conv_border_index(-i, width, border);
+            int r = conv_border_index(width - 1 + i, width, border);
+            vsum[-i] = l < 0 ? 0 : vsum[l];
+            vsum[width - 1 + i] = r < 0 ? 0 : vsum[r];
+        }
+
+        // Horisontellt pass över den vidgade radbufferten
+        unsigned char* out = output + y * width;
+        for (int x = 0; x < width; x++) {
+            const int* v = vsum + x - kcenter;
+            int acc = 0;
+            for (int kx = 0; kx < ksize; kx++) {
+                acc += v[kx] * row[kx];
+            }
+            acc = acc / divisor + offset;
+            if (acc < 0) acc = 0;
+            if (acc > 255) acc = 255;
+            out[x] = (unsigned char)acc;
+        }
+    }
+}
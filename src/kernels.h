@@ -3,9 +3,33 @@
 #ifndef KERNELS_H
 #define KERNELS_H
 
+#include "main.h"
+
 #define KERNEL_SIZE_3 3
 #define KERNEL_SIZE_5 5
 
+// Största kernel som de snabba vägarna hanterar (egna kernels, se
+// kernels_plan.h, eller sammansatta kedjor), och största bildbredd som ryms
+// i deras radbuffertar. Större bilder går via den generiska loopen.
+// Alla radbuffertar (även box-, Gauss-, rang-, kedje- och packade vägarna)
+// dimensioneras efter CONV_MAX_WIDTH. På kortet är bilderna IMG_WIDTH
+// breda, och main.bin innehåller även .bss, som ligger före .rodata i
+// dtekv-script.lds; större buffertar där gör bara uppladdningen längre.
+#define KERNEL_MAX_SIZE 15
+#ifdef HOST
+#define CONV_MAX_WIDTH 4096
+#else
+#define CONV_MAX_WIDTH IMG_WIDTH
+#endif
+
+// Motorns statiska arbetsbuffertar. På värden får varje tråd egna (se
+// parallel.c); på kortet finns bara en tråd och de är vanliga statiska.
+#ifdef HOST
+#define CONV_SCRATCH __thread
+#else
+#define CONV_SCRATCH
+#endif
+
 typedef enum {
     KERNEL_EDGE,
     KERNEL_BOXBLUR,
@@ -13,6 +37,37 @@ typedef enum {
     KERNEL_SHARPEN
 } kernel_type_t;
 
+// Hur pixlar utanför bilden behandlas vid konvolution
+typedef enum {
+    BORDER_ZERO,   // Pixlar utanför bilden är 0 (standard)
+    BORDER_CLAMP,  // Närmaste kantpixel upprepas
+    BORDER_MIRROR, // Spegling kring kantpixeln: -1 -> 1, width -> width-2
+    BORDER_WRAP    // Fortsätter från motsatt kant
+} border_mode_t;
+
+// Inställningar för convolve_ex
+typedef struct {
+    border_mode_t border;
+    int allow_fusion;   // 1 = kedjor av blur-filter får slås ihop till en kernel
+} conv_options_t;
+
+// Rutin som räknar n utpixlar i följd. rows[ky][i + kx] är indatapixeln
+// under kernelelement (ky, kx) för utpixel i.
+typedef void (*conv_span_fn)(const unsigned char* const* rows, unsigned char* out, int n);
+
+// Kompilerad plan för en kernel som laddats under körning (kernels_plan.h)
+typedef struct kernel_plan_t kernel_plan_t;
+
+// En kernel med normalisering och (om den finns) en specialiserad rutin
+typedef struct conv_kernel_t {
+    const int* table;   // Kernelmatrisen, flattenad (ksize*ksize)
+    int ksize;          // Udda, högst KERNEL_MAX_SIZE (inbyggda: 3 eller 5)
+    int divisor;        // Normaliseringsfaktor
+    int offset;         // Läggs till efter divisionen
+    conv_span_fn span;  // Specialiserad rutin, NULL = generisk loop
+    const kernel_plan_t* plan; // Plan i stället för span, NULL om ingen
+} conv_kernel_t;
+
 // Forward declaration av menu_state_t
 typedef struct menu_state_t menu_state_t;   // OBS: "struct menu_state_t", ej typedef än
 
@@ -28,10 +83,43 @@ extern const int boxblur_5x5[5][5];
 extern const int gaussian_5x5[5][5];
 extern const int sharpen_5x5[5][5];
 
+// Inbyggda kernels med specialiserade rutiner (kernels_spec.c)
+extern const conv_kernel_t conv_edge_3x3, conv_boxblur_3x3, conv_gaussian_3x3, conv_sharpen_3x3;
+extern const conv_kernel_t conv_edge_5x5, conv_boxblur_5x5, conv_gaussian_5x5, conv_sharpen_5x5;
+
 // Funktion för att få valda kernel baserat på typ och storlek
-const int* get_selected_kernel(const menu_state_t* menu, int* divisor);
+const conv_kernel_t* get_selected_kernel(const menu_state_t* menu);
 
 // Convolution function
 void convolve(const unsigned char* input, unsigned char* output, int width, int height, const int* kernel, int ksize, int divisor, int offset);
 
+// Convolution med inställningar (kantläge). opts == NULL ger standardvärdena.
+void convolve_ex(const unsigned char* input, unsigned char* output, int width, int height, const int* kernel, int ksize, int divisor, int offset, const conv_options_t* opts);
+
+// Convolution med en kernelbeskrivning, använder dess specialiserade rutin
+void convolve_kernel(const unsigned char* input, unsigned char* output, int width, int height, const conv_kernel_t* k, const conv_options_t* opts);
+
+// En utrad ur ksize källrader (radvis motor, används av kedjor och strömmar)
+void convolve_row(const unsigned char* const* src, unsigned char* out, int width, const conv_kernel_t* k, border_mode_t border);
+
+// Som convolve_row(), men bara utkolumnerna x0..x1-1; out pekar på kolumn x0
+void convolve_row_span(const unsigned char* const* src, unsigned char* out, int width, int x0, int x1, const conv_kernel_t* k, border_mode_t border);
+
+// Rad av nollor, källrad för rader utanför bilden vid BORDER_ZERO
+extern const unsigned char conv_zero_row[CONV_MAX_WIDTH];
+
+// Källrad iy enligt kantläget; rader utanför bilden vid BORDER_ZERO blir en nollrad
+const unsigned char* conv_source_row(const unsigned char* input, int width, int height, int iy, border_mode_t border);
+
+// Översätter rad-/kolumnindex enligt kantläget, -1 betyder pixelvärde 0
+int conv_border_index(int i, int n, border_mode_t border);
+
+// Delar upp en kernel i kolumn- och radvektor (kernel[y][x] == col[y] * row[x]).
+// Returnerar 1 om kerneln är separerbar (rank 1), annars 0.
+int kernel_factorize(const int* kernel, int ksize, int* col, int* row);
+
+// Separerbar konvolution: vertikalt 1-D-pass följt av horisontellt 1-D-pass.
+// Ger exakt samma resultat som convolve() med kerneln col x row.
+void convolve_separable(const unsigned char* input, unsigned char* output, int width, int height, const int* col, const int* row, int ksize, int divisor, int offset, border_mode_t border);
+
 #endif
\ No newline at end of file
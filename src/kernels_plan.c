@@ -0,0 +1,356 @@
+// kernels_plan.c
+// Kernelkompilatorn: analyserar en kernel en gång och väljer rutin (se
+// kernels_plan.h). Rutinerna följer samma konvention som conv_span i
+// kernels.c, rows[ky][i + kx] är pixeln under element (ky, kx) för utpixel
+// i, så planerna körs av samma halo-motor, kedjor och strömmar som de
+// inbyggda kernlarna.
+#include "dtekv-lib.h"
+#include "kernels_plan.h"
+#include <stddef.h>
+
+// Kolumnsummor för det vertikala passet (n + ksize - 1 element)
+static CONV_SCRATCH int plan_vbuf[CONV_MAX_WIDTH + 2 * KERNEL_MAX_SIZE];
+
+static kernel_plan_t custom[KERNEL_CUSTOM_SLOTS];
+static unsigned int custom_version[KERNEL_CUSTOM_SLOTS];
+static unsigned int version_counter;
+
+// ===========================================================
+// Rutiner
+// ===========================================================
+
+// Summan delad med divisorn som / i C (mot noll), plus offset, klippt
+static inline __attribute__((always_inline)) int plan_normalize(const kernel_plan_t* p, int acc, kernel_plan_norm_t norm) {
+    switch (norm) {
+        case KERNEL_PLAN_NORM_NONE:
+            break;
+        case KERNEL_PLAN_NORM_SHIFT:
+            acc = acc >= 0 ? acc >> p->shift : -(-acc >> p->shift);
+            break;
+        case KERNEL_PLAN_NORM_RECIP: {
+            unsigned int a = acc >= 0 ? (unsigned int)acc : (unsigned int)-acc;
+            int q = (int)((unsigned int)(((unsigned long long)a * p->mul) >> 32) >> p->shift);
+            acc = acc >= 0 ? q : -q;
+            break;
+        }
+        case KERNEL_PLAN_NORM_DIV:
+            acc /= p->divisor;
+            break;
+    }
+    acc += p->kernel.offset;
+    return acc < 0 ? 0 : (acc > 255 ? 255 : acc);
+}
+
+// Utpixlar per block. Looparna nedan går element för element och pixel för
+// pixel inom blocket, så de har fast längd oavsett gruppernas storlek och
+// hoppen i dem är lätta att förutsäga. Ackumulatorerna ryms på stacken.
+#define PLAN_BLOCK 64
+
+/*
+ * acc[0..len) = summan över grupperna av weight * (summan av src[j][x0 + i]
+ * för gruppens element j). Vikten 1 och grupper med ett element adderas
+ * direkt till acc; andra grupper summeras först så att de kostar en enda
+ * multiplikation per pixel. Kräver len <= PLAN_BLOCK.
+ */
+#define PLAN_ACCUMULATE(name, type)                                                                   \
+static inline __attribute__((always_inline)) void name(int* acc, const type* const* src, int x0, const kernel_plan_group_t* group, int groups, int len) { \
+    int sum[PLAN_BLOCK];                                                                              \
+    for (int i = 0; i < len; i++) acc[i] = 0;                                                         \
+    int j = 0;                                                                                        \
+    for (int g = 0; g < groups; g++) {                                                                \
+        int w = group[g].weight;                                                                      \
+        int end = group[g].end;                                                                       \
+        if (w == 1) {                                                                                 \
+            for (; j < end; j++) {                                                                    \
+                const type* s = src[j] + x0;                                                          \
+                for (int i = 0; i < len; i++) acc[i] += s[i];                                         \
+            }                                                                                         \
+            continue;                                                                                 \
+        }                                                                                             \
+        if (end - j == 1) {                                                                           \
+            const type* s = src[j++] + x0;                                                            \
+            for (int i = 0; i < len; i++) acc[i] += w * s[i];                                         \
+            continue;                                                                                 \
+        }                                                                                             \
+        const type* s = src[j++] + x0;                                                                \
+        for (int i = 0; i < len; i++) sum[i] = s[i];                                                  \
+        for (; j < end; j++) {                                                                        \
+            s = src[j] + x0;                                                                          \
+            for (int i = 0; i < len; i++) sum[i] += s[i];                                             \
+        }                                                                                             \
+        for (int i = 0; i < len; i++) acc[i] += w * sum[i];                                           \
+    }                                                                                                 \
+}
+
+PLAN_ACCUMULATE(plan_accumulate_pixels, unsigned char)
+PLAN_ACCUMULATE(plan_accumulate_sums, int)
+
+// Hela kerneln som grupper. Pekarna till varje element räknas en gång per
+// spann.
+static inline __attribute__((always_inline)) void plan_taps(const kernel_plan_t* p, const unsigned char* const* rows, unsigned char* out, int n, kernel_plan_norm_t norm) {
+    const kernel_plan_taps_t* t = &p->taps;
+    const unsigned char* src[KERNEL_MAX_SIZE * KERNEL_MAX_SIZE];
+    int acc[PLAN_BLOCK];
+    for (int j = 0; j < t->taps; j++) {
+        src[j] = rows[t->tap_y[j]] + t->tap_x[j];
+    }
+
+    for (int x0 = 0; x0 < n; x0 += PLAN_BLOCK) {
+        int len = n - x0 < PLAN_BLOCK ? n - x0 : PLAN_BLOCK;
+        plan_accumulate_pixels(acc, src, x0, t->group, t->groups, len);
+        for (int i = 0; i < len; i++) {
+            out[x0 + i] = (unsigned char)plan_normalize(p, acc[i], norm);
+        }
+    }
+}
+
+// Separerbar: kolumnvektorn över raderna till plan_vbuf, sedan radvektorn
+// längs bufferten. Båda passen grupperade som plan_taps.
+static inline __attribute__((always_inline)) void plan_separable(const kernel_plan_t* p, const unsigned char* const* rows, unsigned char* out, int n, kernel_plan_norm_t norm) {
+    const kernel_plan_line_t* c = &p->col;
+    const kernel_plan_line_t* r = &p->row;
+    const unsigned char* src[KERNEL_MAX_SIZE];
+    const int* vsrc[KERNEL_MAX_SIZE];
+    int acc[PLAN_BLOCK];
+    int m = n + p->kernel.ksize - 1;
+
+    for (int j = 0; j < c->taps; j++) {
+        src[j] = rows[c->tap[j]];
+    }
+    for (int x0 = 0; x0 < m; x0 += PLAN_BLOCK) {
+        int len = m - x0 < PLAN_BLOCK ? m - x0 : PLAN_BLOCK;
+        plan_accumulate_pixels(plan_vbuf + x0, src, x0, c->group, c->groups, len);
+    }
+
+    for (int j = 0; j < r->taps; j++) {
+        vsrc[j] = plan_vbuf + r->tap[j];
+    }
+    for (int x0 = 0; x0 < n; x0 += PLAN_BLOCK) {
+        int len = n - x0 < PLAN_BLOCK ? n - x0 : PLAN_BLOCK;
+        plan_accumulate_sums(acc, vsrc, x0, r->group, r->groups, len);
+        for (int i = 0; i < len; i++) {
+            out[x0 + i] = (unsigned char)plan_normalize(p, acc[i], norm);
+        }
+    }
+}
+
+// En rutin per kombination, så att normaliseringen väljs utanför looparna
+#define PLAN_EXECUTORS(suffix, norm)                                                                  \
+static void plan_taps_##suffix(const kernel_plan_t* p, const unsigned char* const* rows, unsigned char* out, int n) { \
+    plan_taps(p, rows, out, n, norm);                                                                 \
+}                                                                                                     \
+static void plan_separable_##suffix(const kernel_plan_t* p, const unsigned char* const* rows, unsigned char* out, int n) { \
+    plan_separable(p, rows, out, n, norm);                                                            \
+}
+
+PLAN_EXECUTORS(none, KERNEL_PLAN_NORM_NONE)
+PLAN_EXECUTORS(shift, KERNEL_PLAN_NORM_SHIFT)
+PLAN_EXECUTORS(recip, KERNEL_PLAN_NORM_RECIP)
+PLAN_EXECUTORS(div, KERNEL_PLAN_NORM_DIV)
+
+// [exec][norm]
+static const kernel_plan_fn plan_executors[2][4] = {
+    { plan_taps_none, plan_taps_shift, plan_taps_recip, plan_taps_div },
+    { plan_separable_none, plan_separable_shift, plan_separable_recip, plan_separable_div }
+};
+
+// ===========================================================
+// Analys
+// ===========================================================
+
+static int gcd(int a, int b) {
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/*
+ * Funktion: find_reciprocal
+ * -------------------------
+ * Söker minsta s så att mul = ceil(2^(32+s) / d) ryms i 32 bitar och
+ * (a * mul) >> (32 + s) == a / d för alla 0 <= a <= max_sum. Med
+ * e = mul * d - 2^(32+s) räcker det att max_sum * e < 2^(32+s).
+ * Returnerar 0 om inget s fungerar.
+ */
+static int find_reciprocal(unsigned int d, unsigned int max_sum, unsigned int* mul, int* shift) {
+    for (int s = 0; s < 32; s++) {
+        unsigned long long pow = 1ULL << (32 + s);
+        unsigned long long m = u64_div_u32(pow - 1, d) + 1;
+        if (m >> 32) return 0;
+        unsigned long long e = m * d - pow;
+        if ((unsigned long long)max_sum * e < pow) {
+            *mul = (unsigned int)m;
+            *shift = s;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Grupperar de nollskilda vikterna i w[0..n) efter värde, i den ordning
+// värdena först förekommer. Returnerar antalet element; index i idx.
+static int group_weights(const int* w, int n, unsigned char* idx, kernel_plan_group_t* group, int* groups) {
+    int taps = 0;
+    *groups = 0;
+    for (int i = 0; i < n; i++) {
+        if (w[i] == 0) continue;
+        int seen = 0;
+        for (int g = 0; g < *groups; g++) {
+            if (group[g].weight == w[i]) seen = 1;
+        }
+        if (seen) continue;
+
+        for (int j = i; j < n; j++) {
+            if (w[j] == w[i]) idx[taps++] = (unsigned char)j;
+        }
+        group[*groups].weight = w[i];
+        group[*groups].end = taps;
+        (*groups)++;
+    }
+    return taps;
+}
+
+static void build_line(kernel_plan_line_t* line, const int* w, int n) {
+    line->taps = group_weights(w, n, line->tap, line->group, &line->groups);
+}
+
+static int plan_valid(const int* table, int ksize, int divisor) {
+    if (ksize < 1 || ksize > KERNEL_MAX_SIZE || (ksize & 1) == 0 || divisor < 1) return 0;
+    for (int i = 0; i < ksize * ksize; i++) {
+        if (table[i] < -KERNEL_PLAN_MAX_WEIGHT || table[i] > KERNEL_PLAN_MAX_WEIGHT) return 0;
+    }
+    return 1;
+}
+
+/*
+ * Funktion: kernel_plan_compile
+ * -----------------------------
+ * Förkortar först vikterna och divisorn med deras gcd; / avrundar mot noll,
+ * så (g * a) / (g * d) == a / d och resultatet ändras inte. Sedan väljs
+ * normaliseringen och den rutin som kostar minst: grupperna över hela
+ * kerneln (en addition per element och en multiplikation per grupp) eller
+ * två grupperade 1-D-pass, plus en skrivning och läsning av bufferten.
+ */
+int kernel_plan_compile(kernel_plan_t* plan, const int* table, int ksize, int divisor, int offset) {
+    if (!plan_valid(table, ksize, divisor)) return 0;
+
+    int count = ksize * ksize;
+    int w[KERNEL_MAX_SIZE * KERNEL_MAX_SIZE];
+    int g = divisor;
+    for (int i = 0; i < count; i++) {
+        plan->table[i] = table[i];
+        g = gcd(g, table[i] < 0 ? -table[i] : table[i]);
+    }
+    unsigned int max_sum = 0;
+    for (int i = 0; i < count; i++) {
+        w[i] = table[i] / g;
+        max_sum += 255 * (unsigned int)(w[i] < 0 ? -w[i] : w[i]);
+    }
+
+    plan->kernel.table = plan->table;
+    plan->kernel.ksize = ksize;
+    plan->kernel.divisor = divisor;
+    plan->kernel.offset = offset;
+    plan->kernel.span = NULL;
+    plan->kernel.plan = plan;
+
+    plan->divisor = divisor / g;
+    plan->shift = 0;
+    plan->mul = 0;
+    if (plan->divisor == 1) {
+        plan->norm = KERNEL_PLAN_NORM_NONE;
+    } else if ((plan->divisor & (plan->divisor - 1)) == 0) {
+        plan->norm = KERNEL_PLAN_NORM_SHIFT;
+        while ((1 << plan->shift) < plan->divisor) plan->shift++;
+    } else if (find_reciprocal(plan->divisor, max_sum, &plan->mul, &plan->shift)) {
+        plan->norm = KERNEL_PLAN_NORM_RECIP;
+    } else {
+        plan->norm = KERNEL_PLAN_NORM_DIV;
+    }
+
+    // Hela kerneln, elementindex delas upp i rad och kolumn
+    kernel_plan_taps_t* t = &plan->taps;
+    unsigned char idx[KERNEL_MAX_SIZE * KERNEL_MAX_SIZE];
+    t->taps = group_weights(w, count, idx, t->group, &t->groups);
+    for (int j = 0; j < t->taps; j++) {
+        t->tap_y[j] = (unsigned char)(idx[j] / ksize);
+        t->tap_x[j] = (unsigned char)(idx[j] % ksize);
+    }
+    plan->exec = KERNEL_PLAN_TAPS;
+    plan->cost = t->taps + t->groups;
+
+    int col[KERNEL_MAX_SIZE], row[KERNEL_MAX_SIZE];
+    if (kernel_factorize(w, ksize, col, row)) {
+        build_line(&plan->col, col, ksize);
+        build_line(&plan->row, row, ksize);
+        int cost = plan->col.taps + plan->col.groups + plan->row.taps + plan->row.groups + 2;
+        if (cost < plan->cost) {
+            plan->exec = KERNEL_PLAN_SEPARABLE;
+            plan->cost = cost;
+        }
+    }
+
+    plan->run = plan_executors[plan->exec][plan->norm];
+    return 1;
+}
+
+void kernel_plan_print(const kernel_plan_t* plan) {
+    print_dec(plan->kernel.ksize);
+    print("x");
+    print_dec(plan->kernel.ksize);
+    if (plan->exec == KERNEL_PLAN_SEPARABLE) {
+        print(" separable, ");
+    } else {
+        print(", ");
+        print_dec(plan->taps.taps);
+        print(" taps in ");
+        print_dec(plan->taps.groups);
+        print(" groups, ");
+    }
+    print_dec(plan->cost);
+    print(" ops/pixel");
+    switch (plan->norm) {
+        case KERNEL_PLAN_NORM_NONE:
+            break;
+        case KERNEL_PLAN_NORM_SHIFT:
+            print(", shift ");
+            print_dec(plan->shift);
+            break;
+        case KERNEL_PLAN_NORM_RECIP:
+            print(", reciprocal of ");
+            print_dec(plan->divisor);
+            break;
+        case KERNEL_PLAN_NORM_DIV:
+            print(", divide by ");
+            print_dec(plan->divisor);
+            break;
+    }
+    print("\n");
+}
+
+// ===========================================================
+// Egna kernels
+// ===========================================================
+
+int kernel_custom_valid(int slot, const int* table, int ksize, int divisor) {
+    return slot >= 1 && slot <= KERNEL_CUSTOM_SLOTS && plan_valid(table, ksize, divisor);
+}
+
+int kernel_custom_load(int slot, const int* table, int ksize, int divisor, int offset) {
+    if (!kernel_custom_valid(slot, table, ksize, divisor)) return 0;
+    kernel_plan_compile(&custom[slot - 1], table, ksize, divisor, offset);
+    custom_version[slot - 1] = ++version_counter;
+    return 1;
+}
+
+const conv_kernel_t* kernel_custom(int slot) {
+    if (slot < 1 || slot > KERNEL_CUSTOM_SLOTS || !custom_version[slot - 1]) return NULL;
+    return &custom[slot - 1].kernel;
+}
+
+unsigned int kernel_custom_version(int slot) {
+    return slot >= 1 && slot <= KERNEL_CUSTOM_SLOTS ? custom_version[slot - 1] : 0;
+}
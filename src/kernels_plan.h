@@ -0,0 +1,113 @@
+// kernels_plan.h
+#ifndef KERNELS_PLAN_H
+#define KERNELS_PLAN_H
+
+// Kernels som laddas medan programmet kör (t.ex. över UART, se xfer.c).
+// En kernel analyseras en gång när den laddas och blir en plan med den
+// billigaste rutinen för just de vikterna, i stället för den generiska
+// täta loopen i kernels.c:
+//
+//   - vikterna och divisorn förkortas med sin gcd, och en divisor som är
+//     en tvåpotens blir ett skift (fixpunktskernels: divisor = 1 << f)
+//   - andra divisorer blir multiplikation med invers när den kan visas
+//     vara exakt för alla möjliga summor
+//   - nollvikter tas bort, och vikter med samma värde samlas i en grupp
+//     vars pixlar adderas före en enda multiplikation. Speglade vikter i en
+//     symmetrisk kernel hamnar alltid i samma grupp.
+//   - en kernel av rang 1 kan i stället köras som två 1-D-pass
+//     (kernel_factorize()), med samma gruppering i varje pass
+//
+// Rutinen med lägst uppskattat antal operationer per pixel väljs. Alla
+// vägar ger samma bytes som convolve_ex() med de ursprungliga vikterna.
+
+#include "kernels.h"
+
+// Egna kernels väljs med SW[9:7] = 1..7 när SW[5] är av (menu.c)
+#define KERNEL_CUSTOM_SLOTS 7
+
+// Största tillåtna |vikt|, så att summan alltid ryms i en int
+#define KERNEL_PLAN_MAX_WEIGHT 32767
+
+typedef enum {
+    KERNEL_PLAN_TAPS,       // Grupper av nollskilda vikter
+    KERNEL_PLAN_SEPARABLE   // Kolumnvektor, sedan radvektor
+} kernel_plan_exec_t;
+
+typedef enum {
+    KERNEL_PLAN_NORM_NONE,   // Divisor 1
+    KERNEL_PLAN_NORM_SHIFT,  // Divisor 1 << shift
+    KERNEL_PLAN_NORM_RECIP,  // (|summa| * mul) >> (32 + shift)
+    KERNEL_PLAN_NORM_DIV     // Vanlig division
+} kernel_plan_norm_t;
+
+// Vikter med samma värde: elementen från förra gruppens end till end
+typedef struct {
+    int weight;
+    int end;
+} kernel_plan_group_t;
+
+// Grupperade vikter i hela kerneln: element (tap_y[j], tap_x[j])
+typedef struct {
+    int taps, groups;
+    unsigned char tap_y[KERNEL_MAX_SIZE * KERNEL_MAX_SIZE];
+    unsigned char tap_x[KERNEL_MAX_SIZE * KERNEL_MAX_SIZE];
+    kernel_plan_group_t group[KERNEL_MAX_SIZE * KERNEL_MAX_SIZE];
+} kernel_plan_taps_t;
+
+// Samma sak för ett 1-D-pass: element tap[j] i vektorn
+typedef struct {
+    int taps, groups;
+    unsigned char tap[KERNEL_MAX_SIZE];
+    kernel_plan_group_t group[KERNEL_MAX_SIZE];
+} kernel_plan_line_t;
+
+typedef void (*kernel_plan_fn)(const kernel_plan_t* plan, const unsigned char* const* rows, unsigned char* out, int n);
+
+struct kernel_plan_t {
+    conv_kernel_t kernel;   // Det som filtren får; table och plan pekar hit
+    int table[KERNEL_MAX_SIZE * KERNEL_MAX_SIZE]; // Vikterna som de laddades
+
+    kernel_plan_exec_t exec;
+    kernel_plan_norm_t norm;
+    kernel_plan_fn run;
+    int divisor;            // Efter förkortning
+    int shift;
+    unsigned int mul;
+    int cost;               // Uppskattade operationer per pixel
+
+    kernel_plan_taps_t taps;  // KERNEL_PLAN_TAPS: hela kerneln
+    kernel_plan_line_t col;   // KERNEL_PLAN_SEPARABLE: vertikala passet
+    kernel_plan_line_t row;   // och det horisontella
+};
+
+/*
+ * Analyserar kerneln och bygger planen. table är ksize*ksize vikter radvis,
+ * ksize udda och högst KERNEL_MAX_SIZE, divisor >= 1 och |vikt| högst
+ * KERNEL_PLAN_MAX_WEIGHT. Returnerar 0 om kerneln inte uppfyller det.
+ * plan->kernel kan sedan användas som vilken conv_kernel_t som helst.
+ */
+int kernel_plan_compile(kernel_plan_t* plan, const int* table, int ksize, int divisor, int offset);
+
+// Räknar n utpixlar enligt planen, med samma konvention som conv_span_fn
+static inline void kernel_plan_run(const kernel_plan_t* plan, const unsigned char* const* rows, unsigned char* out, int n) {
+    plan->run(plan, rows, out, n);
+}
+
+// "7x7 separable, 16 ops/pixel, shift 8" osv
+void kernel_plan_print(const kernel_plan_t* plan);
+
+// 1 om kernel_custom_load() skulle ta emot kerneln, utan att ladda den
+int kernel_custom_valid(int slot, const int* table, int ksize, int divisor);
+
+// Laddar en egen kernel till plats 1..KERNEL_CUSTOM_SLOTS. Platsen ändras
+// inte om kerneln är ogiltig (returnerar 0).
+int kernel_custom_load(int slot, const int* table, int ksize, int divisor, int offset);
+
+// Kerneln på platsen, NULL om ingen har laddats
+const conv_kernel_t* kernel_custom(int slot);
+
+// Ändras vid varje laddning, aldrig 0 för en laddad plats. Ingår i
+// resultatcachens nyckel.
+unsigned int kernel_custom_version(int slot);
+
+#endif
@@ -0,0 +1,307 @@
+// kernels_spec.c
+// Specialiserade rutiner för de inbyggda kernlarna.
+//
+// Varje (kernel, storlek) får en egen helt utrullad rutin där vikterna är
+// konstanter i koden. Kompilatorn tar då bort multiplikationer med 0,
+// ersätter 1 och 2-potenser med additioner och skift, och divisorerna 16
+// och 256 blir skift. /9 och /25 görs som multiplikation med invers.
+// Rutinerna följer samma konvention som conv_span i kernels.c:
+// rows[ky][i + kx] är pixeln under kernelelement (ky, kx) för utpixel i.
+#include "kernels.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// Kolumnsummor för de separerbara rutinerna (n + 2*kcenter element)
+static CONV_SCRATCH int spec_vbuf[CONV_MAX_WIDTH + 2 * KERNEL_MAX_SIZE];
+
+// Division med konstant. Resultatet är exakt heltalsdivision för
+// 0 <= a <= 65535 (/9) respektive 0 <= a <= 43698 (/25), vilket täcker
+// största summan 255 * divisor för box blur.
+#define DIV9(a)   (((unsigned int)(a) * 58255u) >> 19)
+#define DIV16(a)  ((unsigned int)(a) >> 4)
+#define DIV25(a)  (((unsigned int)(a) * 5243u) >> 17)
+#define DIV256(a) ((unsigned int)(a) >> 8)
+
+// Division med en av divisorerna ovan, d är en konstant
+#define DIVN(a, d) ((d) == 9 ? DIV9(a) : (d) == 16 ? DIV16(a) : (d) == 25 ? DIV25(a) : DIV256(a))
+
+#define CLAMP255(a) ((a) < 0 ? 0 : ((a) > 255 ? 255 : (a)))
+
+// ===========================================================
+// SWAR: fyra pixlar per 32-bitars ord
+// ===========================================================
+//
+// Kärnan saknar vektorenhet, så blur-rutinerna läser i stället fyra pixlar
+// per lw. Jämna och udda byte delas upp i två ord med två 16-bitars fält
+// vardera (0x00FF00FF-masken). Vertikala och horisontella summor ryms i
+// fälten utan spill: största summan är 255 * 256 = 65280 för gaussian 5x5.
+//
+// Med E = (v[4q], v[4q+2]) och O = (v[4q+1], v[4q+3]) för kolumnsummorna v
+// blir paret (v[t], v[t+2]) för alla t antingen E/O direkt eller halva av
+// två grannord. Ackumulatorn A räknar utpixlarna i och i+2, B räknar i+1 och
+// i+3, så A | (B << 8) efter divisionen är fyra färdiga pixlar i rätt
+// ordning för en enda sw.
+//
+// Kräver att utpekaren och källraderna ligger lika relativt ordgränsen
+// (bildbredd delbar med 4 och ordjusterade buffertar). Annars, och för
+// korta spann, används de skalära rutinerna.
+
+// Ord som får läsa och skriva bytebuffertar
+typedef unsigned int __attribute__((may_alias)) swar_word_t;
+
+#define SWAR_MIN_SPAN 16
+#define SWAR_EVEN(w) ((w) & 0x00FF00FFu)
+#define SWAR_ODD(w)  (((w) >> 8) & 0x00FF00FFu)
+
+// Packar två 16-bitars summor per ord till fyra pixlar.
+// 16 och 256 delas direkt i fälten, 9 och 25 fält för fält.
+static inline __attribute__((always_inline)) unsigned int swar_pack(unsigned int A, unsigned int B, int d) {
+    if (d == 16 || d == 256) {
+        int sh = d == 16 ? 4 : 8;
+        return ((A >> sh) & 0x00FF00FFu) | (((B >> sh) & 0x00FF00FFu) << 8);
+    }
+    return DIVN(A & 0xFFFF, d) | (DIVN(B & 0xFFFF, d) << 8)
+         | (DIVN(A >> 16, d) << 16) | (DIVN(B >> 16, d) << 24);
+}
+
+// Skalär separerbar [a b a] för utpixlarna [from, to)
+static inline __attribute__((always_inline)) void scalar_sep3(const unsigned char* const* rows, unsigned char* out, int from, int to, int a, int b, int d) {
+    const unsigned char *r0 = rows[0], *r1 = rows[1], *r2 = rows[2];
+    for (int i = from; i < to; i++) {
+        int v0 = a * (r0[i] + r2[i]) + b * r1[i];
+        int v1 = a * (r0[i + 1] + r2[i + 1]) + b * r1[i + 1];
+        int v2 = a * (r0[i + 2] + r2[i + 2]) + b * r1[i + 2];
+        out[i] = (unsigned char)DIVN(a * (v0 + v2) + b * v1, d);
+    }
+}
+
+// Skalär separerbar [a b c b a] för utpixlarna [from, to)
+static inline __attribute__((always_inline)) void scalar_sep5(const unsigned char* const* rows, unsigned char* out, int from, int to, int a, int b, int c, int d) {
+    const unsigned char *r0 = rows[0], *r1 = rows[1], *r2 = rows[2], *r3 = rows[3], *r4 = rows[4];
+    for (int i = from; i < to; i++) {
+        int v[5];
+        for (int k = 0; k < 5; k++) {
+            v[k] = a * (r0[i + k] + r4[i + k]) + b * (r1[i + k] + r3[i + k]) + c * r2[i + k];
+        }
+        out[i] = (unsigned char)DIVN(a * (v[0] + v[4]) + b * (v[1] + v[3]) + c * v[2], d);
+    }
+}
+
+/*
+ * SWAR-variant av [a b a]^T x [a b a] / d. Returnerar 0 om spannet inte
+ * går att köra ordvis. Ordgrupp q täcker kolumnsummorna base+4q .. base+4q+3,
+ * där base väljs så att utpixel i0 + 4j (ordjusterad) får sina par ur
+ * grupperna j-1, j och j+1.
+ */
+static inline __attribute__((always_inline)) int swar_sep3(const unsigned char* const* rows, unsigned char* out, int n, int a, int b, int d) {
+    int i0 = (int)(-(uintptr_t)out & 3);
+    int base = i0 + 1;
+    for (int ky = 0; ky < 3; ky++) {
+        if ((uintptr_t)(rows[ky] + base) & 3) return 0;
+    }
+    int groups = (n + 2 - base) / 4;
+    if (groups < 3) return 0;
+
+    const swar_word_t* w0 = (const swar_word_t*)(rows[0] + base);
+    const swar_word_t* w1 = (const swar_word_t*)(rows[1] + base);
+    const swar_word_t* w2 = (const swar_word_t*)(rows[2] + base);
+
+#define VERT3(q, E, O) do {                                        \
+        unsigned int x0 = w0[q], x1 = w1[q], x2 = w2[q];           \
+        E = a * (SWAR_EVEN(x0) + SWAR_EVEN(x2)) + b * SWAR_EVEN(x1); \
+        O = a * (SWAR_ODD(x0) + SWAR_ODD(x2)) + b * SWAR_ODD(x1);    \
+    } while (0)
+
+    unsigned int Ep, Op, Ec, Oc, En, On;
+    VERT3(0, Ep, Op);
+    VERT3(1, Ec, Oc);
+    scalar_sep3(rows, out, 0, i0 + 4, a, b, d);
+
+    for (int j = 1; j < groups - 1; j++) {
+        VERT3(j + 1, En, On);
+        unsigned int P3 = (Op >> 16) | (Oc << 16);
+        unsigned int P4 = Ec;
+        unsigned int P5 = Oc;
+        unsigned int P6 = (Ec >> 16) | (En << 16);
+        unsigned int A = a * (P3 + P5) + b * P4;
+        unsigned int B = a * (P4 + P6) + b * P5;
+        *(swar_word_t*)(out + i0 + 4 * j) = swar_pack(A, B, d);
+        Ep = Ec; Op = Oc;
+        Ec = En; Oc = On;
+    }
+#undef VERT3
+
+    scalar_sep3(rows, out, i0 + 4 * (groups - 1), n, a, b, d);
+    (void)Ep;
+    return 1;
+}
+
+// SWAR-variant av [a b c b a]^T x [a b c b a] / d, se swar_sep3
+static inline __attribute__((always_inline)) int swar_sep5(const unsigned char* const* rows, unsigned char* out, int n, int a, int b, int c, int d) {
+    int i0 = (int)(-(uintptr_t)out & 3);
+    int base = i0 + 2;
+    for (int ky = 0; ky < 5; ky++) {
+        if ((uintptr_t)(rows[ky] + base) & 3) return 0;
+    }
+    int groups = (n + 4 - base) / 4;
+    if (groups < 3) return 0;
+
+    const swar_word_t* w0 = (const swar_word_t*)(rows[0] + base);
+    const swar_word_t* w1 = (const swar_word_t*)(rows[1] + base);
+    const swar_word_t* w2 = (const swar_word_t*)(rows[2] + base);
+    const swar_word_t* w3 = (const swar_word_t*)(rows[3] + base);
+    const swar_word_t* w4 = (const swar_word_t*)(rows[4] + base);
+
+#define VERT5(q, E, O) do {                                                  \
+        unsigned int x0 = w0[q], x1 = w1[q], x2 = w2[q], x3 = w3[q], x4 = w4[q]; \
+        E = a * (SWAR_EVEN(x0) + SWAR_EVEN(x4)) + b * (SWAR_EVEN(x1) + SWAR_EVEN(x3)) \
+          + c * SWAR_EVEN(x2);                                               \
+        O = a * (SWAR_ODD(x0) + SWAR_ODD(x4)) + b * (SWAR_ODD(x1) + SWAR_ODD(x3)) \
+          + c * SWAR_ODD(x2);                                                \
+    } while (0)
+
+    unsigned int Ep, Op, Ec, Oc, En, On;
+    VERT5(0, Ep, Op);
+    VERT5(1, Ec, Oc);
+    scalar_sep5(rows, out, 0, i0 + 4, a, b, c, d);
+
+    for (int j = 1; j < groups - 1; j++) {
+        VERT5(j + 1, En, On);
+        unsigned int P2 = (Ep >> 16) | (Ec << 16);
+        unsigned int P3 = (Op >> 16) | (Oc << 16);
+        unsigned int P4 = Ec;
+        unsigned int P5 = Oc;
+        unsigned int P6 = (Ec >> 16) | (En << 16);
+        unsigned int P7 = (Oc >> 16) | (On << 16);
+        unsigned int A = a * (P2 + P6) + b * (P3 + P5) + c * P4;
+        unsigned int B = a * (P3 + P7) + b * (P4 + P6) + c * P5;
+        *(swar_word_t*)(out + i0 + 4 * j) = swar_pack(A, B, d);
+        Ep = Ec; Op = Oc;
+        Ec = En; Oc = On;
+    }
+#undef VERT5
+
+    scalar_sep5(rows, out, i0 + 4 * (groups - 1), n, a, b, c, d);
+    return 1;
+}
+
+/*
+ * Separerbar, symmetrisk 3x3-kernel [a b a]^T x [a b a].
+ * Speglade rader och kolumner adderas före multiplikationen.
+ * Alla vikter är positiva och summan delas med hela vikten,
+ * så resultatet ligger redan i [0,255].
+ */
+#define SPEC_SEP3(name, a, b, d)                                            \
+static void name(const unsigned char* const* rows, unsigned char* out, int n) { \
+    if (n >= SWAR_MIN_SPAN && swar_sep3(rows, out, n, a, b, d)) return;    \
+    const unsigned char* r0 = rows[0];                                     \
+    const unsigned char* r1 = rows[1];                                     \
+    const unsigned char* r2 = rows[2];                                     \
+    int* v = spec_vbuf;                                                    \
+    for (int j = 0; j < n + 2; j++) {                                      \
+        v[j] = (a) * (r0[j] + r2[j]) + (b) * r1[j];                        \
+    }                                                                      \
+    for (int i = 0; i < n; i++) {                                          \
+        int acc = (a) * (v[i] + v[i + 2]) + (b) * v[i + 1];                \
+        out[i] = (unsigned char)DIVN(acc, d);                              \
+    }                                                                      \
+}
+
+// Separerbar, symmetrisk 5x5-kernel [a b c b a]^T x [a b c b a]
+#define SPEC_SEP5(name, a, b, c, d)                                         \
+static void name(const unsigned char* const* rows, unsigned char* out, int n) { \
+    if (n >= SWAR_MIN_SPAN && swar_sep5(rows, out, n, a, b, c, d)) return; \
+    const unsigned char* r0 = rows[0];                                     \
+    const unsigned char* r1 = rows[1];                                     \
+    const unsigned char* r2 = rows[2];                                     \
+    const unsigned char* r3 = rows[3];                                     \
+    const unsigned char* r4 = rows[4];                                     \
+    int* v = spec_vbuf;                                                    \
+    for (int j = 0; j < n + 4; j++) {                                      \
+        v[j] = (a) * (r0[j] + r4[j]) + (b) * (r1[j] + r3[j]) + (c) * r2[j]; \
+    }                                                                      \
+    for (int i = 0; i < n; i++) {                                          \
+        int acc = (a) * (v[i] + v[i + 4]) + (b) * (v[i + 1] + v[i + 3])    \
+                + (c) * v[i + 2];                                          \
+        out[i] = (unsigned char)DIVN(acc, d);                              \
+    }                                                                      \
+}
+
+// En rad av en tät kernel, vikterna är konstanter
+#define TAPS3(r, i, k0, k1, k2) \
+    ((k0) * (r)[(i)] + (k1) * (r)[(i) + 1] + (k2) * (r)[(i) + 2])
+#define TAPS5(r, i, k0, k1, k2, k3, k4) \
+    ((k0) * (r)[(i)] + (k1) * (r)[(i) + 1] + (k2) * (r)[(i) + 2] + \
+     (k3) * (r)[(i) + 3] + (k4) * (r)[(i) + 4])
+
+// Tät 3x3-kernel med divisor 1 (edge och sharpen)
+#define SPEC_DENSE3(name, k00, k01, k02, k10, k11, k12, k20, k21, k22)      \
+static void name(const unsigned char* const* rows, unsigned char* out, int n) { \
+    const unsigned char* r0 = rows[0];                                     \
+    const unsigned char* r1 = rows[1];                                     \
+    const unsigned char* r2 = rows[2];                                     \
+    for (int i = 0; i < n; i++) {                                          \
+        int acc = TAPS3(r0, i, k00, k01, k02)                              \
+                + TAPS3(r1, i, k10, k11, k12)                              \
+                + TAPS3(r2, i, k20, k21, k22);                             \
+        out[i] = (unsigned char)CLAMP255(acc);                             \
+    }                                                                      \
+}
+
+// Tät 5x5-kernel med divisor 1
+#define SPEC_DENSE5(name, k00, k01, k02, k03, k04, k10, k11, k12, k13, k14, \
+                    k20, k21, k22, k23, k24, k30, k31, k32, k33, k34,       \
+                    k40, k41, k42, k43, k44)                                \
+static void name(const unsigned char* const* rows, unsigned char* out, int n) { \
+    const unsigned char* r0 = rows[0];                                     \
+    const unsigned char* r1 = rows[1];                                     \
+    const unsigned char* r2 = rows[2];                                     \
+    const unsigned char* r3 = rows[3];                                     \
+    const unsigned char* r4 = rows[4];                                     \
+    for (int i = 0; i < n; i++) {                                          \
+        int acc = TAPS5(r0, i, k00, k01, k02, k03, k04)                    \
+                + TAPS5(r1, i, k10, k11, k12, k13, k14)                    \
+                + TAPS5(r2, i, k20, k21, k22, k23, k24)                    \
+                + TAPS5(r3, i, k30, k31, k32, k33, k34)                    \
+                + TAPS5(r4, i, k40, k41, k42, k43, k44);                   \
+        out[i] = (unsigned char)CLAMP255(acc);                             \
+    }                                                                      \
+}
+
+// Vikterna nedan måste stämma med tabellerna i kernels.c
+SPEC_DENSE3(span_edge_3x3,
+    -1, -1, -1,
+    -1,  8, -1,
+    -1, -1, -1)
+SPEC_SEP3(span_boxblur_3x3, 1, 1, 9)
+SPEC_SEP3(span_gaussian_3x3, 1, 2, 16)
+SPEC_DENSE3(span_sharpen_3x3,
+     0, -1,  0,
+    -1,  5, -1,
+     0, -1,  0)
+
+SPEC_DENSE5(span_edge_5x5,
+    -1, -1, -1, -1, -1,
+    -1,  1,  2,  1, -1,
+    -1,  2,  4,  2, -1,
+    -1,  1,  2,  1, -1,
+    -1, -1, -1, -1, -1)
+SPEC_SEP5(span_boxblur_5x5, 1, 1, 1, 25)
+SPEC_SEP5(span_gaussian_5x5, 1, 4, 6, 256)
+SPEC_DENSE5(span_sharpen_5x5,
+     0,  0, -1,  0,  0,
+     0, -1, -2, -1,  0,
+    -1, -2, 13, -2, -1,
+     0, -1, -2, -1,  0,
+     0,  0, -1,  0,  0)
+
+// Beskrivningar som get_selected_kernel() returnerar
+const conv_kernel_t conv_edge_3x3     = { (const int*)edge_3x3,     3, 1,   0, span_edge_3x3, NULL };
+const conv_kernel_t conv_boxblur_3x3  = { (const int*)boxblur_3x3,  3, 9,   0, span_boxblur_3x3, NULL };
+const conv_kernel_t conv_gaussian_3x3 = { (const int*)gaussian_3x3, 3, 16,  0, span_gaussian_3x3, NULL };
+const conv_kernel_t conv_sharpen_3x3  = { (const int*)sharpen_3x3,  3, 1,   0, span_sharpen_3x3, NULL };
+
+const conv_kernel_t conv_edge_5x5     = { (const int*)edge_5x5,     5, 1,   0, span_edge_5x5, NULL };
+const conv_kernel_t conv_boxblur_5x5  = { (const int*)boxblur_5x5,  5, 25,  0, span_boxblur_5x5, NULL };
+const conv_kernel_t conv_gaussian_5x5 = { (const int*)gaussian_5x5, 5, 256, 0, span_gaussian_5x5, NULL };
+const conv_kernel_t conv_sharpen_5x5  = { (const int*)sharpen_5x5,  5, 1,   0, span_sharpen_5x5, NULL };
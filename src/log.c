@@ -0,0 +1,115 @@
+// log.c
+// Ringbufferten bakom print() (se log.h).
+//
+// Huvudloopen är ensam om att skriva head. tail flyttas av log_drain(),
+// som körs både i timer-interrupten och i huvudloopen; i huvudloopen är
+// interrupts avstängda medan den pågår, så bara en tömmer åt gången.
+#include "log.h"
+#include "hal.h"
+
+#define LOG_MASK (LOG_BUFFER_SIZE - 1)
+
+static char buffer[LOG_BUFFER_SIZE];
+static volatile unsigned int head;
+static volatile unsigned int tail;
+static unsigned int dropped;
+static unsigned int reported;   // dropped när senaste anteckningen skrevs
+
+static unsigned int space(void) {
+    return LOG_BUFFER_SIZE - (head - tail);
+}
+
+static void append(const char* data, unsigned int len) {
+    unsigned int h = head;
+    for (unsigned int i = 0; i < len; i++) {
+        buffer[(h + i) & LOG_MASK] = data[i];
+    }
+    // Texten måste ligga i minnet innan log_drain() ser nya head
+    asm volatile ("" ::: "memory");
+    head = h + len;
+}
+
+/*
+ * Funktion: log_format_dec
+ * ------------------------
+ * x / 10 räknas som (x * 0xCCCCCCCD) >> 35, vilket är exakt för alla
+ * 32-bitarstal och blir en mulhu och ett skift i stället för en divu.
+ */
+int log_format_dec(char* out, unsigned int x) {
+    char digits[10];
+    int n = 0;
+    do {
+        unsigned int q = (unsigned int)(((unsigned long long)x * 0xCCCCCCCDu) >> 35);
+        digits[n++] = (char)('0' + (x - q * 10));
+        x = q;
+    } while (x != 0);
+
+    for (int i = 0; i < n; i++) {
+        out[i] = digits[n - 1 - i];
+    }
+    return n;
+}
+
+// "[log: N dropped]" före nästa meddelande, om det finns plats för båda
+static void note_dropped(unsigned int len) {
+    static const char prefix[] = "[log: ";
+    static const char suffix[] = " dropped]\n";
+    char note[sizeof(prefix) - 1 + 10 + sizeof(suffix) - 1];
+    unsigned int n = 0;
+
+    for (unsigned int i = 0; i < sizeof(prefix) - 1; i++) note[n++] = prefix[i];
+    n += log_format_dec(note + n, dropped - reported);
+    for (unsigned int i = 0; i < sizeof(suffix) - 1; i++) note[n++] = suffix[i];
+
+    if (space() >= n + len) {
+        append(note, n);
+        reported = dropped;
+    }
+}
+
+void log_write(const char* data, unsigned int len) {
+    if (dropped != reported) note_dropped(len);
+    if (space() >= len) {
+        append(data, len);
+    } else {
+        dropped++;
+    }
+#ifdef HOST
+    log_flush();
+#endif
+}
+
+void log_write_wait(const char* data, unsigned int len) {
+    if (dropped != reported) note_dropped(0);
+    while (len > 0) {
+        unsigned int n = len < LOG_BUFFER_SIZE ? len : LOG_BUFFER_SIZE;
+        while (space() < n) log_drain();
+        append(data, n);
+        data += n;
+        len -= n;
+    }
+#ifdef HOST
+    log_flush();
+#endif
+}
+
+void log_drain(void) {
+    unsigned int irq = hal_irq_save();
+    unsigned int t = tail;
+    unsigned int room = hal_uart_tx_space();
+    while (t != head && room > 0) {
+        hal_uart_putc((unsigned char)buffer[t & LOG_MASK]);
+        t++;
+        room--;
+    }
+    tail = t;
+    hal_irq_restore(irq);
+}
+
+void log_flush(void) {
+    while (tail != head) log_drain();
+}
+
+unsigned int log_dropped(void) {
+    return dropped;
+}
@@ -0,0 +1,55 @@
+// log.h
+#ifndef LOG_H
+#define LOG_H
+
+// Buffrad utskrift. print(), printc(), print_dec() och print_hex32() lägger
+// texten i en ringbuffert i RAM och återvänder direkt; timer-interrupten
+// och huvudloopen (när den är ledig) tömmer bufferten till JTAG UART så
+// fort FIFO:n har plats. Ett jobb väntar alltså aldrig på serieporten.
+//
+// Ryms inte ett meddelande släpps det helt och räknas. Nästa meddelande
+// som får plats föregås av "[log: N dropped]". Ramar från xfer.c
+// (uart_write()) släpps aldrig; de väntar på plats i stället, så att de
+// hamnar i rätt ordning bland texten och aldrig blandas med den.
+//
+// Med -DHOST finns ingen timer-interrupt, så bufferten töms direkt.
+
+// Buffertens storlek, en tvåpotens
+#define LOG_BUFFER_SIZE 4096
+
+// Loggnivåer. LOG_LEVEL väljs vid kompilering (make LOG_LEVEL=2); utskrifter
+// över nivån försvinner helt ur bygget.
+#define LOG_LEVEL_INFO 1    // Menyer, resultat och status
+#define LOG_LEVEL_DEBUG 2   // Spårutskrifter från filtren, t.ex. vid varje convolve
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(s) print(s)
+#else
+#define LOG_DEBUG(s) ((void)0)
+#endif
+
+// Lägger len bytes i bufferten, eller släpper dem om de inte ryms
+void log_write(const char* data, unsigned int len);
+
+// Som log_write(), men väntar (och tömmer själv) tills det finns plats
+void log_write_wait(const char* data, unsigned int len);
+
+// Skriver så mycket som UART-FIFO:n tar emot just nu, utan att vänta.
+// Får anropas både från interrupten och från huvudloopen.
+void log_drain(void);
+
+// Väntar tills allt har skrivits, t.ex. innan ett undantag stannar kortet
+void log_flush(void);
+
+// Antal släppta meddelanden sedan start
+unsigned int log_dropped(void);
+
+// Decimal text för x i out (minst 10 bytes), utan division.
+// Returnerar antalet siffror.
+int log_format_dec(char* out, unsigned int x);
+
+#endif
@@ -2,38 +2,47 @@
  * main.c - Huvudprogram för inbyggd bildbehandling på DTEK-V
  *
  * Denna version använder en bild som är inbakad direkt i programmet
- * från en header-fil (t.ex. 'cat_image.h'). Detta eliminerar behovet
+ * från en header-fil (t.ex. 'cat_image.h'), eller med .incbin, packad om
+ * så önskas (make IMAGE=incbin / IMAGE=packed). Detta eliminerar behovet
  * av 'dtekv-upload' under körning.
  *
  * Logik:
- * 1. Vid start laddas den inbyggda bilden automatiskt in i 'input_img'.
+ * 1. Bearbetningen läser direkt från den inbyggda bilden via 'image_src'.
+ *    Den kopieras till 'input_img' först när indata behöver ändras.
  * 2. Användaren väljer filter och storlek med switchar (SW[1:0] och SW[2]).
  * 3. En knapptryckning (BTN[0]) bekräftar en handling:
  * - Om SW[3] är på: Bearbeta bilden (kör convolve).
  * - Om SW[4] är på: Chain commands (två filter i följd).
- * 4. Den bearbetade bilden i 'output_img' kan laddas ner med 'dtekv-download'.
+ * 4. Den bearbetade bilden kan laddas ner med 'dtekv-download' från den
+ *    adress som skrivs ut när den är klar.
+ *
+ * Switchar och knapp läses av timer-interrupten (input.c); huvudloopen
+ * sover med wfi mellan händelserna. Filtren körs som jobb några rader i
+ * taget mellan händelserna, med procent klart på 7-segmentdisplayerna.
+ * Ett nytt knapptryck avbryter jobbet (och startar om med det som är
+ * valt), och ändrade switchar avbryter ett jobb som blivit inaktuellt.
+ *
+ * Färdiga resultat sparas i resultatcachen (cache.c) i det lediga RAM:et
+ * ovanför stacken. Ett val som redan körts på samma bild visas direkt.
+ *
+ * Bilder kan också laddas upp och ner med ramprotokollet i xfer.c över
+ * samma JTAG UART (värdsidan är host/imglink.c). Ett filter som följer
+ * med en uppladdning körs medan raderna kommer.
  */
 
 // Created by Yannsze from lab3, main modified by Jacob
 
-#include <string.h>
 #include "dtekv-lib.h"
 #include "main.h"
 #include "menu.h"
-#include "kernels.h"
-
-// Inkludera headern med bild-arrayen
-#include "cat_image.h"
-
-// ===========================================================
-// Globala bildbuffertar
-// ===========================================================
-
-// Definierade i main.h, men allokerade här.
-
-unsigned char output_img[IMG_HEIGHT][IMG_WIDTH];
-unsigned char input_img[IMG_HEIGHT][IMG_WIDTH];
-unsigned char temp_img[IMG_HEIGHT][IMG_WIDTH];
+#include "process.h"
+#include "input.h"
+#include "cache.h"
+#include "xfer.h"
+#include "log.h"
+#include "membench.h"
+#include "profile.h"
+#include <stddef.h>
 
 // ===========================================================
 // Globala variabler 
@@ -41,29 +50,20 @@ unsigned char temp_img[IMG_HEIGHT][IMG_WIDTH];
 
 int timeoutcount = 0; // Används av interrupt-hanteraren
 
-// ===========================================================
-// Externa symboler (från andra filer)
-// ===========================================================
-
-extern void enable_interrupt();
-extern void delay(int);
-
 // ===========================================================
 // Timer- och systeminitiering
 // ===========================================================
 
 void labinit(void) {
 
-    print("Initializing system...\n");
-
-    // Sätt upp timer för att generera en interrupt varje 100ms (vid 30 MHz)
-
-    timer_control = 0x8; // Stäng av timer medan vi konfigurerar
-    timer_periodl = 3000000 & 0xFFFF;
-    timer_periodh = (3000000 >> 16) & 0xFFFF;
-    timer_status = 0;    // Nollställ status
-    timer_control = 0x7; // Aktivera timer, starta, och tillåt interrupt
+    // Timer-interrupt INPUT_TICK_HZ gånger per sekund (vid 30 MHz). Varje
+    // tick läser också switchar och knappar, se input.c.
+    input_init();
+    hal_timer_start(INPUT_TICK_CYCLES);
 
+    // enable_interrupt i boot.S sätter mstatus bit 0-1 och mie bit 4, inte
+    // MIE och timerns linje 16, så bitarna sätts via hal.h i stället
+    hal_irq_enable();
 }
 
 // ===========================================================
@@ -75,9 +75,10 @@ void handle_interrupt(unsigned cause) {
     // Kontrollera om det var en timer-interrupt
 
     if (cause == 16) {
-        if (timer_status & 1) {
-            timer_status = 0; // Rensa interrupt-flaggan
+        if (hal_timer_ack()) {
             timeoutcount++;
+            input_sample();
+            log_drain();
         }
     }
 }
@@ -89,141 +90,206 @@ void handle_interrupt(unsigned cause) {
 // ===========================================================
 
 void set_leds(int led_mask) {
-    led_reg = led_mask & 0x3FF; // Använd endast de 10 lägsta bitarna
+    hal_write_leds(led_mask); // Använd endast de 10 lägsta bitarna
 }
 
 int get_sw(void) {
-    return toggle_reg & 0x3FF;
+    return hal_read_switches();
 }
 
 int get_btn(void) {
-    return btn_reg & 0x1;
+    return hal_read_buttons() & 0x1;
 }
 
-// Jacob
-// Laddar den inbyggda bilden till input_img bufferten.
-void load_initial_image(void) {
-    print("Loading embedded cat image into input buffer...\n");
-    memcpy(input_img, cat_img, sizeof(cat_img));
-    print("Image loaded.\n");
-}
+// Segment för siffrorna 0-9, aktivt låga (bit 0-6 = a-g)
+static const unsigned char digit_segments[10] = {
+    0xC0, 0xF9, 0xA4, 0xB0, 0x99, 0x92, 0x82, 0xF8, 0x80, 0x90
+};
 
-// Återställer bilden till originalet och rensar output.
-void reset_images(void) {
-    print("Resetting images...\n");
-    load_initial_image(); // Åter-ladda originalbilden
-    memset(output_img, 0, sizeof(output_img));
-    print("Images reset to initial state.\n");
+// Visar en siffra 0-9 på display 0-5; andra värden släcker den
+void set_displays(int display_number, int value) {
+    hal_write_display(display_number, value >= 0 && value <= 9 ? digit_segments[value] : 0xFF);
 }
 
-// ===========================================================
-// Huvudprogram
-// ===========================================================
-int main(void) {
-    labinit();
-    delay(100000); // Liten fördröjning för att systemet ska stabiliseras
-
-    // --- Steg 1: Skriv ut viktig information vid start ---
-    print("\n=== DTEK-V Embedded Image Processor ===\n");
-    // Ladda den inbyggda bilden direkt vid start
-    load_initial_image();
+// Procent klart på de tre högra displayerna, -1 släcker. Skriver bara
+// när värdet ändrats.
+static void show_progress(int percent) {
+    static int shown = -2;
+    if (percent == shown) return;
+    shown = percent;
+    if (percent < 0) {
+        for (int i = 0; i < 3; i++) set_displays(i, -1);
+        return;
+    }
+    set_displays(0, percent % 10);
+    set_displays(1, percent >= 10 ? (percent / 10) % 10 : -1);
+    set_displays(2, percent >= 100 ? 1 : -1);
+}
 
-    // Skriv ut minnesadresser för JTAG-överföring (endast för nedladdning nu)
-    print("\n--> Use this address with dtekv-download:\n");
-    print("output_img address: ");
-    print_hex32((unsigned int)output_img);
-    print("\nImage size in bytes: 65536\n\n");
+// Kommandot för att hämta det senaste resultatet. Adressen är en plats i
+// resultatcachen och ändras alltså mellan körningarna.
+static void print_download(void) {
+    print("dtekv-download <out.raw> ");
+    print_hex32((unsigned int)result_img);
+    print(" 65536\n");
+}
 
-    // Skriv ut uppdaterade instruktioner
-    print("--- Instructions ---\n");
+// Skrivs ut vid BTN[0] när ingen handling är vald, inte vid start.
+void print_instructions(void) {
+    print("\n--- Instructions ---\n");
     print("The cat image is pre-loaded.\n");
     print("1. Use switches to select operation:\n");
     print("   SW[1:0]: Kernel Type (00=Edge, 01=Box, 10=Gauss, 11=Sharp)\n");
     print("   SW[2]:   Kernel Size (0=3x3, 1=5x5)\n");
     print("   SW[3]:   Set to 1 to enable 'Process Image' action\n");
     print("   SW[4]:   Set to 1 to enable 'Chain Process Image' action\n");
+    print("   SW[5]:   Large box blur, radius from SW[9:7] (1,2,3,5,7,10,15,31)\n");
+    print("            or with Gauss: recursive Gauss, sigma from SW[9:7] (1,2,3,4,6,10,15,20)\n");
+    print("            or with Edge: median (SW[2]=1: 25th percentile), with Sharp: min (SW[2]=1: max),\n");
+    print("            radius from SW[9:7] (1,2,3,4,5,7,10,15)\n");
+    print("   SW[9:7]: With SW[5]=0, custom kernel 1-7 loaded with imglink\n");
     print("   SW[6]:   Set to 1 to enable 'Reset Image' action\n");
     print("2. Press BTN[0] to execute the selected action.\n");
-    print("3. Download result from host: dtekv-download <out.raw> <output_addr> 65536\n\n");
+    print("3. Download the latest result from host: ");
+    print_download();
+    print("   or with imglink over the UART, which can also upload images.\n\n");
+}
 
-    print("\n--- Menu loop starting ---\n");
+// ===========================================================
+// Huvudprogram
+// ===========================================================
+int main(void) {
+    labinit();
+    cache_init(CACHE_BUDGET);
+    xfer_init();
+
+#ifdef MEMBENCH
+    mem_benchmark();
+#endif
+
+    // Bilden behöver inte laddas, image_src pekar redan på den inbyggda.
+    // Instruktionerna skrivs ut först när användaren ber om dem.
+    print("\n=== DTEK-V Embedded Image Processor ===\n");
+    print("Press BTN[0] with no action selected for instructions.\n");
 
-    // Initiera meny och knappstatus
+    // Initiera meny och lysdioder från switcharnas startläge
     menu_state_t menu;
     menu_init(&menu);
-    int last_btn = 0;
+    menu_update(&menu, input_switches(), 0);
+    menu_show(&menu);
+    show_progress(-1);
+
+    // Första filtret i kedjeläge, medan användaren väljer det andra
+    menu_state_t first;
+    int waiting_second = 0;
+
+    // Switchläget och ticket när det pågående jobbet startade
+    unsigned int job_switches = 0;
+    unsigned int job_tick = 0;
 
     // =======================================================
-    // Huvudloop
+    // Huvudloop: en avstudsad händelse i taget. När inga händelser
+    // väntar körs UART-överföringen och en bit av det pågående
+    // jobbet; finns ingetdera sover processorn till nästa tick.
     // =======================================================
     while (1) {
-        int switches = get_sw();
-        int btn = get_btn();
+        input_event_t ev;
+
+        if (!input_poll(&ev)) {
+            xfer_status_t link = xfer_service();
+            if (link == XFER_STARTED) {
+                job_switches = input_switches();
+                job_tick = input_ticks();
+                show_progress(0);
+            }
 
-        // Uppdatera menystatus baserat på switchar och visa på lysdioder
-        menu_update(&menu, switches, btn);
+            if (process_busy()) {
+                if (process_step(PROCESS_CHUNK_ROWS)) {
+                    show_progress(process_progress());
+                } else {
+                    show_progress(100);
+                    print("Processing complete in ");
+                    print_dec(input_ticks() - job_tick);
+                    print(" ms. Image is ready for download:\n");
+                    print_download();
+                    cache_report();
+                    PROF_REPORT(IMG_WIDTH * IMG_HEIGHT);
+                }
+            } else if (link == XFER_IDLE) {
+                log_drain();
+                hal_wait_for_interrupt();
+            }
+            continue;
+        }
+
+        // Uppdatera menystatus från switcharna och visa på lysdioder
+        menu_update(&menu, ev.value, ev.type == INPUT_BTN_PRESS);
         menu_show(&menu);
 
-        // Kontrollera om en knapptryckning precis har skett (stigande flank)
-        if (btn && !last_btn) {
-
-            // KONTROLL 1: Är "Process Image"-läget (SW[3]) aktivt?
-            if (menu.run_mode) {
-                int divisor;
-                const int* kernel = get_selected_kernel(&menu, &divisor);
-
-                if (kernel) {
-                    // Kontrollera om vi är i kedjeläge (SW[4])
-                    if (menu.chain_mode) {
-                        print("Processing image in CHAIN mode...\n");
-
-                        // --- Första kerneln ---
-                        print("Applying first kernel...\n");
-                        const int* kernel1 = get_selected_kernel(&menu, &divisor);
-                        convolve((unsigned char*)input_img, (unsigned char*)temp_img,
-                                IMG_WIDTH, IMG_HEIGHT, kernel1, menu.kernel_size, divisor, 0);
-
-                        // --- Vänta på användarval av nästa filter ---
-                        print("\nFirst filter done. Select second kernel with switches and press BTN[0] again.\n");
-                        print("SW[1:0]: Kernel Type, SW[2]: Kernel Size.\n");
-                        print("Waiting for button press...\n");
-
-                        // Vänta tills användaren trycker igen
-                        while (get_btn() == 0);
-                        while (get_btn() == 1); // vänta tills knappen släpps
-                        
-                        //Läs in switcharna på nytt och uppdatera menyn
-                        int switches2 = get_sw();
-                        menu_update(&menu, switches2, 1); // simulera nytt knapptryck i menyn
-
-                        // --- Andra kerneln ---
-                        int divisor2;
-                        const int* kernel2 = get_selected_kernel(&menu, &divisor2);
-                        print("Applying second kernel...\n");
-                        convolve((unsigned char*)temp_img, (unsigned char*)output_img,
-                                IMG_WIDTH, IMG_HEIGHT, kernel2, menu.kernel_size, divisor2, 0);
-
-                        print("Processing complete. Image is ready for download.\n");
-                    } else {
-                        //Den vanliga single-filter-processen
-                        print("Processing image in SINGLE mode...\n");
-                        convolve((unsigned char*)input_img, (unsigned char*)output_img,
-                                IMG_WIDTH, IMG_HEIGHT, kernel, menu.kernel_size, divisor, 0);
-                        print("Processing complete. Image is ready for download.\n");
-                    }
-                } else {
-                    print("Error: Could not get selected kernel.\n");
-    }
-}
-            
-            // KONTROLL 2: Om INTE process-läget var aktivt, är "Reset" (SW[6]) det?
-            else if (menu.reset) {
-                reset_images();
+        // Ett ändrat filterval gör pågående arbete inaktuellt (SW[6] påverkar inte)
+        if (ev.type == INPUT_SWITCHES && process_busy() && ((ev.value ^ job_switches) & ~0x40u)) {
+            process_cancel();
+            show_progress(-1);
+            print("Selection changed, processing cancelled.\n");
+        }
+
+        if (ev.type != INPUT_BTN_PRESS) continue;
+
+        // Ett tryck under ett jobb avbryter det; är en handling vald
+        // startas den om nedan med de nya switcharna
+        if (process_busy()) {
+            process_cancel();
+            show_progress(-1);
+            print("Processing cancelled.\n");
+        }
+
+        process_request_t request = PROCESS_FAILED;
+
+        // Andra trycket i kedjeläge: kör kedjan med de nya switcharna
+        if (waiting_second) {
+            waiting_second = 0;
+            request = process_request(&first, &menu);
+        }
+
+        // KONTROLL 1: Är "Process Image"-läget (SW[3]) aktivt?
+        else if (menu.run_mode) {
+            // Kontrollera om vi är i kedjeläge (SW[4])
+            if (menu.chain_mode) {
+                print("Processing image in CHAIN mode...\n");
+
+                // Spara första filtret; nästa tryck kör kedjan
+                first = menu;
+                waiting_second = 1;
+                print("\nFirst filter selected. Select second kernel with switches and press BTN[0] again.\n");
+                print("SW[1:0]: Kernel Type, SW[2]: Kernel Size.\n");
+                print("Waiting for button press...\n");
+            } else {
+                //Den vanliga single-filter-processen
+                print("Processing image in SINGLE mode...\n");
+                request = process_request(&menu, NULL);
             }
+        }
+
+        // KONTROLL 2: Om INTE process-läget var aktivt, är "Reset" (SW[6]) det?
+        else if (menu.reset) {
+            reset_images();
+        }
 
-        } // Slut på if(btn && !last_btn)
-        // Spara knappens nuvarande tillstånd för att kunna detektera nästa tryck
-        last_btn = btn;
-        
+        // Ingen handling vald: visa instruktionerna
+        else {
+            print_instructions();
+        }
+
+        // Ett sparat resultat är klart direkt
+        if (request == PROCESS_CACHED) {
+            show_progress(100);
+            print("Image is ready for download:\n");
+            print_download();
+            cache_report();
+        } else if (request == PROCESS_STARTED) {
+            job_switches = ev.value;
+            job_tick = input_ticks();
+            show_progress(0);
+        }
     } // Slut på while(1)
 }
@@ -6,18 +6,7 @@
 #define IMG_WIDTH 256
 #define IMG_HEIGHT 256
 
-// Hardware Registers mapping
-// Timer Registers
-#define timer_status (*(volatile unsigned int *) 0x04000020)
-#define timer_control (*(volatile unsigned int *) 0x04000024)
-#define timer_periodl (*(volatile unsigned int *) 0x04000028)
-#define timer_periodh (*(volatile unsigned int *) 0x0400002C)
-
-// I/O Registers
-#define toggle_reg (*(volatile unsigned int *) 0x04000010)
-#define toggle_regOffset (*(volatile unsigned int *) 0x04000018)
-#define btn_reg (*(volatile unsigned int *) 0x040000d0)
-#define led_reg (*(volatile unsigned int *) 0x04000000)
+#include "hal.h"
 
 // Functions 
 void labinit(void);
@@ -30,10 +19,11 @@ int get_btn(void);
 
 // UART functions
 void uart_putchar(unsigned char c);
+void uart_write(const unsigned char* data, int len); // hela data i ett stycke
 int uart_getchar(void);
 
-extern unsigned char input_img[IMG_WIDTH][IMG_HEIGHT];
-extern unsigned char output_img[IMG_WIDTH][IMG_HEIGHT];
+extern unsigned char input_img[IMG_HEIGHT][IMG_WIDTH];
+extern unsigned char output_img[IMG_HEIGHT][IMG_WIDTH];
 extern int mytime;
 extern char textstring[];
 extern int prime;
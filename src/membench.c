@@ -0,0 +1,94 @@
+// membench.c
+#include <string.h>
+#include "dtekv-lib.h"
+#include "hal.h"
+#include "membench.h"
+
+#ifdef MEMBENCH
+
+#define BENCH_BUF  4096
+#define BENCH_REPS 8
+
+static unsigned char bench_src[BENCH_BUF + 8] __attribute__((aligned(4)));
+static unsigned char bench_dst[BENCH_BUF + 8] __attribute__((aligned(4)));
+
+// Nedre 32 bitarna av cykelräknaren räcker, skillnaden blir rätt även vid
+// överslag så länge en mätning tar under 2^32 cykler.
+static inline unsigned int read_mcycle(void) {
+    return (unsigned int)hal_cycles();
+}
+
+// Referens: den gamla byte-för-byte-loopen
+static __attribute__((noinline, optimize("no-tree-loop-distribute-patterns")))
+void byte_copy(unsigned char* d, const unsigned char* s, unsigned int n) {
+    while (n--) *d++ = *s++;
+}
+
+typedef enum {
+    BENCH_BYTES,
+    BENCH_MEMCPY,
+    BENCH_MEMMOVE,
+    BENCH_MEMSET
+} bench_op_t;
+
+static const char* const bench_names[] = { "bytes  ", "memcpy ", "memmove", "memset " };
+
+static unsigned int bench_run(bench_op_t op, unsigned int dst_off, unsigned int src_off, unsigned int n) {
+    unsigned char* d = bench_dst + dst_off;
+    const unsigned char* s = bench_src + src_off;
+
+    unsigned int start = read_mcycle();
+    for (int r = 0; r < BENCH_REPS; r++) {
+        switch (op) {
+            case BENCH_BYTES:   byte_copy(d, s, n); break;
+            case BENCH_MEMCPY:  memcpy(d, s, n); break;
+            case BENCH_MEMMOVE: memmove(d, s, n); break;
+            case BENCH_MEMSET:  memset(d, r, n); break;
+        }
+    }
+    return read_mcycle() - start;
+}
+
+// Skriver byte/cykel med två decimaler
+static void print_rate(unsigned int bytes, unsigned int cycles) {
+    if (cycles == 0) cycles = 1;
+    unsigned int hundredths = bytes * 100 / cycles; // bytes <= 32768, ingen 64-bitars division
+    print_dec(hundredths / 100);
+    printc('.');
+    printc('0' + (hundredths / 10) % 10);
+    printc('0' + hundredths % 10);
+}
+
+void mem_benchmark(void) {
+    static const unsigned int sizes[] = { 16, 64, 256, 1024, 4096 };
+    // (dst, src)-förskjutning: justerad, dest ojusterad, båda lika ojusterade, olika
+    static const unsigned int offs[][2] = { {0, 0}, {1, 0}, {3, 3}, {2, 1} };
+
+    for (unsigned int i = 0; i < sizeof(bench_src); i++) {
+        bench_src[i] = (unsigned char)i;
+    }
+
+    print("\n--- Memory benchmark (bytes/cycle) ---\n");
+    for (unsigned int o = 0; o < sizeof(offs) / sizeof(offs[0]); o++) {
+        print("dst+");
+        print_dec(offs[o][0]);
+        print(" src+");
+        print_dec(offs[o][1]);
+        print("\n");
+        for (int op = BENCH_BYTES; op <= BENCH_MEMSET; op++) {
+            print("  ");
+            print(bench_names[op]);
+            for (unsigned int k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+                unsigned int n = sizes[k];
+                unsigned int cycles = bench_run((bench_op_t)op, offs[o][0], offs[o][1], n);
+                print("  ");
+                print_dec(n);
+                print(":");
+                print_rate(n * BENCH_REPS, cycles);
+            }
+            print("\n");
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,10 @@
+// membench.h
+#ifndef MEMBENCH_H
+#define MEMBENCH_H
+
+// Mikrobenchmark för memcpy/memmove/memset. Mäter cykler med mcycle och
+// skriver ut byte per cykel för justerade och ojusterade storlekar.
+// Finns bara med -DMEMBENCH; main() kör den då en gång vid start.
+void mem_benchmark(void);
+
+#endif
@@ -1,6 +1,91 @@
 // Jacob
 // string_utils.c (eller i en lämplig källfil)
 #include <stddef.h> // För size_t
+#include <stdint.h> // För uintptr_t
+#include "profile.h"
+
+// Kopiering och fyllning ett 32-bitars ord åt gången, fyra ord per varv.
+// Början och slutet som inte ligger på ordgräns tas byte för byte.
+
+// Ord som får peka in i godtyckliga buffertar
+typedef unsigned int __attribute__((may_alias)) mem_word_t;
+
+// Hindra GCC från att känna igen looparna och ersätta dem med anrop
+// till memcpy/memset, dvs till funktionerna själva.
+#define MEM_NO_PATTERNS __attribute__((optimize("no-tree-loop-distribute-patterns")))
+
+#define MEM_ALIGNED(p) (((uintptr_t)(p) & 3) == 0)
+
+// Kopierar n byte framåt, dest och src har samma läge relativt ordgränsen
+static MEM_NO_PATTERNS void copy_words_fwd(unsigned char* d, const unsigned char* s, size_t n) {
+    while (n && !MEM_ALIGNED(d)) {
+        *d++ = *s++;
+        n--;
+    }
+
+    mem_word_t* dw = (mem_word_t*)d;
+    const mem_word_t* sw = (const mem_word_t*)s;
+    for (; n >= 16; n -= 16) {
+        unsigned int w0 = sw[0], w1 = sw[1], w2 = sw[2], w3 = sw[3];
+        dw[0] = w0;
+        dw[1] = w1;
+        dw[2] = w2;
+        dw[3] = w3;
+        dw += 4;
+        sw += 4;
+    }
+    for (; n >= 4; n -= 4) {
+        *dw++ = *sw++;
+    }
+
+    d = (unsigned char*)dw;
+    s = (const unsigned char*)sw;
+    while (n--) {
+        *d++ = *s++;
+    }
+}
+
+/*
+ * Kopierar när src ligger off = 1..3 byte efter ordgränsen men dest är
+ * ordjusterad. Varje utord sätts ihop av två justerade källord med skift
+ * (little endian). Läser aldrig byte utanför källbufferten.
+ */
+static MEM_NO_PATTERNS void copy_shifted_fwd(unsigned char* d, const unsigned char* s, size_t n) {
+    while (n && !MEM_ALIGNED(d)) {
+        *d++ = *s++;
+        n--;
+    }
+
+    unsigned int off = (uintptr_t)s & 3;
+    if (off == 0 || n < 8) {
+        while (n--) *d++ = *s++;
+        return;
+    }
+
+    unsigned int lo = off * 8;
+    unsigned int hi = 32 - lo;
+    mem_word_t* dw = (mem_word_t*)d;
+    const mem_word_t* sw = (const mem_word_t*)(s - off + 4);
+
+    // Första källordet byggs av de byte som faktiskt hör till src
+    unsigned int cur = 0;
+    for (unsigned int i = 0; i < 4 - off; i++) {
+        cur |= (unsigned int)s[i] << (lo + 8 * i);
+    }
+
+    // Sista hela utordet behöver källordet efter, som måste finnas i bufferten
+    for (; n >= 4 + (4 - off); n -= 4) {
+        unsigned int next = *sw++;
+        *dw++ = (cur >> lo) | (next << hi);
+        cur = next;
+    }
+
+    d = (unsigned char*)dw;
+    s = (const unsigned char*)sw - 4 + off;
+    while (n--) {
+        *d++ = *s++;
+    }
+}
 
 /**
  * En enkel implementering av memcpy för inbyggda system
@@ -9,18 +94,87 @@
 void* memcpy(void* restrict dest, const void* restrict src, size_t n) {
     unsigned char* d = dest;
     const unsigned char* s = src;
-    
-    // Kopiera byte för byte
+
+    PROF_BEGIN(PROF_MEMCPY);
+    if ((((uintptr_t)d ^ (uintptr_t)s) & 3) == 0) {
+        copy_words_fwd(d, s, n);
+    } else {
+        copy_shifted_fwd(d, s, n);
+    }
+    PROF_END(PROF_MEMCPY);
+    return dest;
+}
+
+/**
+ * memmove: som memcpy men tillåter överlapp. När dest ligger före src
+ * kopieras framåt (varje block läses innan det skrivs), annars bakifrån.
+ */
+MEM_NO_PATTERNS void* memmove(void* dest, const void* src, size_t n) {
+    unsigned char* d = dest;
+    const unsigned char* s = src;
+
+    if (d == s || n == 0) return dest;
+
+    if (d + n <= s || s + n <= d) {
+        return memcpy(dest, src, n);
+    }
+
+    if (d < s) {
+        if ((((uintptr_t)d ^ (uintptr_t)s) & 3) == 0) {
+            copy_words_fwd(d, s, n);
+        } else {
+            while (n--) *d++ = *s++;
+        }
+        return dest;
+    }
+
+    // Bakifrån, ordvis om dest och src ligger lika mot ordgränsen
+    d += n;
+    s += n;
+    if ((((uintptr_t)d ^ (uintptr_t)s) & 3) == 0) {
+        while (n && !MEM_ALIGNED(d)) {
+            *--d = *--s;
+            n--;
+        }
+        mem_word_t* dw = (mem_word_t*)d;
+        const mem_word_t* sw = (const mem_word_t*)s;
+        for (; n >= 4; n -= 4) {
+            *--dw = *--sw;
+        }
+        d = (unsigned char*)dw;
+        s = (const unsigned char*)sw;
+    }
     while (n--) {
-        *d++ = *s++;
+        *--d = *--s;
     }
     return dest;
 }
 
-void *memset(void *s, int c, unsigned int n) {
+MEM_NO_PATTERNS void *memset(void *s, int c, size_t n) {
     unsigned char *p = (unsigned char *)s;
+    unsigned char b = (unsigned char)c;
+
+    while (n && !MEM_ALIGNED(p)) {
+        *p++ = b;
+        n--;
+    }
+
+    unsigned int w = b * 0x01010101u;
+    mem_word_t* pw = (mem_word_t*)p;
+    for (; n >= 16; n -= 16) {
+        pw[0] = w;
+        pw[1] = w;
+        pw[2] = w;
+        pw[3] = w;
+        pw += 4;
+    }
+    for (; n >= 4; n -= 4) {
+        *pw++ = w;
+    }
+
+    p = (unsigned char*)pw;
     while (n--) {
-        *p++ = (unsigned char)c;
+        *p++ = b;
     }
     return s;
-}
\ No newline at end of file
+}
@@ -1,9 +1,22 @@
 // Jacob
 // menu.c
 #include "menu.h"
+#include "gauss_iir.h"
+#include "rankfilter.h"
 #include "main.h"
 #include "dtekv-lib.h" // för print/debug
 
+// Radier för stor box blur, valda med SW[9:7] (7 ger 15x15, 15 ger 31x31)
+static const int large_radius[8] = { 1, 2, 3, 5, 7, 10, 15, 31 };
+
+// Sigma för rekursiv Gauss (gauss_iir.h), samma switchar
+static const int large_sigma[8] = { 1, 2, 3, 4, 6, 10, 15, 20 };
+
+// Rangfilter (rankfilter.h) med Edge eller Sharpen valt: radie från
+// SW[9:7], percentil från SW[1:0] och SW[2] (index SW[2] * 4 + SW[1:0])
+static const int rank_radius[8] = { 1, 2, 3, 4, 5, 7, 10, 15 };
+static const int rank_percentile[8] = { RANK_MEDIAN, -1, -1, RANK_MIN, 25, -1, -1, RANK_MAX };
+
 // Meny med standardvärden
 void menu_init(menu_state_t* state) {
     state->kernel_selected = KERNEL_EDGE;
@@ -11,6 +24,12 @@ void menu_init(menu_state_t* state) {
     state->run_mode = 0;
     state->reset = 0;
     state->chain_mode = 0;
+    state->large_mode = 0;
+    state->radius = 1;
+    state->sigma = GAUSS_IIR_SIGMA_ONE;
+    state->rank = -1;
+    state->rank_radius = 1;
+    state->custom = 0;
 
 }
 
@@ -32,6 +51,19 @@ void menu_update(menu_state_t* state, int switches, int btn) {
     // Kedjeläge: SW[4] (0 = Single, 1 = Chain)
     state->chain_mode = (switches & 0x10) ? 1 : 0;
 
+    // Stor box blur eller rekursiv Gauss: SW[5], radie/sigma från SW[9:7]
+    state->large_mode = (switches & 0x20) ? 1 : 0;
+    state->radius = large_radius[(switches >> 7) & 0x7];
+    state->sigma = large_sigma[(switches >> 7) & 0x7] * GAUSS_IIR_SIGMA_ONE;
+
+    // Rangfilter: SW[5] med Edge (median, SW[2]: 25:e percentilen) eller
+    // Sharpen (minimum, SW[2]: maximum)
+    state->rank = state->large_mode ? rank_percentile[switches & 0x7] : -1;
+    state->rank_radius = rank_radius[(switches >> 7) & 0x7];
+
+    // Egen kernel (kernels_plan.h): samma switchar när SW[5] är av
+    state->custom = state->large_mode ? 0 : (switches >> 7) & 0x7;
+
     // Reset: switches 6 (håll nere för reset)
     state->reset = (switches & 0x40) ? 1 : 0;
 
@@ -46,9 +78,15 @@ void menu_show(const menu_state_t* state) {
     led_mask |= (state->kernel_size == 5) << 2;      // LED 2: kernelstorlek
     led_mask |= (state->run_mode) << 3;              // LED 3: run mode
     led_mask |= (state->chain_mode) << 4;                // LED 4: upload
+    led_mask |= (state->large_mode) << 5;            // LED 5: stor box blur / rekursiv Gauss / rangfilter
     //led_mask |= (state->download) << 5;              // LED 5: download
     led_mask |= (state->reset) << 6;                 // LED 6: reset
+    led_mask |= (state->custom) << 7;                // LED 7-9: egen kernel
 
-    // Anropa LED-funktion
-    set_leds(led_mask);
+    // Skriv till lysdioderna via hal.h, bara när något ändrats
+    static int shown = -1;
+    if (led_mask != shown) {
+        hal_write_leds(led_mask);
+        shown = led_mask;
+    }
 }
\ No newline at end of file
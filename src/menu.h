@@ -12,6 +12,12 @@ typedef struct menu_state_t {
     int run_mode;                  // 1 = Process image, 0 = idle
     int reset;                     // 1 = reset
     int chain_mode;                // 1 = Chain mode är aktivt
+    int large_mode;                // 1 = Stor box blur, rekursiv Gauss eller rangfilter (SW[5])
+    int radius;                    // Radie för stor box blur, från SW[9:7]
+    int sigma;                     // Sigma för rekursiv Gauss i 1/256 pixlar, från SW[9:7]
+    int rank;                      // Rangfiltrets percentil 0-100, -1 = inget rangfilter
+    int rank_radius;               // Radie för rangfiltret, från SW[9:7]
+    int custom;                    // Egen kernel 1-7 från SW[9:7] när SW[5] är av, 0 = ingen
 
 } menu_state_t;
 
@@ -21,7 +27,8 @@ void menu_init(menu_state_t* state);
 // Uppdatera meny baserat på toggles och knappar
 void menu_update(menu_state_t* state, int switches, int btn);
 
-// Visa meny/status på LED eller display
+// Visa meny/status på LED eller display. Lysdioderna skrivs bara om när
+// mönstret ändras.
 void menu_show(const menu_state_t* state);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,278 @@
+// packed.c
+// Packade bilder som avkodas rad för rad.
+//
+// Format: 8 bytes huvud ('P', 'K', bredd och höjd som 16 bitar little
+// endian, version 1, 0) och sedan raderna i ordning. Varje pixel lagras som
+// skillnaden mot en prediktion ur redan avkodade grannar:
+//
+//   pred = (vänster + ovanför) / 2   (vänster = ovanför i kolumn 0,
+//                                      ovanför = 0 på rad 0)
+//
+// Skillnaderna (mod 256) kodas med tre sorters token, som aldrig går
+// över en radgräns:
+//
+//   00nnnnnn             n+1 pixlar med skillnad 0 (RLE)
+//   01nnnnnn + bytes     n+1 skillnader i [-8,7], två per byte, låg nibble först
+//   1nnnnnnn + bytes     n+1 skillnader som hela bytes
+//
+// Kattbilden blir ungefär 40 KiB i stället för 64 KiB. Avkodningen har
+// ingen division och behöver bara raden ovanför, så den kan matas rakt in
+// i konvolutionens radfönster.
+#include "packed.h"
+#include "chain.h"
+#include "profile.h"
+#include <stddef.h>
+#include <string.h>
+
+#define PACKED_VERSION 1
+
+// Avkodade rader för packed_source_row(). Rad r ligger på plats
+// r % KERNEL_MAX_SIZE; ett kernelfönster ryms alltid.
+static CONV_SCRATCH unsigned char packed_ring[KERNEL_MAX_SIZE][PACKED_MAX_WIDTH] __attribute__((aligned(4)));
+
+int packed_open(packed_reader_t* rd, const unsigned char* data) {
+    if (data[0] != 'P' || data[1] != 'K' || data[6] != PACKED_VERSION) return 0;
+    rd->width = data[2] | (data[3] << 8);
+    rd->height = data[4] | (data[5] << 8);
+    rd->pos = data + PACKED_HEADER_SIZE;
+    rd->next_row = 0;
+    return rd->width > 0 && rd->width <= PACKED_MAX_WIDTH && rd->height > 0;
+}
+
+/*
+ * Funktion: packed_read_row
+ * -------------------------
+ * Med left = prev[0] från början ger (left + prev[x]) >> 1 rätt prediktion
+ * även i kolumn 0. prev[x] läses innan out[x] skrivs, så raden kan
+ * avkodas ovanpå föregående rad.
+ */
+void packed_read_row(packed_reader_t* rd, unsigned char* out, const unsigned char* prev) {
+    const unsigned char* p = rd->pos;
+    int width = rd->width;
+    int left = prev[0];
+    int x = 0;
+
+    PROF_BEGIN(PROF_UNPACK);
+    while (x < width) {
+        int t = *p++;
+        if (t & 0x80) {
+            int end = x + (t & 0x7f) + 1;
+            for (; x < end; x++) {
+                left = (unsigned char)(((left + prev[x]) >> 1) + *p++);
+                out[x] = left;
+            }
+        } else if (t & 0x40) {
+            int end = x + (t & 0x3f) + 1;
+            while (x < end) {
+                int b = *p++;
+                left = (unsigned char)(((left + prev[x]) >> 1) + ((b & 15) ^ 8) - 8);
+                out[x++] = left;
+                if (x == end) break;
+                left = (unsigned char)(((left + prev[x]) >> 1) + ((b >> 4) ^ 8) - 8);
+                out[x++] = left;
+            }
+        } else {
+            int end = x + t + 1;
+            for (; x < end; x++) {
+                left = (left + prev[x]) >> 1;
+                out[x] = left;
+            }
+        }
+    }
+    PROF_END(PROF_UNPACK);
+
+    rd->pos = p;
+    rd->next_row++;
+}
+
+const unsigned char* packed_source_row(packed_reader_t* rd, int iy, border_mode_t border) {
+    int i = conv_border_index(iy, rd->height, border);
+    if (i < 0) return conv_zero_row;
+    while (rd->next_row <= i) {
+        int r = rd->next_row;
+        const unsigned char* prev = r > 0 ? packed_ring[(r - 1) % KERNEL_MAX_SIZE] : conv_zero_row;
+        packed_read_row(rd, packed_ring[r % KERNEL_MAX_SIZE], prev);
+    }
+    return packed_ring[i % KERNEL_MAX_SIZE];
+}
+
+void packed_decode(const unsigned char* packed, unsigned char* output) {
+    packed_reader_t rd;
+    if (!packed_open(&rd, packed)) return;
+    const unsigned char* prev = conv_zero_row;
+    for (int y = 0; y < rd.height; y++) {
+        unsigned char* row = output + y * rd.width;
+        packed_read_row(&rd, row, prev);
+        prev = row;
+    }
+}
+
+void convolve_packed_rows(packed_reader_t* rd, unsigned char* output, int y0, int y1, const conv_kernel_t* k, border_mode_t border) {
+    int c = k->ksize / 2;
+    const unsigned char* src[KERNEL_MAX_SIZE];
+    PROF_BEGIN(PROF_CONVOLVE);
+    for (int y = y0; y < y1; y++) {
+        for (int ky = 0; ky < k->ksize; ky++) {
+            src[ky] = packed_source_row(rd, y + ky - c, border);
+        }
+        convolve_row(src, output + y * rd->width, rd->width, k, border);
+    }
+    PROF_END(PROF_CONVOLVE);
+}
+
+int convolve_packed(const unsigned char* packed, unsigned char* output, const conv_kernel_t* k, const conv_options_t* opts) {
+    border_mode_t border = opts ? opts->border : BORDER_ZERO;
+    packed_reader_t rd;
+    if (!packed_open(&rd, packed) || border == BORDER_WRAP ||
+        rd.width > PACKED_MAX_WIDTH || k->ksize > KERNEL_MAX_SIZE) {
+        return 0;
+    }
+    convolve_packed_rows(&rd, output, 0, rd.height, k, border);
+    return 1;
+}
+
+/*
+ * Funktion: packed_row_length
+ * ---------------------------
+ * Går igenom tokens utan att avkoda: varje token anger hur många pixlar
+ * och bytes den tar, så en rad som skulle läsa utanför data eller skriva
+ * utanför out upptäcks innan packed_read_row() körs.
+ */
+int packed_row_length(const unsigned char* data, int avail, int width) {
+    int x = 0;
+    int i = 0;
+    while (x < width) {
+        if (i >= avail) return 0;
+        int t = data[i++];
+        int n = (t & 0x80) ? (t & 0x7f) + 1 : (t & 0x3f) + 1;
+        x += n;
+        if (t & 0x80) i += n;
+        else if (t & 0x40) i += (n + 1) / 2;
+    }
+    return x == width && i <= avail ? i : 0;
+}
+
+int packed_decode_row(const unsigned char* data, int len, int width, unsigned char* out, const unsigned char* prev) {
+    if (packed_row_length(data, len, width) != len) return 0;
+
+    packed_reader_t rd;
+    rd.pos = data;
+    rd.width = width;
+    rd.height = 1;
+    rd.next_row = 0;
+    packed_read_row(&rd, out, prev);
+    return 1;
+}
+
+int convolve_chain_packed(const unsigned char* packed, unsigned char* output, const conv_kernel_t* k1, const conv_kernel_t* k2, const conv_options_t* opts) {
+    chain_plan_t plan;
+    chain_plan(&plan, k1, k2, opts);
+    if (plan.mode == CHAIN_FUSED) {
+        return convolve_packed(packed, output, &plan.fused, opts);
+    }
+
+    packed_reader_t rd;
+    chain_state_t st;
+    if (!packed_open(&rd, packed) || rd.width > PACKED_MAX_WIDTH ||
+        !chain_init(&st, NULL, output, rd.width, rd.height, k1, k2, opts)) {
+        return 0;
+    }
+    st.packed = &rd;
+    chain_step(&st, rd.height);
+    return 1;
+}
+
+static int is_small(int r) {
+    return r >= -8 && r < 8;
+}
+
+// Antal nollor i följd från res[i], högst 64
+static int zero_run(const signed char* res, int i, int n) {
+    int j = i;
+    while (j < n && j - i < 64 && res[j] == 0) j++;
+    return j - i;
+}
+
+static unsigned char* encode_row(const signed char* res, int n, unsigned char* out) {
+    int i = 0;
+    while (i < n) {
+        int run = zero_run(res, i, n);
+        if (run >= 3) {
+            *out++ = (unsigned char)(run - 1);
+            i += run;
+        } else if (is_small(res[i])) {
+            // Små skillnader, men bryt före en nollsekvens som lönar sig som RLE
+            int j = i + 1;
+            while (j < n && j - i < 64 && is_small(res[j]) && zero_run(res, j, n) < 3) j++;
+            *out++ = (unsigned char)(0x40 | (j - i - 1));
+            for (int x = i; x < j; x += 2) {
+                int hi = x + 1 < j ? res[x + 1] & 15 : 0;
+                *out++ = (unsigned char)((res[x] & 15) | (hi << 4));
+            }
+            i = j;
+        } else {
+            // Hela bytes; en ensam liten skillnad mellan två stora tas med
+            int j = i + 1;
+            while (j < n && j - i < 128 &&
+                   (!is_small(res[j]) || (j + 1 < n && !is_small(res[j + 1])))) {
+                j++;
+            }
+            *out++ = (unsigned char)(0x80 | (j - i - 1));
+            for (int x = i; x < j; x++) *out++ = (unsigned char)res[x];
+            i = j;
+        }
+    }
+    return out;
+}
+
+int packed_encode_row(const unsigned char* row, const unsigned char* prev, int width, unsigned char* out) {
+    static CONV_SCRATCH signed char res[PACKED_MAX_WIDTH];
+    static CONV_SCRATCH unsigned char row_buf[2 * PACKED_MAX_WIDTH]; // högst 2 bytes per pixel
+    unsigned char* p = out;
+
+    int left = prev[0];
+    for (int x = 0; x < width; x++) {
+        res[x] = (signed char)(row[x] - ((left + prev[x]) >> 1));
+        left = row[x];
+    }
+    // Brusiga rader kan bli större än hela bytes rakt av; ta då det
+    int n = (int)(encode_row(res, width, row_buf) - row_buf);
+    if (n <= PACKED_ROW_BOUND(width)) {
+        memcpy(p, row_buf, n);
+        return n;
+    }
+    for (int x = 0; x < width; x += 128) {
+        int len = width - x < 128 ? width - x : 128;
+        *p++ = (unsigned char)(0x80 | (len - 1));
+        for (int i = 0; i < len; i++) *p++ = (unsigned char)res[x + i];
+    }
+    return (int)(p - out);
+}
+
+#ifdef HOST
+
+int packed_bound(int width, int height) {
+    return PACKED_HEADER_SIZE + height * PACKED_ROW_BOUND(width);
+}
+
+int packed_encode(const unsigned char* input, int width, int height, unsigned char* out) {
+    unsigned char* p = out;
+    if (width > PACKED_MAX_WIDTH || width > 65535 || height > 65535) return 0;
+
+    *p++ = 'P';
+    *p++ = 'K';
+    *p++ = (unsigned char)width;
+    *p++ = (unsigned char)(width >> 8);
+    *p++ = (unsigned char)height;
+    *p++ = (unsigned char)(height >> 8);
+    *p++ = PACKED_VERSION;
+    *p++ = 0;
+
+    for (int y = 0; y < height; y++) {
+        const unsigned char* row = input + (size_t)y * width;
+        p += packed_encode_row(row, y > 0 ? row - width : conv_zero_row, width, p);
+    }
+    return (int)(p - out);
+}
+
+#endif
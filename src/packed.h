@@ -0,0 +1,76 @@
+// packed.h
+#ifndef PACKED_H
+#define PACKED_H
+
+#include "kernels.h"
+
+// Packad gråskalebild (se packed.c för formatet). Avkodas en rad i taget,
+// så en hel uppackad kopia behöver aldrig finnas.
+#define PACKED_HEADER_SIZE 8
+
+// Bredaste bild som kan strömmas ur packat format
+#define PACKED_MAX_WIDTH CONV_MAX_WIDTH
+
+typedef struct {
+    const unsigned char* pos;  // Nästa token
+    int width, height;
+    int next_row;              // Nästa rad som avkodas
+} packed_reader_t;
+
+// Läser huvudet. Returnerar 0 om data inte är en packad bild eller om den
+// är bredare än PACKED_MAX_WIDTH.
+int packed_open(packed_reader_t* rd, const unsigned char* data);
+
+// Avkodar nästa rad till out. prev är föregående rad (conv_zero_row för
+// rad 0) och får vara samma buffert som out.
+void packed_read_row(packed_reader_t* rd, unsigned char* out, const unsigned char* prev);
+
+// Källrad iy enligt kantläget, avkodad vid behov. Raderna måste efterfrågas
+// i stort sett i ordning: högst KERNEL_MAX_SIZE rader bakom den senast
+// avkodade, som när en kernel glider nedåt över bilden. Inte BORDER_WRAP,
+// och högst PACKED_MAX_WIDTH bred.
+const unsigned char* packed_source_row(packed_reader_t* rd, int iy, border_mode_t border);
+
+// Avkodar hela bilden till output (width * height bytes)
+void packed_decode(const unsigned char* packed, unsigned char* output);
+
+// Convolution direkt ur en packad bild; varje rad avkodas när kerneln
+// först behöver den. Samma resultat som convolve_kernel() på den uppackade
+// bilden. Returnerar 0 vid BORDER_WRAP eller bredare än PACKED_MAX_WIDTH.
+int convolve_packed(const unsigned char* packed, unsigned char* output, const conv_kernel_t* k, const conv_options_t* opts);
+
+// Utrader y0..y1-1 ur en packad bild som öppnats med packed_open(). Anropen
+// måste komma i ordning (y0 = föregående y1), så att ett jobb kan köras en
+// bit i taget; samma krav på kantläge och bredd som convolve_packed().
+void convolve_packed_rows(packed_reader_t* rd, unsigned char* output, int y0, int y1, const conv_kernel_t* k, border_mode_t border);
+
+// Kedja av två kernels där steg 1 läser direkt ur en packad bild.
+// Samma resultat som convolve_chain() på den uppackade bilden. Returnerar 0
+// i samma fall som convolve_packed() och chain_init().
+int convolve_chain_packed(const unsigned char* packed, unsigned char* output, const conv_kernel_t* k1, const conv_kernel_t* k2, const conv_options_t* opts);
+
+// Största storlek på en packad rad: hela bytes, en token per 128 pixlar
+#define PACKED_ROW_BOUND(width) ((width) + ((width) + 127) / 128)
+
+// Packar en rad med prev som raden ovanför (conv_zero_row för rad 0).
+// out måste rymma PACKED_ROW_BOUND(width) bytes; högst PACKED_MAX_WIDTH
+// bred. Returnerar antalet skrivna bytes.
+int packed_encode_row(const unsigned char* row, const unsigned char* prev, int width, unsigned char* out);
+
+// Antal bytes som raden i början av data tar, med högst avail bytes att
+// läsa. 0 om tokens inte täcker exakt width pixlar inom avail bytes.
+int packed_row_length(const unsigned char* data, int avail, int width);
+
+// Avkodar en packad rad om len bytes, t.ex. mottagen över UART. Till skillnad
+// från packed_read_row() kontrolleras data först: 0 om tokens inte täcker
+// exakt width pixlar på exakt len bytes.
+int packed_decode_row(const unsigned char* data, int len, int width, unsigned char* out, const unsigned char* prev);
+
+#ifdef HOST
+// Packar en bild. out måste rymma packed_bound(width, height) bytes.
+// Returnerar antalet skrivna bytes.
+int packed_encode(const unsigned char* input, int width, int height, unsigned char* out);
+int packed_bound(int width, int height);
+#endif
+
+#endif
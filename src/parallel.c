@@ -0,0 +1,195 @@
+// parallel.c
+// Arbetsstöld över radband med pthreads. Bara för värdbygget.
+#include "parallel.h"
+
+#ifdef HOST
+
+#include <pthread.h>
+#include <unistd.h>
+#include "chain.h"
+
+#define PAR_MAX_THREADS 64
+
+// Varje tråds kö är ett intervall [lo, hi) av bandnummer, packat i ett
+// 64-bitars ord så att både ägaren (tar från lo) och tjuvar (tar från hi)
+// kan uppdatera det med en enda compare-and-swap.
+typedef struct {
+    unsigned long long range;
+    char pad[56]; // egen cacherad per kö
+} par_queue_t;
+
+typedef struct par_job par_job_t;
+typedef void (*par_band_fn)(par_job_t* job, int y0, int y1);
+
+struct par_job {
+    const image_t* src;
+    image_t* dst;
+    const conv_kernel_t* k1;
+    const conv_kernel_t* k2;
+    const conv_options_t* opts;
+    par_band_fn run;
+    int band_rows;
+    int bands;
+    int threads;
+    par_queue_t queues[PAR_MAX_THREADS];
+};
+
+typedef struct {
+    par_job_t* job;
+    int id;
+} par_worker_t;
+
+#define RANGE(lo, hi) (((unsigned long long)(unsigned int)(lo) << 32) | (unsigned int)(hi))
+#define RANGE_LO(r) ((int)((r) >> 32))
+#define RANGE_HI(r) ((int)((r) & 0xFFFFFFFFu))
+
+// Tar första bandet ur egen kö, -1 om tom
+static int par_pop(par_queue_t* q) {
+    unsigned long long r = __atomic_load_n(&q->range, __ATOMIC_ACQUIRE);
+    while (RANGE_LO(r) < RANGE_HI(r)) {
+        if (__atomic_compare_exchange_n(&q->range, &r, RANGE(RANGE_LO(r) + 1, RANGE_HI(r)),
+                                        0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return RANGE_LO(r);
+        }
+    }
+    return -1;
+}
+
+// Stjäl sista bandet ur en annan kö, -1 om tom
+static int par_steal(par_queue_t* q) {
+    unsigned long long r = __atomic_load_n(&q->range, __ATOMIC_ACQUIRE);
+    while (RANGE_LO(r) < RANGE_HI(r)) {
+        if (__atomic_compare_exchange_n(&q->range, &r, RANGE(RANGE_LO(r), RANGE_HI(r) - 1),
+                                        0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return RANGE_HI(r) - 1;
+        }
+    }
+    return -1;
+}
+
+// Offret med flest band kvar, -1 om alla köer är tomma
+static int par_victim(par_job_t* job, int self) {
+    int best = -1, most = 0;
+    for (int i = 0; i < job->threads; i++) {
+        if (i == self) continue;
+        unsigned long long r = __atomic_load_n(&job->queues[i].range, __ATOMIC_RELAXED);
+        int left = RANGE_HI(r) - RANGE_LO(r);
+        if (left > most) {
+            most = left;
+            best = i;
+        }
+    }
+    return best;
+}
+
+static void* par_worker(void* arg) {
+    par_worker_t* w = arg;
+    par_job_t* job = w->job;
+
+    for (;;) {
+        int band = par_pop(&job->queues[w->id]);
+        if (band < 0) {
+            int victim = par_victim(job, w->id);
+            if (victim < 0) break;
+            band = par_steal(&job->queues[victim]);
+            if (band < 0) continue;
+        }
+        int y0 = band * job->band_rows;
+        int y1 = y0 + job->band_rows < job->dst->height ? y0 + job->band_rows : job->dst->height;
+        job->run(job, y0, y1);
+    }
+    return NULL;
+}
+
+// Fördelar banden jämnt över köerna och kör dem. Tråd 0 är anroparen.
+static void par_run(par_job_t* job, int threads) {
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1) threads = 1;
+    if (threads > PAR_MAX_THREADS) threads = PAR_MAX_THREADS;
+
+    int height = job->dst->height;
+    job->band_rows = PAR_BAND_ROWS;
+    // Minst fyra band per tråd så att stölderna har något att jämna ut
+    while (job->band_rows > 8 && (height + job->band_rows - 1) / job->band_rows < 4 * threads) {
+        job->band_rows /= 2;
+    }
+    job->bands = (height + job->band_rows - 1) / job->band_rows;
+    if (threads > job->bands) threads = job->bands;
+    job->threads = threads;
+
+    for (int i = 0; i < threads; i++) {
+        int lo = (int)((long long)job->bands * i / threads);
+        int hi = (int)((long long)job->bands * (i + 1) / threads);
+        job->queues[i].range = RANGE(lo, hi);
+    }
+
+    pthread_t tid[PAR_MAX_THREADS];
+    par_worker_t workers[PAR_MAX_THREADS];
+    int started = 1;
+    for (int i = 0; i < threads; i++) {
+        workers[i].job = job;
+        workers[i].id = i;
+    }
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&tid[i], NULL, par_worker, &workers[i]) != 0) break;
+        started++;
+    }
+    // Startades inte alla trådar tar de andra deras band genom stöld
+    par_worker(&workers[0]);
+    for (int i = 1; i < started; i++) {
+        pthread_join(tid[i], NULL);
+    }
+}
+
+static void par_convolve_band(par_job_t* job, int y0, int y1) {
+    rect_t band = { 0, y0, job->dst->width, y1 - y0 };
+    convolve_image(job->src, job->dst, job->k1, &band, job->opts);
+}
+
+void convolve_parallel(const image_t* src, image_t* dst, const conv_kernel_t* k, const conv_options_t* opts, int threads) {
+    if (src->width != dst->width || src->height != dst->height || dst->height <= 0) return;
+
+    par_job_t job = { 0 };
+    job.src = src;
+    job.dst = dst;
+    job.k1 = k;
+    job.opts = opts;
+    job.run = par_convolve_band;
+    par_run(&job, threads);
+}
+
+static void par_chain_band(par_job_t* job, int y0, int y1) {
+    chain_state_t st;
+    chain_init(&st, job->src->data, job->dst->data, job->src->width, job->src->height, job->k1, job->k2, job->opts);
+    chain_seek(&st, y0);
+    chain_step(&st, y1 - y0);
+}
+
+int convolve_chain_parallel(const image_t* src, image_t* dst, const conv_kernel_t* k1, const conv_kernel_t* k2, const conv_options_t* opts, int threads) {
+    if (src->width != dst->width || src->height != dst->height || dst->height <= 0) return 0;
+    if (src->stride != src->width || dst->stride != dst->width) return 0;
+
+    chain_plan_t plan;
+    chain_plan(&plan, k1, k2, opts);
+    if (plan.mode == CHAIN_FUSED) {
+        convolve_parallel(src, dst, &plan.fused, opts, threads);
+        return 1;
+    }
+
+    chain_state_t st;
+    if (!chain_init(&st, src->data, dst->data, src->width, src->height, k1, k2, opts)) {
+        return 0;
+    }
+
+    par_job_t job = { 0 };
+    job.src = src;
+    job.dst = dst;
+    job.k1 = k1;
+    job.k2 = k2;
+    job.opts = opts;
+    job.run = par_chain_band;
+    par_run(&job, threads);
+    return 1;
+}
+
+#endif
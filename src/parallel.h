@@ -0,0 +1,24 @@
+// parallel.h
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "image.h"
+
+// Flertrådad konvolution för värdbygget (make host). Bilden delas i
+// radband som trådarna tar från varsin kö och stjäl från varandra när
+// den egna är tom. Finns inte i firmwaren.
+
+// Rader per band (minst; fler om bilden är hög jämfört med antal trådar)
+#define PAR_BAND_ROWS 32
+
+// threads <= 0 ger en tråd per processorkärna. Resultatet är bit för bit
+// detsamma som convolve_kernel() på hela bilden.
+void convolve_parallel(const image_t* src, image_t* dst, const conv_kernel_t* k, const conv_options_t* opts, int threads);
+
+// Kedja k1 -> k2 med samma plan som convolve_chain(). Varje band körs som
+// en egen strömmad kedja (mellanraderna i bandets apron räknas två gånger),
+// så det blir ingen global barriär mellan stegen. src och dst måste vara
+// packade (stride == width). Returnerar 0 om kedjan inte kan strömmas.
+int convolve_chain_parallel(const image_t* src, image_t* dst, const conv_kernel_t* k1, const conv_kernel_t* k2, const conv_options_t* opts, int threads);
+
+#endif
@@ -0,0 +1,597 @@
+// process.c
+// Bildbehandlingskärnan: bildbuffertarna och filtren som menyn väljer.
+// Ingen hårdvaruåtkomst här, så filen byggs både för kortet och för
+// värddatorn (make host).
+#include <string.h>
+#include "dtekv-lib.h"
+#include "main.h"
+#include "process.h"
+#include "boxfilter.h"
+#include "chain.h"
+#include "gauss_iir.h"
+#include "kernels_plan.h"
+#include "packed.h"
+#include "rankfilter.h"
+#include "cache.h"
+#include "profile.h"
+
+// Den inbyggda bilden. Standard är C-arrayen i cat_image.h; med
+// make IMAGE=incbin eller IMAGE=packed länkas filen in av image_data.S.
+#if defined(IMAGE_INCBIN) || defined(IMAGE_PACKED)
+extern const unsigned char image_data[];
+#define BUILTIN_IMAGE image_data
+#else
+#include "cat_image.h"
+#define BUILTIN_IMAGE (&cat_img[0][0])
+#endif
+
+// ===========================================================
+// Globala bildbuffertar
+// ===========================================================
+
+// Definierade i main.h, men allokerade här.
+// Ordjusterade så att blur-rutinerna kan läsa och skriva fyra pixlar åt gången.
+
+unsigned char output_img[IMG_HEIGHT][IMG_WIDTH] __attribute__((aligned(4)));
+unsigned char input_img[IMG_HEIGHT][IMG_WIDTH] __attribute__((aligned(4)));
+unsigned char temp_img[IMG_HEIGHT][IMG_WIDTH] __attribute__((aligned(4)));
+
+// Bilden som filtren läser från. Pekar på den inbyggda bilden tills
+// någon behöver skriva i indata, då kopieras den till input_img.
+const unsigned char* image_src = BUILTIN_IMAGE;
+
+unsigned char* result_img = &output_img[0][0];
+
+// Indatans generation i resultatcachens nycklar. 0 är den inbyggda bilden;
+// varje ändring får ett nytt nummer som aldrig återanvänds.
+static unsigned int input_generation;
+static unsigned int generation_counter;
+
+// Kerneln som senast räknade hela output_dst ur image_src, och de delar av
+// indata som ändrats sedan dess. NULL om output_dst kommer från något annat
+// (kedja, stor box blur, rekursiv Gauss, rangfilter, reset); då kan
+// process_dirty() inte användas.
+static const conv_kernel_t* output_kernel;
+static unsigned char* output_dst;
+static rect_t input_dirty;
+
+// Rader av input_img som finns medan den skrivs över rad för rad
+static int input_rows = IMG_HEIGHT;
+
+// Bufferten som en nedladdning läser (process_watch()), och om något har
+// börjat skriva i den sedan dess
+static const unsigned char* watched;
+static int watched_written;
+
+// Anropas innan buf skrivs: ett nytt jobb, en reset, process_dirty() eller
+// ändrad indata
+static void buffer_written(const unsigned char* buf) {
+    if (buf && buf == watched) watched_written = 1;
+}
+
+void process_watch(const unsigned char* buf) {
+    watched = buf;
+    watched_written = 0;
+}
+
+int process_watch_hit(void) {
+    return watched_written;
+}
+
+// Noterar vad som skrevs till dst
+static void output_written(const conv_kernel_t* k, const unsigned char* src, unsigned char* dst) {
+    output_kernel = src == image_src ? k : NULL;
+    output_dst = dst;
+    input_dirty.w = 0;
+    input_dirty.h = 0;
+}
+
+// Det senaste färdiga resultatet. Cachen får inte kasta det.
+static void set_result(unsigned char* img) {
+    result_img = img;
+    cache_pin(img);
+}
+
+// Sant om src är den packade inbyggda bilden, som bara kan läsas rad för
+// rad med packed.c. Alltid falskt utan IMAGE_PACKED.
+static int src_is_packed(const unsigned char* src) {
+#ifdef IMAGE_PACKED
+    return src == image_data;
+#else
+    (void)src;
+    return 0;
+#endif
+}
+
+// Jacob
+// Ger en skrivbar indatabild. Första gången efter start eller reset
+// kopieras originalet till input_img (copy-on-write). En packad bild
+// packas upp dit.
+unsigned char* input_writable(void) {
+    if (image_src != &input_img[0][0]) {
+        buffer_written(&input_img[0][0]);
+        if (src_is_packed(image_src)) {
+            packed_decode(image_src, &input_img[0][0]);
+        } else {
+            memcpy(input_img, image_src, sizeof(input_img));
+        }
+        image_src = &input_img[0][0];
+    }
+    return &input_img[0][0];
+}
+
+// Återställer bilden till originalet och rensar output.
+// Ingen kopiering, källan pekas bara om till den inbyggda bilden.
+void reset_images(void) {
+    process_cancel();
+    image_src = BUILTIN_IMAGE;
+    input_rows = IMG_HEIGHT;
+    input_generation = 0;
+    buffer_written(&output_img[0][0]);
+    memset(output_img, 0, sizeof(output_img));
+    output_written(NULL, NULL, &output_img[0][0]);
+    set_result(&output_img[0][0]);
+    print("Images reset to initial state.\n");
+}
+
+unsigned char* input_begin_rows(void) {
+    process_cancel();
+    buffer_written(&input_img[0][0]);
+    image_src = &input_img[0][0];
+    input_generation = ++generation_counter;
+    input_rows = 0;
+    output_written(NULL, NULL, NULL);
+    return &input_img[0][0];
+}
+
+void input_rows_ready(int rows) {
+    input_rows = rows < IMG_HEIGHT ? rows : IMG_HEIGHT;
+}
+
+void input_mark_dirty(const rect_t* r) {
+    buffer_written(image_src);
+    rect_union(&input_dirty, r);
+    input_generation = ++generation_counter;
+}
+
+/*
+ * Funktion: process_dirty
+ * -----------------------
+ * Räknar om de utpixlar som påverkas av indata markerad med
+ * input_mark_dirty(): den ändrade rektangeln plus kernelns apron (kcenter
+ * pixlar åt varje håll). En ändrad 32x32-bit med Gaussian 5x5 kostar
+ * alltså 36x36 pixlar i stället för 256x256. Returnerar 0 om output_dst
+ * inte kommer från ett enkelt filter på image_src; kör då om hela filtret.
+ * Ligger resultatet i cachen gäller det sedan för den nya generationen.
+ */
+int process_dirty(void) {
+    if (!output_kernel || process_busy()) return 0;
+
+    rect_t r = input_dirty;
+    rect_affected(&r, output_kernel->ksize / 2, IMG_WIDTH, IMG_HEIGHT, BORDER_ZERO);
+    if (!rect_empty(&r)) {
+        buffer_written(output_dst);
+        image_t src, dst;
+        image_init(&src, (unsigned char*)image_src, IMG_WIDTH, IMG_HEIGHT, IMG_WIDTH);
+        image_init(&dst, output_dst, IMG_WIDTH, IMG_HEIGHT, IMG_WIDTH);
+        convolve_image(&src, &dst, output_kernel, &r, NULL);
+    }
+    cache_retag(output_dst, input_generation);
+    input_dirty.w = 0;
+    input_dirty.h = 0;
+    return 1;
+}
+
+// Bygg med -DCHAIN_FUSION=1 för att låta blur -> blur köras som en
+// sammansatt kernel (en pass, men kan skilja 1 från två pass, se chain.c).
+#ifndef CHAIN_FUSION
+#define CHAIN_FUSION 0
+#endif
+
+// ===========================================================
+// Bakgrundsjobb
+// ===========================================================
+
+typedef enum {
+    JOB_IDLE,
+    JOB_BOX,     // Stor box blur, hela bilden i ett steg
+    JOB_GAUSS,   // Rekursiv Gauss, hela bilden i ett steg
+    JOB_RANK,    // Rangfilter, hela bilden i ett steg
+    JOB_KERNEL,  // En kernel, band för band med convolve_image()
+    JOB_PACKED,  // En kernel direkt ur den packade bilden
+    JOB_CHAIN    // Strömmad kedja, chain_step()
+} job_kind_t;
+
+// Det pågående jobbet. Bara ett åt gången: de strömmande vägarna delar
+// statiska radbuffertar (chain.c, packed.c).
+static struct {
+    job_kind_t kind;
+    menu_state_t menu;              // JOB_BOX: radien, JOB_RANK: radie och percentil
+    gauss_iir_t gauss;              // JOB_GAUSS
+    const conv_kernel_t* kernel;    // JOB_KERNEL/JOB_PACKED
+    const conv_kernel_t* result;    // Till output_written(), NULL för kedjor
+    const unsigned char* src;
+    unsigned char* dst;
+    int next_row;
+    chain_state_t chain;
+    chain_plan_t plan;              // Sammansatt kernel vid CHAIN_FUSED
+    packed_reader_t packed;
+
+    // En kedja som inte kan strömmas körs som två jobb via mid
+    // (temp_img, eller en plats i resultatcachen)
+    int has_second;
+    menu_state_t second;
+    unsigned char* mid;
+    unsigned char* final_dst;
+    int stage, stages;              // För process_progress()
+    unsigned int custom_slots;      // Bit n: jobbet använder egen kernel n
+} job;
+
+// Källan för ett jobb. En packad källa öppnas för radvis läsning
+// (*packed = 1); går den inte att öppna används en uppackad kopia.
+static const unsigned char* job_source(const unsigned char* src, int* packed) {
+    *packed = 0;
+    if (!src_is_packed(src)) return src;
+    *packed = packed_open(&job.packed, src);
+    return *packed ? src : input_writable();
+}
+
+// Förbereder ett filter enligt menyn som ett jobb från src till dst
+static int job_filter(const menu_state_t* menu, const unsigned char* src, unsigned char* dst) {
+    int packed;
+    job.custom_slots |= 1u << menu->custom;
+    job.dst = dst;
+    job.next_row = 0;
+
+    // Stor box blur (SW[5]) med godtycklig radie. Den behöver hela bilden,
+    // så en packad källa packas upp till input_img först.
+    if (menu->large_mode && menu->kernel_selected == KERNEL_BOXBLUR) {
+        job.src = src_is_packed(src) ? input_writable() : src;
+        job.menu = *menu;
+        job.result = NULL;
+        job.kind = JOB_BOX;
+        return 1;
+    }
+
+    // Rekursiv Gauss (SW[5] med Gauss vald), likadant hela bilden
+    if (menu->large_mode && menu->kernel_selected == KERNEL_GAUSSIAN) {
+        if (!gauss_iir_init(&job.gauss, menu->sigma)) {
+            print("Error: Unsupported sigma.\n");
+            return 0;
+        }
+        job.src = src_is_packed(src) ? input_writable() : src;
+        job.result = NULL;
+        job.kind = JOB_GAUSS;
+        return 1;
+    }
+
+    // Rangfilter (SW[5] med Edge eller Sharpen), likadant hela bilden
+    if (menu->rank >= 0) {
+        job.src = src_is_packed(src) ? input_writable() : src;
+        job.menu = *menu;
+        job.result = NULL;
+        job.kind = JOB_RANK;
+        return 1;
+    }
+
+    const conv_kernel_t* kernel = get_selected_kernel(menu);
+    if (!kernel) {
+        print("Error: Could not get selected kernel.\n");
+        return 0;
+    }
+    job.src = job_source(src, &packed);
+    job.kernel = kernel;
+    job.result = kernel;
+    job.kind = packed ? JOB_PACKED : JOB_KERNEL;
+    return 1;
+}
+
+// Nollställer inför ett nytt jobb. Utdata är ofullständig tills jobbet är
+// klart, så process_dirty() får inte användas under tiden.
+static void job_begin(unsigned char* dst) {
+    process_cancel();
+    buffer_written(dst);
+    output_written(NULL, NULL, dst);
+    job.has_second = 0;
+    job.stage = 0;
+    job.stages = 1;
+    job.custom_slots = 0;
+}
+
+int process_start(const menu_state_t* menu, const unsigned char* src, unsigned char* dst) {
+    job_begin(dst);
+    return job_filter(menu, src, dst);
+}
+
+// Två filter i följd. Två vanliga kernels strömmas rad för rad utan
+// mellanbild; annars körs två hela pass via temp_img.
+static int job_two_pass(const menu_state_t* first, const menu_state_t* second, const unsigned char* src, unsigned char* mid, unsigned char* dst) {
+    print("Applying first kernel...\n");
+    buffer_written(mid);
+    job.has_second = 1;
+    job.custom_slots |= 1u << second->custom;
+    job.second = *second;
+    job.mid = mid;
+    job.final_dst = dst;
+    job.stages = 2;
+    return job_filter(first, src, mid);
+}
+
+// Två vanliga kernels som en strömmad eller sammansatt kedja från src till
+// dst. Returnerar 1 om jobbet startade, 0 om en kernel saknas och -1 om
+// kedjan måste köras i två pass med en mellanbild.
+static int job_stream_chain(const menu_state_t* first, const menu_state_t* second, const unsigned char* src, unsigned char* dst) {
+    if (!first->large_mode && !second->large_mode) {
+        const conv_kernel_t* k1 = get_selected_kernel(first);
+        const conv_kernel_t* k2 = get_selected_kernel(second);
+        if (!k1 || !k2) {
+            print("Error: Could not get selected kernel.\n");
+            return 0;
+        }
+        conv_options_t opts = { BORDER_ZERO, CHAIN_FUSION };
+        int packed;
+        job.custom_slots |= 1u << first->custom | 1u << second->custom;
+        job.src = job_source(src, &packed);
+        job.dst = dst;
+        job.next_row = 0;
+        job.result = NULL;
+
+        chain_plan(&job.plan, k1, k2, &opts);
+        if (job.plan.mode == CHAIN_FUSED) {
+            print("Chain fused into one kernel\n");
+            job.kernel = &job.plan.fused;
+            job.kind = packed ? JOB_PACKED : JOB_KERNEL;
+            return 1;
+        }
+        if (chain_init(&job.chain, packed ? NULL : job.src, dst, IMG_WIDTH, IMG_HEIGHT, k1, k2, &opts)) {
+            if (packed) job.chain.packed = &job.packed;
+            print("Applying both kernels in one streaming pass...\n");
+            job.kind = JOB_CHAIN;
+            return 1;
+        }
+    }
+    return -1;
+}
+
+int process_start_chain(const menu_state_t* first, const menu_state_t* second, const unsigned char* src, unsigned char* dst) {
+    job_begin(dst);
+    int ok = job_stream_chain(first, second, src, dst);
+    if (ok >= 0) return ok;
+    return job_two_pass(first, second, src, (unsigned char*)temp_img, dst);
+}
+
+// Jobbet är klart: starta andra passet eller anteckna resultatet. Klara
+// platser i resultatcachen börjar ge träffar.
+static void job_finish(void) {
+    if (job.has_second) {
+        job.has_second = 0;
+        job.stage = 1;
+        cache_commit(job.mid);
+        print("Applying second kernel...\n");
+        if (job_filter(&job.second, job.mid, job.final_dst)) return;
+        cache_abort(job.final_dst);
+        job.kind = JOB_IDLE;
+        return;
+    }
+    output_written(job.result, job.src, job.dst);
+    cache_commit(job.dst);
+    set_result(job.dst);
+    job.kind = JOB_IDLE;
+}
+
+// Hur många rader under en utrad jobbet läser i sin källa
+static int job_reach(void) {
+    switch (job.kind) {
+        case JOB_KERNEL:
+        case JOB_PACKED:
+            return job.kernel->ksize / 2;
+        case JOB_CHAIN:
+            return job.chain.k1->ksize / 2 + job.chain.k2->ksize / 2;
+        default:
+            return IMG_HEIGHT;
+    }
+}
+
+/*
+ * Funktion: process_step
+ * ----------------------
+ * Kör upp till max_rows utrader av jobbet. Varje anrop fortsätter där
+ * förra slutade: radindex, kedjans ring och den packade läsaren ligger
+ * kvar i job. En stor box blur, rekursiv Gauss eller ett rangfilter går
+ * inte att dela och körs i ett steg.
+ * Läser jobbet input_img medan den tas emot (input_begin_rows()) körs bara
+ * de utrader vars hela fönster har kommit. Returnerar 1 så länge det
+ * finns mer att göra, även om jobbet just då väntar på rader.
+ */
+int process_step(int max_rows) {
+    if (input_rows < IMG_HEIGHT && job.kind != JOB_IDLE && job.src == &input_img[0][0]) {
+        int ready = input_rows - job_reach() - job.next_row;
+        if (ready <= 0) return 1;
+        if (max_rows > ready) max_rows = ready;
+    }
+
+    int y0 = job.next_row;
+    int y1 = y0 + max_rows < IMG_HEIGHT ? y0 + max_rows : IMG_HEIGHT;
+
+    switch (job.kind) {
+        case JOB_IDLE:
+            return 0;
+
+        case JOB_BOX:
+            PROF_BEGIN(PROF_BOX_FILTER);
+            box_filter(job.src, job.dst, IMG_WIDTH, IMG_HEIGHT, job.menu.radius, BORDER_ZERO);
+            PROF_END(PROF_BOX_FILTER);
+            y1 = IMG_HEIGHT;
+            break;
+
+        case JOB_GAUSS:
+            PROF_BEGIN(PROF_GAUSS_IIR);
+            gauss_iir(job.src, job.dst, IMG_WIDTH, IMG_HEIGHT, &job.gauss, BORDER_ZERO);
+            PROF_END(PROF_GAUSS_IIR);
+            y1 = IMG_HEIGHT;
+            break;
+
+        case JOB_RANK:
+            PROF_BEGIN(PROF_RANK_FILTER);
+            rank_filter(job.src, job.dst, IMG_WIDTH, IMG_HEIGHT, job.menu.rank_radius, job.menu.rank, BORDER_ZERO);
+            PROF_END(PROF_RANK_FILTER);
+            y1 = IMG_HEIGHT;
+            break;
+
+        case JOB_KERNEL: {
+            image_t src, dst;
+            rect_t band = { 0, y0, IMG_WIDTH, y1 - y0 };
+            image_init(&src, (unsigned char*)job.src, IMG_WIDTH, IMG_HEIGHT, IMG_WIDTH);
+            image_init(&dst, job.dst, IMG_WIDTH, IMG_HEIGHT, IMG_WIDTH);
+            convolve_image(&src, &dst, job.kernel, &band, NULL);
+            break;
+        }
+
+        case JOB_PACKED:
+            convolve_packed_rows(&job.packed, job.dst, y0, y1, job.kernel, BORDER_ZERO);
+            break;
+
+        case JOB_CHAIN:
+            chain_step(&job.chain, max_rows);
+            y1 = job.chain.next_out;
+            break;
+    }
+
+    job.next_row = y1;
+    if (y1 >= IMG_HEIGHT) job_finish();
+    return job.kind != JOB_IDLE;
+}
+
+int process_busy(void) {
+    return job.kind != JOB_IDLE;
+}
+
+int process_progress(void) {
+    if (job.kind == JOB_IDLE) return 100;
+    return (job.stage * IMG_HEIGHT + job.next_row) * 100 / (job.stages * IMG_HEIGHT);
+}
+
+void process_cancel(void) {
+    if (job.kind == JOB_IDLE) return;
+    if (job.has_second) {
+        cache_abort(job.mid);
+        cache_abort(job.final_dst);
+        output_written(NULL, NULL, job.final_dst);
+    } else {
+        cache_abort(job.dst);
+        output_written(NULL, NULL, job.dst);
+    }
+    job.kind = JOB_IDLE;
+    job.has_second = 0;
+}
+
+// En egen kernel skrivs över på sin plats när den laddas om. Ett jobb som
+// använder den avbryts, och process_dirty() får inte räkna om med den nya.
+void process_kernel_changed(int slot) {
+    if (job.custom_slots & 1u << slot) process_cancel();
+    if (output_kernel && output_kernel == kernel_custom(slot)) output_kernel = NULL;
+}
+
+// ===========================================================
+// Resultatcache
+// ===========================================================
+
+// Filterkod för cachens nyckel, aldrig 0. Storleken räknas bara för de
+// vanliga kernlarna, radien bara för stor box blur, sigma bara för
+// rekursiv Gauss och radie och percentil bara för rangfilter. En egen kernel får
+// sin version, så att en omladdad plats inte ger träffar från den gamla.
+static unsigned int filter_code(const menu_state_t* menu) {
+    if (menu->large_mode && menu->kernel_selected == KERNEL_BOXBLUR) {
+        return 0x10000u | menu->radius;
+    }
+    if (menu->large_mode && menu->kernel_selected == KERNEL_GAUSSIAN) {
+        return 0x20000u | menu->sigma;
+    }
+    if (menu->rank >= 0) {
+        return 0x40000u | menu->rank_radius << 8 | menu->rank;
+    }
+    if (menu->custom && kernel_custom_version(menu->custom)) {
+        return 0x80000000u | kernel_custom_version(menu->custom);
+    }
+    return 1 + menu->kernel_selected * 2 + (menu->kernel_size == 5);
+}
+
+// Startar ett jobb som räknar till dst och släpper platsen om det inte gick
+static process_request_t request_started(int ok, unsigned char* dst) {
+    if (ok) return PROCESS_STARTED;
+    cache_abort(dst);
+    return PROCESS_FAILED;
+}
+
+/*
+ * Funktion: process_request
+ * -------------------------
+ * Slår först upp hela valet i cachen. För en kedja slås sedan första steget
+ * upp för sig, så att bara andra kerneln behöver köras när bara den har
+ * ändrats. Annars körs kedjan som utan cache, strömmad eller sammansatt
+ * (CHAIN_FUSION) rakt in i platsen för hela valet. Bara en kedja som ändå
+ * behöver en mellanbild (stora filter) får första steget i en egen plats,
+ * som sedan också ger träffar för enbart första filtret. Utan cache körs
+ * allt som förut till output_img.
+ */
+process_request_t process_request(const menu_state_t* first, const menu_state_t* second) {
+    process_cancel();
+    if (!cache_enabled()) {
+        int ok = second ? process_start_chain(first, second, image_src, &output_img[0][0])
+                        : process_start(first, image_src, &output_img[0][0]);
+        return ok ? PROCESS_STARTED : PROCESS_FAILED;
+    }
+
+    cache_key_t key = { input_generation, filter_code(first), second ? filter_code(second) : 0 };
+    unsigned char* hit = cache_lookup(&key);
+    if (hit) {
+        print("Cache hit, result reused.\n");
+        output_written(NULL, NULL, hit);
+        set_result(hit);
+        return PROCESS_CACHED;
+    }
+
+    if (!second) {
+        print("Cache miss.\n");
+        unsigned char* dst = cache_reserve(&key);
+        return request_started(process_start(first, image_src, dst), dst);
+    }
+
+    // Första steget ensamt. Uppslaget gör platsen nyast, så reservationen
+    // nedan kastar den inte.
+    cache_key_t key1 = { input_generation, key.stage1, 0 };
+    unsigned char* mid = cache_lookup(&key1);
+    unsigned char* dst = cache_reserve(&key);
+    if (mid) {
+        print("Cache hit on first kernel, applying second kernel...\n");
+        job_begin(dst);
+        return request_started(job_filter(second, mid, dst), dst);
+    }
+
+    print("Cache miss.\n");
+    job_begin(dst);
+    int ok = job_stream_chain(first, second, image_src, dst);
+    if (ok >= 0) return request_started(ok, dst);
+
+    mid = cache_reserve(&key1);
+    if (!job_two_pass(first, second, image_src, mid, dst)) {
+        cache_abort(mid);
+        return request_started(0, dst);
+    }
+    return PROCESS_STARTED;
+}
+
+// Kör det filter som menyn anger från src till dst, hela bilden direkt.
+// Returnerar 0 om inget giltigt filter är valt.
+int apply_filter(const menu_state_t* menu, const unsigned char* src, unsigned char* dst) {
+    if (!process_start(menu, src, dst)) return 0;
+    while (process_step(IMG_HEIGHT));
+    return 1;
+}
+
+// Kör två menyval i följd, hela bilden direkt
+int apply_chain(const menu_state_t* first, const menu_state_t* second, const unsigned char* src, unsigned char* dst) {
+    if (!process_start_chain(first, second, src, dst)) return 0;
+    while (process_step(IMG_HEIGHT));
+    return 1;
+}
@@ -0,0 +1,93 @@
+// process.h
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include "menu.h"
+#include "image.h"
+
+// Aktuell indatabild, IMG_WIDTH x IMG_HEIGHT. Skrivskyddad; använd
+// input_writable() för att få en kopia som får ändras. Med make IMAGE=packed
+// pekar den på den packade bilden tills dess; skicka den då bara vidare
+// till apply_filter()/apply_chain(), som avkodar rad för rad.
+extern const unsigned char* image_src;
+
+// Det senaste färdiga resultatet, IMG_WIDTH x IMG_HEIGHT. output_img från
+// början och efter reset_images(); med resultatcachen en plats i den.
+extern unsigned char* result_img;
+
+// Skrivbar kopia av indata, skapas vid behov (copy-on-write)
+unsigned char* input_writable(void);
+
+// Pekar om image_src till den inbyggda bilden och nollar output_img,
+// som blir result_img
+void reset_images(void);
+
+// Kör det filter som menyn anger från src till dst. 0 om inget giltigt filter.
+int apply_filter(const menu_state_t* menu, const unsigned char* src, unsigned char* dst);
+
+// Samma filter som apply_filter()/apply_chain(), men som ett jobb som körs
+// en bit i taget med process_step(). Ett nytt jobb avbryter det gamla.
+// Returnerar 0 om inget giltigt filter är valt.
+int process_start(const menu_state_t* menu, const unsigned char* src, unsigned char* dst);
+int process_start_chain(const menu_state_t* first, const menu_state_t* second, const unsigned char* src, unsigned char* dst);
+
+// Rader per process_step() i huvudloopen: en Gaussian 5x5 på 8 rader tar
+// några ms, så en knapptryckning väntar aldrig längre än så.
+#define PROCESS_CHUNK_ROWS 8
+
+// Kör upp till max_rows utrader av jobbet. Returnerar 1 så länge det finns
+// mer att göra; 0 när jobbet är klart (eller inget jobb finns).
+int process_step(int max_rows);
+
+// 1 medan ett jobb pågår
+int process_busy(void);
+
+// Hur långt jobbet kommit, 0-100 procent
+int process_progress(void);
+
+// Avbryter jobbet. Utdata är då delvis skriven.
+void process_cancel(void);
+
+// Bevakar buf (NULL = ingenting), t.ex. bilden som en nedladdning läser.
+// process_watch_hit() blir 1 så fort något börjar skriva i den: ett nytt
+// jobb till den platsen, reset_images(), process_dirty() eller ändrad indata.
+void process_watch(const unsigned char* buf);
+int process_watch_hit(void);
+
+// Anropas innan en egen kernel laddas till slot (kernels_plan.h): avbryter
+// jobbet om det använder platsen
+void process_kernel_changed(int slot);
+
+// Indata ska skrivas över rad för rad, t.ex. när en bild tas emot över
+// UART (xfer.c). Ger input_img utan att kopiera den gamla bilden; jobb på
+// den kör bara så långt som de rader som anmälts med input_rows_ready()
+// räcker, så filtret kan arbeta medan resten av bilden kommer.
+unsigned char* input_begin_rows(void);
+
+// De första rows raderna av input_img är klara (IMG_HEIGHT = hela bilden)
+void input_rows_ready(int rows);
+
+// Markera att indata i r har ändrats (t.ex. efter input_writable()).
+// Måste anropas efter varje ändring: den ger indata en ny generation, så
+// att resultatcachen inte längre ger träffar från den gamla.
+void input_mark_dirty(const rect_t* r);
+
+// Räkna bara om den del av det senaste resultatet som påverkas av ändrad indata.
+// 0 om senaste output inte kom från ett enkelt filter; kör då apply_filter.
+int process_dirty(void);
+
+typedef enum {
+    PROCESS_FAILED,   // Inget giltigt filter valt
+    PROCESS_CACHED,   // Resultatet fanns redan, result_img pekar på det
+    PROCESS_STARTED   // Ett jobb har startats; result_img sätts när det är klart
+} process_request_t;
+
+// Menyvalet (second == NULL) eller kedjan first -> second på image_src, via
+// resultatcachen (cache.h) om cache_init() har gett den platser. Ett val
+// som räknats förut för samma indata ger bara en ny result_img, utan jobb.
+process_request_t process_request(const menu_state_t* first, const menu_state_t* second);
+
+// Kör två menyval i följd från src till dst
+int apply_chain(const menu_state_t* first, const menu_state_t* second, const unsigned char* src, unsigned char* dst);
+
+#endif
@@ -0,0 +1,116 @@
+// profile.c
+// Mätregioner ovanpå RISC-V:s räknare mcycle och minstret.
+#include "profile.h"
+
+#ifdef PROFILE
+
+#include "dtekv-lib.h"
+#include "hal.h"
+
+typedef struct {
+    unsigned long long cycles;
+    unsigned long long instret;
+    unsigned long long start_cycles;
+    unsigned long long start_instret;
+    unsigned int calls;
+    unsigned int depth;
+} prof_entry_t;
+
+static prof_entry_t prof_entries[PROF_REGION_COUNT];
+
+static const char* const prof_names[PROF_REGION_COUNT] = {
+    "convolve     ",
+    "select kernel",
+    "memcpy       ",
+    "box filter   ",
+    "chain stage 1",
+    "chain stage 2",
+    "unpack       ",
+    "gauss iir    ",
+    "rank filter  "
+};
+
+unsigned long long prof_cycles(void) {
+    return hal_cycles();
+}
+
+// På rv32 läses de 64-bitars räknarna i två halvor, som i hal_cycles().
+// Läs om ifall den övre halvan ändrades mellan läsningarna.
+unsigned long long prof_instret(void) {
+    unsigned int hi, lo, hi2;
+    do {
+        asm volatile ("csrr %0, minstreth" : "=r"(hi));
+        asm volatile ("csrr %0, minstret" : "=r"(lo));
+        asm volatile ("csrr %0, minstreth" : "=r"(hi2));
+    } while (hi != hi2);
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+void prof_begin(prof_region_t region) {
+    prof_entry_t* e = &prof_entries[region];
+    if (e->depth++ == 0) {
+        e->start_instret = prof_instret();
+        e->start_cycles = prof_cycles();
+    }
+}
+
+void prof_end(prof_region_t region) {
+    prof_entry_t* e = &prof_entries[region];
+    if (--e->depth == 0) {
+        e->cycles += prof_cycles() - e->start_cycles;
+        e->instret += prof_instret() - e->start_instret;
+        e->calls++;
+    }
+}
+
+void prof_reset(void) {
+    for (int i = 0; i < PROF_REGION_COUNT; i++) {
+        prof_entries[i].cycles = 0;
+        prof_entries[i].instret = 0;
+        prof_entries[i].calls = 0;
+    }
+}
+
+static void prof_print_u64(unsigned long long x) {
+    if (x >> 32) {
+        print_hex32((unsigned int)(x >> 32));
+        print("_");
+        print_hex32((unsigned int)x);
+    } else {
+        print_dec((unsigned int)x);
+    }
+}
+
+// Värde per pixel med två decimaler
+static void prof_print_per_pixel(unsigned long long total, unsigned int pixels) {
+    unsigned long long hundredths = u64_div_u32(total * 100, pixels);
+    prof_print_u64(u64_div_u32(hundredths, 100));
+    unsigned int frac = (unsigned int)(hundredths - u64_div_u32(hundredths, 100) * 100);
+    printc('.');
+    printc('0' + frac / 10);
+    printc('0' + frac % 10);
+}
+
+void prof_report(unsigned int pixels) {
+    if (pixels == 0) pixels = 1;
+    print("--- Profile (");
+    print_dec(pixels);
+    print(" pixels) ---\n");
+    for (int i = 0; i < PROF_REGION_COUNT; i++) {
+        prof_entry_t* e = &prof_entries[i];
+        if (e->calls == 0) continue;
+        print(prof_names[i]);
+        print("  calls ");
+        print_dec(e->calls);
+        print("  cycles ");
+        prof_print_u64(e->cycles);
+        print("  cyc/px ");
+        prof_print_per_pixel(e->cycles, pixels);
+        print("  ins/px ");
+        prof_print_per_pixel(e->instret, pixels);
+        print("\n");
+    }
+    prof_reset();
+}
+
+#endif
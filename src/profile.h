@@ -0,0 +1,48 @@
+// profile.h
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// Cykelexakt profilering med mcycle/minstret (64 bitar). Bygg med
+// -DPROFILE för att slå på; annars blir alla PROF_-makron ingenting.
+
+typedef enum {
+    PROF_CONVOLVE,      // convolve_ex / convolve_kernel
+    PROF_SELECT_KERNEL, // get_selected_kernel
+    PROF_MEMCPY,        // memcpy
+    PROF_BOX_FILTER,    // box_filter
+    PROF_CHAIN_STAGE1,  // kedjans första kernel (mellanrader)
+    PROF_CHAIN_STAGE2,  // kedjans andra kernel (utrader)
+    PROF_UNPACK,        // packed_read_row (avkodning av packad bild)
+    PROF_GAUSS_IIR,     // gauss_iir
+    PROF_RANK_FILTER,   // rank_filter
+    PROF_REGION_COUNT
+} prof_region_t;
+
+#ifdef PROFILE
+
+// Regioner får nästlas i sig själva (t.ex. convolve_kernel -> convolve_ex),
+// bara den yttersta nivån räknas.
+void prof_begin(prof_region_t region);
+void prof_end(prof_region_t region);
+
+// Skriver cykler och instruktioner per pixel för varje region som körts
+// sedan förra prof_reset(), och nollställer sedan.
+void prof_report(unsigned int pixels);
+void prof_reset(void);
+
+unsigned long long prof_cycles(void);
+unsigned long long prof_instret(void);
+
+#define PROF_BEGIN(region)  prof_begin(region)
+#define PROF_END(region)    prof_end(region)
+#define PROF_REPORT(pixels) prof_report(pixels)
+
+#else
+
+#define PROF_BEGIN(region)  ((void)0)
+#define PROF_END(region)    ((void)0)
+#define PROF_REPORT(pixels) ((void)0)
+
+#endif
+
+#endif
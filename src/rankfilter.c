@@ -0,0 +1,143 @@
+// rankfilter.c
+// Rangfilter med glidande histogram (se rankfilter.h).
+//
+// Varje kolumn har ett histogram över sina 2r+1 pixlar i fönstret, och
+// fönstrets histogram är summan av 2r+1 kolumnhistogram. Båda glider:
+// kolumnerna en rad nedåt (en pixel in, en ut), fönstret en kolumn åt
+// höger (ett kolumnhistogram in, ett ut). Histogrammen har två nivåer,
+// 16 grova fack om 16 nivåer vardera och de 256 fina, så att glida och
+// leta upp rangvärdet kostar några tiotal operationer oavsett radie.
+#include "dtekv-lib.h"
+#include "rankfilter.h"
+
+#define RANK_BINS 256
+#define RANK_COARSE 16
+
+// Bilden går i vertikala band om högst RANK_STRIP utkolumner, så att
+// kolumnhistogrammen för ett band (plus r på varje sida) ryms här. Smala
+// band kostar fler kolumnuppdateringar per pixel vid stor radie, men
+// fönstrets histogram och sökningen är desamma.
+#define RANK_STRIP (CONV_MAX_WIDTH / 8)
+#define RANK_COLS (RANK_STRIP + 2 * RANK_MAX_RADIUS)
+
+static CONV_SCRATCH unsigned char rank_fine[RANK_COLS][RANK_BINS];
+static CONV_SCRATCH unsigned char rank_coarse[RANK_COLS][RANK_COARSE];
+// Källkolumn i bilden för varje kolumnhistogram, -1 = nollor
+static CONV_SCRATCH int rank_src[RANK_COLS];
+
+// Fönstrets histogram. Ett fint fack räknas bara om när rangvärdet hamnar
+// i det, från kolumnfönstret det senast stämde för (updated).
+typedef struct {
+    unsigned short coarse[RANK_COARSE];
+    unsigned short fine[RANK_COARSE][RANK_BINS / RANK_COARSE];
+    int updated[RANK_COARSE];
+} rank_hist_t;
+
+// Lägger till (sign = 1) eller drar bort (sign = -1) rad iy från de cols
+// kolumnhistogrammen
+static void rank_add_row(const unsigned char* input, int width, int height, int iy, int cols, int sign, border_mode_t border) {
+    int sy = conv_border_index(iy, height, border);
+    const unsigned char* in = sy < 0 ? conv_zero_row : input + sy * width;
+    unsigned char d = sign > 0 ? 1 : 0xFF;
+    for (int c = 0; c < cols; c++) {
+        int v = rank_src[c] < 0 ? 0 : in[rank_src[c]];
+        rank_fine[c][v] += d;
+        rank_coarse[c][v >> 4] += d;
+    }
+}
+
+// Fina facket b av kolumn c till (sign = 1) eller från (sign = -1) fönstret
+static inline void rank_fine_add(rank_hist_t* h, int b, int c, int sign) {
+    unsigned short* f = h->fine[b];
+    const unsigned char* col = &rank_fine[c][b * 16];
+    if (sign > 0) {
+        for (int i = 0; i < 16; i++) f[i] += col[i];
+    } else {
+        for (int i = 0; i < 16; i++) f[i] -= col[i];
+    }
+}
+
+/*
+ * Funktion: rank_row
+ * ------------------
+ * En utrad av bandet: n utpixlar, där utpixel x har kolumnhistogrammen
+ * x .. x+2r i fönstret. Det grova histogrammet hålls alltid aktuellt (16
+ * additioner och 16 subtraktioner per steg). Rangvärdet letas upp bland de
+ * grova facken, och bara det fina fack som det hamnar i förs fram till
+ * aktuell kolumn: stegvis om det stämde nyligen, annars räknas det om från
+ * de 2r+1 kolumnerna. Intill varandra liggande pixlar har oftast rangvärdet
+ * i samma fack, så omräkningarna blir få.
+ */
+static void rank_row(unsigned char* out, int n, int radius, int rank) {
+    int ksize = 2 * radius + 1;
+    rank_hist_t hist;
+
+    for (int b = 0; b < RANK_COARSE; b++) {
+        hist.coarse[b] = 0;
+        hist.updated[b] = -ksize;
+    }
+    for (int c = 0; c < ksize; c++) {
+        for (int b = 0; b < RANK_COARSE; b++) hist.coarse[b] += rank_coarse[c][b];
+    }
+
+    for (int x = 0; x < n; x++) {
+        if (x > 0) {
+            const unsigned char* in = rank_coarse[x + ksize - 1];
+            const unsigned char* old = rank_coarse[x - 1];
+            for (int b = 0; b < RANK_COARSE; b++) hist.coarse[b] += in[b] - old[b];
+        }
+
+        int b = 0, sum = 0;
+        while (sum + hist.coarse[b] <= rank) sum += hist.coarse[b++];
+
+        int from = hist.updated[b];
+        if (x - from >= ksize) {
+            for (int i = 0; i < 16; i++) hist.fine[b][i] = 0;
+            for (int c = x; c < x + ksize; c++) rank_fine_add(&hist, b, c, 1);
+        } else {
+            for (int j = from + 1; j <= x; j++) {
+                rank_fine_add(&hist, b, j + ksize - 1, 1);
+                rank_fine_add(&hist, b, j - 1, -1);
+            }
+        }
+        hist.updated[b] = x;
+
+        const unsigned short* f = hist.fine[b];
+        int i = 0;
+        while (sum + f[i] <= rank) sum += f[i++];
+        out[x] = (unsigned char)(b * 16 + i);
+    }
+}
+
+void rank_filter(const unsigned char* input, unsigned char* output, int width, int height, int radius, int percentile, border_mode_t border) {
+    if (width > CONV_MAX_WIDTH || radius < 0 || radius > RANK_MAX_RADIUS || percentile < 0 || percentile > 100) {
+        print("rank_filter: unsupported size\n");
+        return;
+    }
+
+    int ksize = 2 * radius + 1;
+    int rank = ((ksize * ksize - 1) * percentile + 50) / 100;
+
+    for (int x0 = 0; x0 < width; x0 += RANK_STRIP) {
+        int n = width - x0 < RANK_STRIP ? width - x0 : RANK_STRIP;
+        int cols = n + 2 * radius;
+
+        // Kolumnhistogrammen för rad 0: raderna -radius .. radius
+        for (int c = 0; c < cols; c++) {
+            rank_src[c] = conv_border_index(x0 - radius + c, width, border);
+            for (int v = 0; v < RANK_BINS; v++) rank_fine[c][v] = 0;
+            for (int b = 0; b < RANK_COARSE; b++) rank_coarse[c][b] = 0;
+        }
+        for (int dy = -radius; dy <= radius; dy++) {
+            rank_add_row(input, width, height, dy, cols, 1, border);
+        }
+
+        for (int y = 0; y < height; y++) {
+            if (y > 0) {
+                rank_add_row(input, width, height, y + radius, cols, 1, border);
+                rank_add_row(input, width, height, y - radius - 1, cols, -1, border);
+            }
+            rank_row(output + y * width + x0, n, radius, rank);
+        }
+    }
+}
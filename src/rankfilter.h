@@ -0,0 +1,27 @@
+// rankfilter.h
+#ifndef RANKFILTER_H
+#define RANKFILTER_H
+
+#include "kernels.h"
+
+// Rangfilter: varje utpixel är ett visst rangvärde bland de (2r+1)^2
+// pixlarna i fönstret, t.ex. medianen. Tar bort salt-och-peppar-brus som
+// ingen linjär kernel klarar. Histogrambaserat enligt Perreault och Hébert
+// (2007), så kostnaden per pixel växer inte med fönstrets storlek.
+
+// Största radie: kolumnhistogrammen räknar till 2r+1 i en byte
+#define RANK_MAX_RADIUS 15
+
+// Percentiler för de vanliga rangfiltren
+#define RANK_MIN 0
+#define RANK_MEDIAN 50
+#define RANK_MAX 100
+
+// Rangvärde nummer (n - 1) * percentile / 100 (avrundat) av de n pixlarna
+// i fönstret, i växande ordning. percentile 0 ger minimum, 50 medianen
+// (exakt, n är udda) och 100 maximum. Pixlar utanför bilden räknas med
+// enligt kantläget, vid BORDER_ZERO som nollor. input och output får inte
+// vara samma buffert.
+void rank_filter(const unsigned char* input, unsigned char* output, int width, int height, int radius, int percentile, border_mode_t border);
+
+#endif
@@ -0,0 +1,90 @@
+// tile.c
+// Cacheblockad konvolution: bilden delas i rutor så att en rutas indata
+// (med kernelns apron) och utdata ryms i datacachen. Varje indatarad
+// används då av alla ksize utrader i rutan innan den trängs undan, i
+// stället för att hela bildbredder svepas igenom per utrad. Bara för
+// värdbygget.
+#include "tile.h"
+
+#ifdef HOST
+
+#include "hal.h"
+
+void tile_config_for_cache(tile_config_t* cfg, int cache_bytes, int ksize) {
+    int apron = ksize - 1;
+
+    // Bredd en tvåpotens nära sqrt(budget/2), höjden så stor att
+    // (tw+a)(th+a) + tw*th <= budget
+    int tw = 16;
+    while (2 * (tw * 2) * (tw * 2) <= cache_bytes) tw *= 2;
+    int th = (cache_bytes - apron * (tw + apron)) / (2 * tw + apron);
+    if (th < 1) th = 1;
+
+    cfg->tile_w = tw;
+    cfg->tile_h = th;
+}
+
+// Kör rutorna som täcker area (i utpixlar)
+static void tile_run(const image_t* src, image_t* dst, const conv_kernel_t* k, const tile_config_t* cfg, const conv_options_t* opts, const rect_t* area) {
+    int tw = cfg->tile_w > 0 ? cfg->tile_w : area->w;
+    int th = cfg->tile_h > 0 ? cfg->tile_h : area->h;
+
+    for (int ty = area->y; ty < area->y + area->h; ty += th) {
+        for (int tx = area->x; tx < area->x + area->w; tx += tw) {
+            rect_t tile = { tx, ty, tw, th };
+            if (tile.x + tile.w > area->x + area->w) tile.w = area->x + area->w - tile.x;
+            if (tile.y + tile.h > area->y + area->h) tile.h = area->y + area->h - tile.y;
+            convolve_image(src, dst, k, &tile, opts);
+        }
+    }
+}
+
+void convolve_tiled(const image_t* src, image_t* dst, const conv_kernel_t* k, const tile_config_t* cfg, const conv_options_t* opts) {
+    rect_t all = { 0, 0, dst->width, dst->height };
+    tile_run(src, dst, k, cfg, opts, &all);
+}
+
+/*
+ * Funktion: tile_autotune
+ * -----------------------
+ * Provar bredderna 16..1024 och hela bredden gånger höjderna 8..64, plus
+ * förslaget från tile_config_for_cache(). Alla band är lika stora, så
+ * tiden per band räcker för att jämföra. Varje kandidat mäts på ett eget
+ * band längre ned i bilden: ett band som nyss körts ligger kvar i cachen
+ * och skulle ge en för snäll siffra jämfört med en hel bild.
+ */
+static unsigned long long tile_measure(const image_t* src, image_t* dst, const conv_kernel_t* k, const conv_options_t* opts, const tile_config_t* cfg, rect_t* band) {
+    unsigned long long t0 = hal_cycles();
+    tile_run(src, dst, k, cfg, opts, band);
+    unsigned long long t = hal_cycles() - t0;
+
+    band->y += band->h;
+    if (band->y + band->h > dst->height) band->y = 0;
+    return t;
+}
+
+unsigned long long tile_autotune(const image_t* src, image_t* dst, const conv_kernel_t* k, const conv_options_t* opts, tile_config_t* best) {
+    static const int widths[] = { 0, 16, 32, 64, 128, 256, 512, 1024 };
+    static const int heights[] = { 8, 16, 32, 64 };
+
+    rect_t band = { 0, 0, dst->width, dst->height };
+    if (band.h > TILE_TUNE_ROWS) band.h = TILE_TUNE_ROWS;
+
+    tile_config_for_cache(best, TILE_CACHE_BYTES, k->ksize);
+    unsigned long long best_time = tile_measure(src, dst, k, opts, best, &band);
+
+    for (unsigned int i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+        if (widths[i] >= dst->width) continue; // samma som hela bredden (0)
+        for (unsigned int j = 0; j < sizeof(heights) / sizeof(heights[0]); j++) {
+            tile_config_t cfg = { widths[i], heights[j] };
+            unsigned long long t = tile_measure(src, dst, k, opts, &cfg, &band);
+            if (t < best_time) {
+                best_time = t;
+                *best = cfg;
+            }
+        }
+    }
+    return best_time;
+}
+
+#endif
@@ -0,0 +1,40 @@
+// tile.h
+#ifndef TILE_H
+#define TILE_H
+
+#include "image.h"
+
+// Cacheblockad konvolution för värdbygget (make host), för bilder vars
+// ksize rader inte ryms i datacachen (imgbatch -T). Finns inte i
+// firmwaren, där bilderna är IMG_WIDTH breda.
+
+// Cachebudget i byte för en ruta: indata med apron plus utdata. Sätt med
+// -DTILE_CACHE_BYTES=... efter datacachen på värden.
+#ifndef TILE_CACHE_BYTES
+#define TILE_CACHE_BYTES 16384
+#endif
+
+// Rutstorlek i utpixlar. 0 betyder hela bredden respektive höjden.
+typedef struct {
+    int tile_w;
+    int tile_h;
+} tile_config_t;
+
+// Största rutor (bredd multipel av 16) vars indata, utdata och apron ryms
+// i cache_bytes för en kernel av storlek ksize.
+void tile_config_for_cache(tile_config_t* cfg, int cache_bytes, int ksize);
+
+// Konvolution ruta för ruta, rad av rutor uppifrån och ned. Samma
+// resultat som convolve_image() på hela bilden.
+void convolve_tiled(const image_t* src, image_t* dst, const conv_kernel_t* k, const tile_config_t* cfg, const conv_options_t* opts);
+
+// Rader i bandet som tile_autotune() mäter på
+#define TILE_TUNE_ROWS 128
+
+// Provar ett antal rutstorlekar, var och en på ett band av bilden (hela
+// bredden, högst TILE_TUNE_ROWS rader), mäter med hal_cycles() och väljer
+// den snabbaste. dst skrivs över i de band som mäts. Returnerar tiden för
+// ett band med den valda storleken, i hal_cycles()-enheter.
+unsigned long long tile_autotune(const image_t* src, image_t* dst, const conv_kernel_t* k, const conv_options_t* opts, tile_config_t* best);
+
+#endif
@@ -0,0 +1,370 @@
+// xfer.c
+// Bildöverföring över JTAG UART, kortets sida. Se xfer.h för flödet och
+// frame.h för ramarna.
+//
+// Uppladdning: FRAME_UPLOAD, sedan en FRAME_ROW per rad i ordning och till
+// sist FRAME_END. Raderna skrivs rakt in i input_img (input_begin_rows()),
+// så ett filter som valts i FRAME_UPLOAD räknar utrader så fort deras
+// fönster har kommit. En rad som inte är nästa i tur (en ram har fallit
+// bort) ger en FRAME_NAK; värden går då tillbaka och skickar om därifrån.
+// Var FRAME_ACK_ROWS:e rad kvitteras, så att värden kan flytta fönstret.
+//
+// Nedladdning: FRAME_DOWNLOAD ger FRAME_INFO, alla rader och FRAME_END,
+// med samma fönster åt andra hållet. Värden svarar till sist FRAME_ACK,
+// eller FRAME_NAK från första saknade rad. Bilden som skickas bevakas med
+// process_watch(): skrivs den över under tiden (ett nytt jobb dit, en reset,
+// ändrad indata) avbryts nedladdningen med FRAME_ERR_CHANGED i stället för
+// att skicka en halvt ny bild.
+#include "dtekv-lib.h"
+#include "main.h"
+#include "menu.h"
+#include "process.h"
+#include "input.h"
+#include "frame.h"
+#include "kernels_plan.h"
+#include "xfer.h"
+#include <stddef.h>
+
+typedef enum {
+    STATE_IDLE,
+    STATE_RECEIVE,       // Tar emot rader
+    STATE_SEND_PENDING,  // Resultatet begärt, väntar på att jobbet blir klart
+    STATE_SEND,          // Skickar rader
+    STATE_SEND_WAIT      // Alla rader skickade, väntar på FRAME_ACK
+} xfer_state_t;
+
+static struct {
+    xfer_state_t state;
+    frame_parser_t rx;
+    int next_row;                // Nästa rad att ta emot eller skicka
+    int acked;                   // Nedladdning: rader som värden kvitterat
+    int nak_sent;                // FRAME_NAK för next_row redan skickad
+    int seen;                    // Högsta rad sedan dess (IMG_HEIGHT = FRAME_END)
+    int received;                // Senaste uppladdningen blev klar
+    const unsigned char* src;    // Bilden som skickas
+    int packed;                  // Packade rader tillåtna vid nedladdning
+    int retries;
+    unsigned int last_tick;      // Senaste byte från värden
+} xfer;
+
+static unsigned char tx_frame[FRAME_MAX_PAYLOAD + FRAME_OVERHEAD];
+static unsigned char tx_payload[FRAME_MAX_PAYLOAD];
+
+// Ramen skrivs hel, så text från print() hamnar aldrig inne i den
+static void send_frame(int type, const unsigned char* payload, int len) {
+    uart_write(tx_frame, frame_build(tx_frame, type, payload, len));
+}
+
+static void send_row_number(int type, int row) {
+    unsigned char p[2];
+    frame_put16(p, row);
+    send_frame(type, p, 2);
+}
+
+static void send_error(frame_error_t err) {
+    unsigned char p = (unsigned char)err;
+    send_frame(FRAME_ERROR, &p, 1);
+}
+
+void xfer_init(void) {
+    frame_parser_init(&xfer.rx);
+    xfer.state = STATE_IDLE;
+    xfer.received = 0;
+}
+
+// Avbryter en uppladdning. Ett jobb på den halvt mottagna bilden avbryts,
+// och det som hann komma får bli indata.
+static void stop_receive(void) {
+    process_cancel();
+    input_rows_ready(IMG_HEIGHT);
+    xfer.state = STATE_IDLE;
+}
+
+// En ny begäran tar över den pågående överföringen
+static void abort_transfer(void) {
+    if (xfer.state == STATE_RECEIVE) {
+        stop_receive();
+        print("Upload aborted.\n");
+    }
+    xfer.state = STATE_IDLE;
+    process_watch(NULL);
+}
+
+static int filter_valid(const menu_state_t* m) {
+    // Med SW[5] är alla fyra typerna helbildsfilter (process.c)
+    return m->large_mode || get_selected_kernel(m);
+}
+
+// FRAME_UPLOAD: bredd, höjd, läge, switchar 1 och 2
+static xfer_status_t handle_upload(const unsigned char* p, int len) {
+    abort_transfer();
+    if (len < 9 || p[4] > FRAME_MODE_CHAIN) {
+        send_error(FRAME_ERR_REQUEST);
+        return XFER_ACTIVE;
+    }
+    if (frame_get16(p) != IMG_WIDTH || frame_get16(p + 2) != IMG_HEIGHT) {
+        send_error(FRAME_ERR_SIZE);
+        return XFER_ACTIVE;
+    }
+
+    frame_mode_t mode = (frame_mode_t)p[4];
+    menu_state_t first, second;
+    menu_init(&first);
+    menu_init(&second);
+    menu_update(&first, frame_get16(p + 5), 0);
+    menu_update(&second, frame_get16(p + 7), 0);
+    if ((mode != FRAME_MODE_STORE && !filter_valid(&first)) ||
+        (mode == FRAME_MODE_CHAIN && !filter_valid(&second))) {
+        send_error(FRAME_ERR_FILTER);
+        return XFER_ACTIVE;
+    }
+
+    input_begin_rows();
+    xfer.state = STATE_RECEIVE;
+    xfer.next_row = 0;
+    xfer.nak_sent = 0;
+    xfer.received = 0;
+    print("Receiving image over UART...\n");
+
+    if (mode == FRAME_MODE_STORE) return XFER_ACTIVE;
+    return process_request(&first, mode == FRAME_MODE_CHAIN ? &second : NULL) == PROCESS_STARTED
+        ? XFER_STARTED : XFER_ACTIVE;
+}
+
+// FRAME_KERNEL: kompilerar vikterna till en plan på platsen. Kerneln
+// kontrolleras först; bara en giltig avbryter ett jobb som använder den
+// gamla kerneln på platsen.
+static void handle_kernel(const unsigned char* p, int len) {
+    abort_transfer();
+    int size = len >= FRAME_KERNEL_HEADER ? p[1] : 0;
+    if (size < 1 || size > KERNEL_MAX_SIZE || len != FRAME_KERNEL_HEADER + 2 * size * size) {
+        send_error(FRAME_ERR_REQUEST);
+        return;
+    }
+
+    int table[KERNEL_MAX_SIZE * KERNEL_MAX_SIZE];
+    for (int i = 0; i < size * size; i++) {
+        table[i] = (short)frame_get16(p + FRAME_KERNEL_HEADER + 2 * i);
+    }
+    unsigned int divisor = frame_get16(p + 2) | (frame_get16(p + 4) << 16);
+    if (divisor > 0x7FFFFFFFu || !kernel_custom_valid(p[0], table, size, (int)divisor)) {
+        send_error(FRAME_ERR_KERNEL);
+        return;
+    }
+    process_kernel_changed(p[0]);
+    kernel_custom_load(p[0], table, size, (int)divisor, (short)frame_get16(p + 6));
+    send_row_number(FRAME_ACK, p[0]);
+    print("Kernel ");
+    print_dec(p[0]);
+    print(" loaded: ");
+    kernel_plan_print(kernel_custom(p[0])->plan);
+}
+
+// Begär om från next_row, en gång per lucka. Ligger ramen (rad seen, eller
+// IMG_HEIGHT för FRAME_END) inte efter den förra har värden redan gått
+// tillbaka, och next_row föll bort igen; då begärs den om på nytt.
+static void request_resend(int seen) {
+    if (!xfer.nak_sent || seen <= xfer.seen) {
+        send_row_number(FRAME_NAK, xfer.next_row);
+        xfer.nak_sent = 1;
+    }
+    xfer.seen = seen;
+}
+
+// FRAME_ROW under en uppladdning. Bara nästa rad i tur tas emot.
+static void handle_row(const unsigned char* p, int len) {
+    if (xfer.state != STATE_RECEIVE || len < 2) return;
+
+    int row = frame_get16(p);
+    if (row == xfer.next_row && row < IMG_HEIGHT) {
+        const unsigned char* prev = row > 0 ? input_img[row - 1] : conv_zero_row;
+        if (frame_row_decode(p, len, IMG_WIDTH, input_img[row], prev)) {
+            xfer.next_row++;
+            xfer.nak_sent = 0;
+            input_rows_ready(xfer.next_row);
+            if (xfer.next_row % FRAME_ACK_ROWS == 0 && xfer.next_row < IMG_HEIGHT) {
+                send_row_number(FRAME_ACK, xfer.next_row);
+            }
+            return;
+        }
+    } else if (row < xfer.next_row) {
+        return; // Omsänd rad som redan finns
+    }
+    request_resend(row);
+}
+
+// FRAME_END under en uppladdning: kvittera, eller begär om det som saknas.
+// Kom kvittensen inte fram skickar värden FRAME_END igen.
+static void handle_end(void) {
+    if (xfer.state == STATE_IDLE && xfer.received) {
+        send_row_number(FRAME_ACK, IMG_HEIGHT);
+        return;
+    }
+    if (xfer.state != STATE_RECEIVE) return;
+
+    if (xfer.next_row < IMG_HEIGHT) {
+        request_resend(IMG_HEIGHT);
+        return;
+    }
+    send_row_number(FRAME_ACK, IMG_HEIGHT);
+    xfer.state = STATE_IDLE;
+    xfer.received = 1;
+    print("Image received.\n");
+}
+
+// Börjar skicka src med FRAME_INFO
+static void start_send(const unsigned char* src) {
+    xfer.src = src;
+    process_watch(src);
+    xfer.next_row = 0;
+    xfer.acked = 0;
+    xfer.retries = 0;
+    xfer.state = STATE_SEND;
+
+    unsigned char info[4];
+    frame_put16(info, IMG_WIDTH);
+    frame_put16(info + 2, IMG_HEIGHT);
+    send_frame(FRAME_INFO, info, 4);
+}
+
+// FRAME_DOWNLOAD: bild, packade rader tillåtna. Resultatet av ett jobb som
+// pågår (t.ex. från uppladdningen nyss) skickas när jobbet är klart.
+static void handle_download(const unsigned char* p, int len) {
+    abort_transfer();
+    if (len < 2 || p[0] > FRAME_IMG_INPUT) {
+        send_error(FRAME_ERR_REQUEST);
+        return;
+    }
+    xfer.packed = p[1];
+    if (p[0] == FRAME_IMG_RESULT) {
+        xfer.state = STATE_SEND_PENDING;
+        return;
+    }
+    // En packad inbyggd bild packas upp först, raderna skickas som de är
+    start_send(input_writable());
+}
+
+// FRAME_ACK eller FRAME_NAK under en nedladdning. Båda kvitterar raderna
+// före n; FRAME_NAK ber dessutom om allt från n igen.
+static void handle_ack(const frame_parser_t* f) {
+    if ((xfer.state != STATE_SEND && xfer.state != STATE_SEND_WAIT) || f->len < 2) return;
+
+    int row = frame_get16(f->data);
+    if (row > IMG_HEIGHT) return;
+    if (row > xfer.acked) xfer.acked = row;
+
+    if (f->type == FRAME_NAK && row < IMG_HEIGHT) {
+        xfer.next_row = row;
+        xfer.state = STATE_SEND;
+    } else if (f->type == FRAME_ACK && row == IMG_HEIGHT && xfer.state == STATE_SEND_WAIT) {
+        xfer.state = STATE_IDLE;
+        process_watch(NULL);
+        print("Image sent.\n");
+    }
+}
+
+static xfer_status_t handle_frame(const frame_parser_t* f) {
+    switch (f->type) {
+        case FRAME_PING:
+            send_frame(FRAME_PING, f->data, f->len);
+            break;
+        case FRAME_UPLOAD:
+            return handle_upload(f->data, f->len);
+        case FRAME_ROW:
+            handle_row(f->data, f->len);
+            break;
+        case FRAME_END:
+            handle_end();
+            break;
+        case FRAME_DOWNLOAD:
+            handle_download(f->data, f->len);
+            break;
+        case FRAME_KERNEL:
+            handle_kernel(f->data, f->len);
+            break;
+        case FRAME_NAK:
+        case FRAME_ACK:
+            handle_ack(f);
+            break;
+    }
+    return XFER_ACTIVE;
+}
+
+// Nästa rad av nedladdningen, eller FRAME_END efter den sista
+static void send_next_row(void) {
+    int row = xfer.next_row;
+    const unsigned char* pixels = xfer.src + row * IMG_WIDTH;
+    const unsigned char* prev = row > 0 ? pixels - IMG_WIDTH : conv_zero_row;
+    int len = frame_row_payload(tx_payload, row, pixels, prev, IMG_WIDTH, xfer.packed);
+    send_frame(FRAME_ROW, tx_payload, len);
+
+    if (++xfer.next_row == IMG_HEIGHT) {
+        send_row_number(FRAME_END, IMG_HEIGHT);
+        xfer.state = STATE_SEND_WAIT;
+        xfer.last_tick = input_ticks();
+    }
+}
+
+/*
+ * Funktion: xfer_service
+ * ----------------------
+ * Läser högst en rams storlek per anrop, så att huvudloopen hinner med
+ * knappar och jobb mellan raderna. Tiden räknas i input_ticks() från
+ * senaste byte från värden. Står en nedladdning still med fullt fönster
+ * skickas allt från första okvitterade rad om.
+ */
+xfer_status_t xfer_service(void) {
+    xfer_status_t status = XFER_IDLE;
+    int c;
+
+    for (int n = 0; n < FRAME_MAX_PAYLOAD + FRAME_OVERHEAD && (c = uart_getchar()) >= 0; n++) {
+        xfer.last_tick = input_ticks();
+        xfer.retries = 0;
+        status = XFER_ACTIVE;
+        if (frame_feed(&xfer.rx, (unsigned char)c) && handle_frame(&xfer.rx) == XFER_STARTED) {
+            status = XFER_STARTED;
+        }
+    }
+
+    unsigned int idle = input_ticks() - xfer.last_tick;
+    switch (xfer.state) {
+        case STATE_IDLE:
+            return status;
+
+        case STATE_RECEIVE:
+            if (idle > XFER_TIMEOUT_TICKS) {
+                stop_receive();
+                print("Upload timed out.\n");
+                return status;
+            }
+            break;
+
+        case STATE_SEND_PENDING:
+            if (!process_busy()) start_send(result_img);
+            break;
+
+        case STATE_SEND:
+        case STATE_SEND_WAIT:
+            if (process_watch_hit()) {
+                abort_transfer();
+                send_error(FRAME_ERR_CHANGED);
+                print("Download aborted, image changed.\n");
+                return status;
+            }
+            if (xfer.state == STATE_SEND && xfer.next_row < xfer.acked + FRAME_WINDOW_ROWS) {
+                send_next_row();
+            } else if (idle > XFER_TIMEOUT_TICKS) {
+                if (xfer.retries++ < XFER_RETRIES) {
+                    if (xfer.state == STATE_SEND) xfer.next_row = xfer.acked;
+                    else send_row_number(FRAME_END, IMG_HEIGHT);
+                    xfer.last_tick = input_ticks();
+                } else {
+                    abort_transfer();
+                    print("Download not acknowledged.\n");
+                    return status;
+                }
+            }
+            break;
+    }
+    return status == XFER_STARTED ? XFER_STARTED : XFER_ACTIVE;
+}
@@ -0,0 +1,33 @@
+// xfer.h
+#ifndef XFER_H
+#define XFER_H
+
+// Kortets sida av bildöverföringen över JTAG UART (ramar enligt frame.h).
+// Värden styr: den laddar upp en bild, eventuellt med ett filter som körs
+// medan raderna kommer, eller ber om resultatet eller indata.
+//
+// Ingen rad kvitteras för sig. Sändaren skickar i ett svep inom ett fönster
+// av rader (FRAME_WINDOW_ROWS), och mottagaren begär bara om från första
+// saknade rad (FRAME_NAK). Rundturstiden kostar därför ingenting mitt i en
+// överföring, bara en gång i slutet.
+
+// Utan något från värden på så här många tick avbryts en överföring
+#define XFER_TIMEOUT_TICKS 2000
+
+// Så här många tidsgränser i följd innan en nedladdning ges upp. Varje gång
+// skickas det okvitterade (eller FRAME_END) om.
+#define XFER_RETRIES 3
+
+typedef enum {
+    XFER_IDLE,     // Inget att göra
+    XFER_ACTIVE,   // En överföring pågår; anropa igen utan att sova
+    XFER_STARTED   // En uppladdning startade ett filterjobb
+} xfer_status_t;
+
+void xfer_init(void);
+
+// Tar emot det som väntar i UART:en och skickar högst en rad. Körs från
+// huvudloopen mellan händelserna.
+xfer_status_t xfer_service(void);
+
+#endif
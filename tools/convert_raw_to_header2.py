@@ -17,7 +17,7 @@ data = data.reshape((height, width))
 
 with open("cat_image.h", "w") as f:
     f.write("#ifndef CAT_IMAGE_H\n#define CAT_IMAGE_H\n\n")
-    f.write(f"static const unsigned char {varname}[{height}][{width}] = {{\n")
+    f.write(f"static const unsigned char {varname}[{height}][{width}] __attribute__((aligned(4))) = {{\n")
     for row in data:
         f.write("    { " + ", ".join(map(str, row)) + " },\n")
     f.write("};\n\n#endif // CAT_IMAGE_H\n")